@@ -94,7 +94,27 @@ THE SOFTWARE.
 #endif //-----  REPLACE -----
 #ifndef BABELD_CODE //+++++ ADD +++++
 #include "cefore.h"
+#include "digest.h"
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+#include "damping.h"
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+#include "latency.h"
+#endif //----- ADD for LATENCY -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+#include "convergence.h"
+#endif //----- ADD for CONVERGENCE -----
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+#include <sys/select.h>
+#include "watch.h"
+#endif //----- ADD for WATCH -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+#include "snapshot.h"
+#endif //----- ADD for SNAPSHOT -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+#include "trace.h"
+#endif //----- ADD for TRACE -----
 
 struct timeval now;
 
@@ -139,6 +159,24 @@ int route_ctrl_type;        /* route control type */
 unsigned short cefore_portnum = 0;
 int cefstat_sent_update_num = 0;
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+int cefstat_sent_request_num = 0;
+int cefstat_suppressed_request_num = 0;
+int cefstat_overbudget_request_num = 0;
+#endif //----- ADD for REQUEST LIMIT -----
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+int cefstat_route_switch_num = 0;
+int cefstat_held_switch_num = 0;
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+int cefstat_lfa_failover_num = 0;
+#endif //----- ADD for LFA -----
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+int cefstat_bulk_flush_num = 0;
+#endif //----- ADD for BULK FLUSH -----
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+struct cefbabel_counters cefstat;
+#endif //----- ADD for COUNTERS -----
 static int kernel_routes_changed = 0;
 static int kernel_rules_changed = 0;
 static int kernel_link_changed = 0;
@@ -467,6 +505,11 @@ main(int argc, char **argv)
     }
 
     free(config_files);
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    rc = trace_init();
+    if(rc < 0)
+        fprintf(stderr, "Warning: couldn't allocate the trace ring.\n");
+#endif //----- ADD for TRACE -----
 
     if(default_wireless_hello_interval <= 0)
         default_wireless_hello_interval = 4000;
@@ -726,6 +769,9 @@ main(int argc, char **argv)
     schedule_interfaces_check(30000, 1);
     expiry_time = now.tv_sec + roughly(30);
     source_expiry_time = now.tv_sec + roughly(300);
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+    snapshot_time = now.tv_sec + snapshot_interval;
+#endif //----- ADD for SNAPSHOT -----
 
     /* Make some noise so that others notice us, and send retractions in
        case we were restarted recently */
@@ -766,7 +812,13 @@ main(int argc, char **argv)
     while(1) {
         struct timeval tv;
         fd_set readfds;
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+        fd_set writefds;
+#endif //----- ADD for WATCH -----
         struct neighbour *neigh;
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+        struct timespec loop_start, phase_start;
+#endif //----- ADD for LATENCY -----
 #ifndef BABELD_CODE //+++++ ADD +++++
         cefbabel_tcp_stat_prcess ();
 #endif //----- ADD -----
@@ -779,6 +831,10 @@ main(int argc, char **argv)
         timeval_min_sec(&tv, source_expiry_time);
         timeval_min_sec(&tv, kernel_dump_time);
         timeval_min(&tv, &resend_time);
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+        if(snapshot_file && snapshot_interval > 0)
+            timeval_min_sec(&tv, snapshot_time);
+#endif //----- ADD for SNAPSHOT -----
         FOR_ALL_INTERFACES(ifp) {
             if(!if_up(ifp))
                 continue;
@@ -791,6 +847,9 @@ main(int argc, char **argv)
             timeval_min(&tv, &neigh->buf.timeout);
         }
         FD_ZERO(&readfds);
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+        FD_ZERO(&writefds);
+#endif //----- ADD for WATCH -----
         if(timeval_compare(&tv, &now) > 0) {
             int maxfd = 0;
             timeval_minus(&tv, &tv, &now);
@@ -807,7 +866,15 @@ main(int argc, char **argv)
                 maxfd = MAX(maxfd, local_server_socket);
             }
             for(i = 0; i < num_local_sockets; i++) {
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
                 FD_SET(local_sockets[i].fd, &readfds);
+#else // CEFBABELD
+                /* Commands wait until a dump in progress is over */
+                if(local_sockets[i].dump == NULL)
+                    FD_SET(local_sockets[i].fd, &readfds);
+                if(local_sockets[i].out_len > 0 || local_sockets[i].dump)
+                    FD_SET(local_sockets[i].fd, &writefds);
+#endif //----- REPLACE for LOCAL QUEUE -----
                 maxfd = MAX(maxfd, local_sockets[i].fd);
             }
 #ifndef BABELD_CODE //+++++ ADD +++++
@@ -823,7 +890,17 @@ main(int argc, char **argv)
                 maxfd = MAX(maxfd, cefore_socket);
             }
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for STATUS QUEUE +++++
+            /* Paged dumps take one request per page, so cefbabelstatus
+               is served as soon as it is ready */
+            maxfd = MAX(maxfd, cefbabel_tcp_stat_fds(&readfds, &writefds));
+#endif //----- ADD for STATUS QUEUE -----
+#ifdef BABELD_CODE //+++++ REPLACE for WATCH +++++
             rc = select(maxfd + 1, &readfds, NULL, NULL, &tv);
+#else // CEFBABELD
+            maxfd = MAX(maxfd, watch_fds(&readfds, &writefds));
+            rc = select(maxfd + 1, &readfds, &writefds, NULL, &tv);
+#endif //----- REPLACE for WATCH -----
             if(rc < 0) {
                 if(errno != EINTR) {
                     perror("select");
@@ -831,6 +908,9 @@ main(int argc, char **argv)
                 }
                 rc = 0;
                 FD_ZERO(&readfds);
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+                FD_ZERO(&writefds);
+#endif //----- ADD for WATCH -----
             }
         }
 
@@ -838,6 +918,9 @@ main(int argc, char **argv)
 
         if(exiting)
             break;
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+        latency_start(&loop_start);
+#endif //----- ADD for LATENCY -----
 
         if(kernel_socket >= 0 && FD_ISSET(kernel_socket, &readfds)) {
             struct kernel_filter filter = {0};
@@ -862,8 +945,20 @@ main(int argc, char **argv)
                     if(!if_up(ifp))
                         continue;
                     if(ifp->ifindex == sin6.sin6_scope_id) {
+#ifdef BABELD_CODE //+++++ REPLACE +++++
                         parse_packet((unsigned char*)&sin6.sin6_addr, ifp,
                                      receive_buffer, rc);
+#else // CEFBABELD
+                        begin_route_batch();
+                        latency_start(&phase_start);
+                        parse_packet((unsigned char*)&sin6.sin6_addr, ifp,
+                                     receive_buffer, rc);
+                        latency_record(CefC_Lat_Parse_Packet, &phase_start);
+                        latency_start(&phase_start);
+                        end_route_batch();
+                        latency_record(CefC_Lat_Route_Selection, &phase_start);
+                        convergence_settle();
+#endif //----- REPLACE -----
                         VALGRIND_MAKE_MEM_UNDEFINED(receive_buffer,
                                                     receive_buffer_size);
                         break;
@@ -899,11 +994,28 @@ main(int argc, char **argv)
             }
         }
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+        watch_process(&readfds, &writefds);
+#endif //----- ADD for WATCH -----
+#ifndef BABELD_CODE //+++++ ADD for STATUS QUEUE +++++
+        cefbabel_tcp_stat_io(&readfds, &writefds);
+#endif //----- ADD for STATUS QUEUE -----
         if(local_server_socket >= 0 && FD_ISSET(local_server_socket, &readfds))
            accept_local_connections();
 
         i = 0;
         while(i < num_local_sockets) {
+#ifndef BABELD_CODE //+++++ ADD for LOCAL QUEUE +++++
+            if(FD_ISSET(local_sockets[i].fd, &writefds)) {
+                rc = local_flush(&local_sockets[i]);
+                if(rc < 0) {
+                    if(errno != EPIPE && errno != ECONNRESET)
+                        perror("write(local_socket)");
+                    local_socket_destroy(i);
+                    continue;
+                }
+            }
+#endif //----- ADD for LOCAL QUEUE -----
             if(FD_ISSET(local_sockets[i].fd, &readfds)) {
                 rc = local_read(&local_sockets[i]);
                 if(rc <= 0) {
@@ -967,13 +1079,31 @@ main(int argc, char **argv)
         }
 
         if(now.tv_sec >= expiry_time) {
+#ifdef BABELD_CODE //+++++ REPLACE +++++
+            expire_routes();
+#else // CEFBABELD
+            latency_start(&phase_start);
             expire_routes();
+            latency_record(CefC_Lat_Expire_Routes, &phase_start);
+#endif //----- REPLACE -----
             expire_resend();
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            expire_damping();
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+            expire_convergence();
+#endif //----- ADD for CONVERGENCE -----
             expiry_time = now.tv_sec + roughly(30);
         }
 
         if(now.tv_sec >= source_expiry_time) {
+#ifdef BABELD_CODE //+++++ REPLACE +++++
             expire_sources();
+#else // CEFBABELD
+            latency_start(&phase_start);
+            expire_sources();
+            latency_record(CefC_Lat_Expire_Sources, &phase_start);
+#endif //----- REPLACE -----
             source_expiry_time = now.tv_sec + roughly(300);
         }
 
@@ -982,8 +1112,16 @@ main(int argc, char **argv)
                 continue;
             if(timeval_compare(&now, &ifp->hello_timeout) >= 0)
                 send_hello(ifp);
+#ifdef BABELD_CODE //+++++ REPLACE +++++
             if(timeval_compare(&now, &ifp->update_timeout) >= 0)
                 send_update(ifp, 0, NULL, 0, NULL, 0);
+#else // CEFBABELD
+            if(timeval_compare(&now, &ifp->update_timeout) >= 0) {
+                rc = delta_updates ? send_digest(ifp) : -1;
+                if(rc < 0 || digest_needs_full_update(ifp))
+                    send_update(ifp, 0, NULL, 0, NULL, 0);
+            }
+#endif //----- REPLACE -----
             if(timeval_compare(&now, &ifp->update_flush_timeout) >= 0)
                 flushupdates(ifp);
         }
@@ -1012,10 +1150,30 @@ main(int argc, char **argv)
             }
         }
 
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+        /* Here the tables are as consistent as they get */
+        if(snapshot_file &&
+           (dumping ||
+            (snapshot_interval > 0 && now.tv_sec >= snapshot_time))) {
+            snapshot_write_file(snapshot_file);
+            if(snapshot_interval > 0)
+                snapshot_time = now.tv_sec + snapshot_interval;
+        }
+#endif //----- ADD for SNAPSHOT -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+        if(trace_file && dumping)
+            trace_write_file(trace_file);
+#endif //----- ADD for TRACE -----
         if(UNLIKELY(debug || dumping)) {
             dump_tables(stdout);
             dumping = 0;
         }
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+        watch_flush();
+#endif //----- ADD for WATCH -----
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+        latency_record(CefC_Lat_Main_Loop, &loop_start);
+#endif //----- ADD for LATENCY -----
     }
 
     debugf("Exiting...\n");
@@ -1339,7 +1497,7 @@ dump_route(FILE *out, struct babel_route *route)
 #ifdef BABELD_CODE //+++++ REPLACE +++++
             format_prefix(route->src->prefix, route->src->plen),
 #else // CEFBABELD
-            format_cefore_prefix(route->src->prefix, route->src->plen),
+            source_uri(route->src),
 #endif //----- REPLACE -----
             route->src->src_plen > 0 ? " from " : "",
             route->src->src_plen > 0 ?
@@ -1372,6 +1530,23 @@ dump_xroute(FILE *out, struct xroute *xroute)
             xroute->metric);
 }
 
+static void
+dump_neighbour(FILE *out, struct neighbour *neigh)
+{
+    fprintf(out, "Neighbour %s dev %s reach %04x ureach %04x "
+            "rxcost %u txcost %d rtt %s rttcost %u chan %d%s.\n",
+            format_address(neigh->address),
+            neigh->ifp->name,
+            neigh->hello.reach,
+            neigh->uhello.reach,
+            neighbour_rxcost(neigh),
+            neigh->txcost,
+            format_thousands(neigh->rtt),
+            neighbour_rttcost(neigh),
+            neigh->ifp->channel,
+            if_up(neigh->ifp) ? "" : " (down)");
+}
+
 static void
 dump_tables(FILE *out)
 {
@@ -1387,18 +1562,7 @@ dump_tables(FILE *out)
     fprintf(out, "----- neighbours -----\n");
 #endif //----- ADD -----
     FOR_ALL_NEIGHBOURS(neigh) {
-        fprintf(out, "Neighbour %s dev %s reach %04x ureach %04x "
-                "rxcost %u txcost %d rtt %s rttcost %u chan %d%s.\n",
-                format_address(neigh->address),
-                neigh->ifp->name,
-                neigh->hello.reach,
-                neigh->uhello.reach,
-                neighbour_rxcost(neigh),
-                neigh->txcost,
-                format_thousands(neigh->rtt),
-                neighbour_rttcost(neigh),
-                neigh->ifp->channel,
-                if_up(neigh->ifp) ? "" : " (down)");
+        dump_neighbour(out, neigh);
     }
 
 #ifndef BABELD_CODE //+++++ ADD +++++   
@@ -1438,6 +1602,248 @@ dump_tables(FILE *out)
     fflush(out);
 }
 
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+/* Entries looked at per page at most, matching the filter or not. */
+#define DUMP_PAGE_SCAN 4096
+
+/* A page starts after the entry whose key is in the cursor.  The cursor
+   of the routes, exported routes and best routes is
+       Plen(2) SrcPlen(1) SrcPrefix(16) Prefix(Plen),
+   that of the sources the router-id (8) followed by the same, and that
+   of the neighbours Ifindex(4) Address(16).  An empty cursor starts at
+   the beginning of the table. */
+
+static int
+put_prefix_cursor(unsigned char *cursor,
+                  const unsigned char *prefix, uint16_t plen,
+                  const unsigned char *src_prefix, unsigned char src_plen)
+{
+    DO_HTONS(cursor, plen);
+    cursor[2] = src_plen;
+    memcpy(cursor + 3, src_prefix, 16);
+    memcpy(cursor + 19, prefix, plen);
+    return 19 + plen;
+}
+
+static int
+get_prefix_cursor(const unsigned char *cursor, int len,
+                  const unsigned char **prefix, uint16_t *plen,
+                  const unsigned char **src_prefix, unsigned char *src_plen)
+{
+    if(len < 19)
+        return -1;
+    DO_NTOHS(*plen, cursor);
+    if(*plen > NAME_PREFIX_LEN || len != 19 + *plen)
+        return -1;
+    *src_plen = cursor[2];
+    *src_prefix = cursor + 3;
+    *prefix = cursor + 19;
+    return 1;
+}
+
+/* Whether a name is under the filter, component by component: /a matches
+   /a and /a/b, but not /ab.  An empty filter matches everything. */
+static int
+dump_filter_match(const char *filter,
+                  const unsigned char *prefix, uint16_t plen)
+{
+    const char *name;
+    size_t n;
+
+    if(filter[0] == '\0')
+        return 1;
+    name = format_cefore_prefix(prefix, plen);
+    n = strlen(filter);
+    while(n > 1 && filter[n - 1] == '/')
+        n--;
+    if(strncmp(name, filter, n) != 0)
+        return 0;
+    return name[n] == '\0' || name[n] == '/' || filter[n - 1] == '/';
+}
+
+static int
+neighbour_key_compare(const struct neighbour *neigh,
+                      unsigned int ifindex, const unsigned char *address)
+{
+    if(neigh->ifp->ifindex != ifindex)
+        return neigh->ifp->ifindex < ifindex ? -1 : 1;
+    return memcmp(neigh->address, address, 16);
+}
+
+/* Neighbour following the given key in (ifindex, address) order, or the
+   first one if address is NULL.  The neighbour list is short and in no
+   particular order, so we just walk it. */
+static struct neighbour *
+neighbour_after(unsigned int ifindex, const unsigned char *address)
+{
+    struct neighbour *neigh, *best = NULL;
+
+    FOR_ALL_NEIGHBOURS(neigh) {
+        if(address && neighbour_key_compare(neigh, ifindex, address) <= 0)
+            continue;
+        if(best == NULL ||
+           neighbour_key_compare(neigh, best->ifp->ifindex,
+                                 best->address) < 0)
+            best = neigh;
+    }
+    return best;
+}
+
+/* Dump the entries of a table that follow the cursor to out, one line
+   each, in the same format as dump_tables.  A page stops after
+   max_entries entries (the routes of a prefix are never split across
+   pages), once out holds max_bytes, or after DUMP_PAGE_SCAN entries have
+   been looked at, so that a large table never holds up the main loop.
+   The filter is a name prefix for the name tables and an interface name
+   for the neighbours.  On return, the cursor holds the key of the last
+   entry looked at and *more tells whether the table goes on.  Returns the
+   number of entries dumped, or -1 if the table or the cursor is bad. */
+int
+dump_table_page(FILE *out, int table, const char *filter,
+                unsigned char *cursor, int *cursor_len,
+                int max_entries, long max_bytes, int *more)
+{
+    const unsigned char *prefix = NULL, *src_prefix = NULL;
+    uint16_t plen = 0;
+    unsigned char src_plen = 0;
+    int n = 0, scanned = 0;
+
+#define PAGE_FULL() \
+    (n >= max_entries || scanned >= DUMP_PAGE_SCAN || ftell(out) >= max_bytes)
+
+    switch(table) {
+    case CefC_Dump_Routes: {
+        struct babel_route *route, *r;
+        if(*cursor_len > 0 &&
+           get_prefix_cursor(cursor, *cursor_len, &prefix, &plen,
+                             &src_prefix, &src_plen) < 0)
+            return -1;
+        route = route_slot_after(prefix, plen, src_prefix, src_plen);
+        while(route && !PAGE_FULL()) {
+            struct source *src = route->src;
+            scanned++;
+            if(dump_filter_match(filter, src->prefix, src->plen)) {
+                for(r = route; r; r = r->next) {
+                    dump_route(out, r);
+                    n++;
+                }
+            }
+            *cursor_len = put_prefix_cursor(cursor, src->prefix, src->plen,
+                                            src->src_prefix, src->src_plen);
+            route = route_slot_after(src->prefix, src->plen,
+                                     src->src_prefix, src->src_plen);
+        }
+        *more = route != NULL;
+        break;
+    }
+    case CefC_Dump_Xroutes: {
+        struct xroute *xroute;
+        if(*cursor_len > 0 &&
+           get_prefix_cursor(cursor, *cursor_len, &prefix, &plen,
+                             &src_prefix, &src_plen) < 0)
+            return -1;
+        xroute = xroute_after(prefix, plen, src_prefix, src_plen);
+        while(xroute && !PAGE_FULL()) {
+            scanned++;
+            if(dump_filter_match(filter, xroute->prefix, xroute->plen)) {
+                dump_xroute(out, xroute);
+                n++;
+            }
+            *cursor_len = put_prefix_cursor(cursor,
+                                            xroute->prefix, xroute->plen,
+                                            xroute->src_prefix,
+                                            xroute->src_plen);
+            xroute = xroute_after(xroute->prefix, xroute->plen,
+                                  xroute->src_prefix, xroute->src_plen);
+        }
+        *more = xroute != NULL;
+        break;
+    }
+    case CefC_Dump_Sources: {
+        struct source *src;
+        const unsigned char *id = NULL;
+        if(*cursor_len > 0) {
+            if(*cursor_len < 8 ||
+               get_prefix_cursor(cursor + 8, *cursor_len - 8, &prefix, &plen,
+                                 &src_prefix, &src_plen) < 0)
+                return -1;
+            id = cursor;
+        }
+        src = source_after(id, prefix, plen, src_prefix, src_plen);
+        while(src && !PAGE_FULL()) {
+            scanned++;
+            if(dump_filter_match(filter, src->prefix, src->plen)) {
+                dump_source_entry(out, src);
+                n++;
+            }
+            memcpy(cursor, src->id, 8);
+            *cursor_len = 8 + put_prefix_cursor(cursor + 8,
+                                                src->prefix, src->plen,
+                                                src->src_prefix,
+                                                src->src_plen);
+            src = source_after(src->id, src->prefix, src->plen,
+                               src->src_prefix, src->src_plen);
+        }
+        *more = src != NULL;
+        break;
+    }
+    case CefC_Dump_Bestroutes: {
+        struct best_route *broute;
+        if(*cursor_len > 0 &&
+           get_prefix_cursor(cursor, *cursor_len, &prefix, &plen,
+                             &src_prefix, &src_plen) < 0)
+            return -1;
+        broute = bestroute_after(prefix, plen, src_prefix, src_plen);
+        while(broute && !PAGE_FULL()) {
+            scanned++;
+            if(dump_filter_match(filter, broute->prefix, broute->plen)) {
+                dump_bestroute_entry(out, broute);
+                n++;
+            }
+            *cursor_len = put_prefix_cursor(cursor,
+                                            broute->prefix, broute->plen,
+                                            broute->src_prefix,
+                                            broute->src_plen);
+            broute = bestroute_after(broute->prefix, broute->plen,
+                                     broute->src_prefix, broute->src_plen);
+        }
+        *more = broute != NULL;
+        break;
+    }
+    case CefC_Dump_Neighbours: {
+        struct neighbour *neigh;
+        unsigned int ifindex = 0;
+        if(*cursor_len > 0) {
+            if(*cursor_len != 20)
+                return -1;
+            DO_NTOHL(ifindex, cursor);
+            neigh = neighbour_after(ifindex, cursor + 4);
+        } else {
+            neigh = neighbour_after(0, NULL);
+        }
+        while(neigh && !PAGE_FULL()) {
+            scanned++;
+            if(filter[0] == '\0' || strcmp(neigh->ifp->name, filter) == 0) {
+                dump_neighbour(out, neigh);
+                n++;
+            }
+            DO_HTONL(cursor, neigh->ifp->ifindex);
+            memcpy(cursor + 4, neigh->address, 16);
+            *cursor_len = 20;
+            neigh = neighbour_after(neigh->ifp->ifindex, neigh->address);
+        }
+        *more = neigh != NULL;
+        break;
+    }
+    default:
+        return -1;
+    }
+#undef PAGE_FULL
+
+    return n;
+}
+#endif //----- ADD for PAGED DUMP -----
+
 int
 reopen_logfile()
 {
@@ -97,6 +97,9 @@ THE SOFTWARE.
 #include <sys/socket.h>
 #include <net/if.h>
 #endif
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+#include <stdio.h>
+#endif //----- ADD for PAGED DUMP -----
 
 #ifdef HAVE_VALGRIND
 #include <valgrind/memcheck.h>
@@ -109,6 +112,33 @@ THE SOFTWARE.
 #endif
 #endif
 
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+/* Static tracepoints for SystemTap and bpftrace, under the provider
+   cefbabeld.  With <sys/sdt.h> each one is a single nop until attached to;
+   without it, or with -DNO_USDT, they compile to nothing. */
+#if !defined(NO_USDT) && !defined(HAVE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define HAVE_USDT
+#endif
+#endif
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+#define USDT_PROBE(n) DTRACE_PROBE(cefbabeld, n)
+#define USDT_PROBE1(n, a) DTRACE_PROBE1(cefbabeld, n, a)
+#define USDT_PROBE2(n, a, b) DTRACE_PROBE2(cefbabeld, n, a, b)
+#define USDT_PROBE3(n, a, b, c) DTRACE_PROBE3(cefbabeld, n, a, b, c)
+#define USDT_PROBE4(n, a, b, c, d) DTRACE_PROBE4(cefbabeld, n, a, b, c, d)
+#define USDT_PROBE5(n, a, b, c, d, e) DTRACE_PROBE5(cefbabeld, n, a, b, c, d, e)
+#else
+#define USDT_PROBE(n) do {} while(0)
+#define USDT_PROBE1(n, a) do {} while(0)
+#define USDT_PROBE2(n, a, b) do {} while(0)
+#define USDT_PROBE3(n, a, b, c) do {} while(0)
+#define USDT_PROBE4(n, a, b, c, d) do {} while(0)
+#define USDT_PROBE5(n, a, b, c, d, e) do {} while(0)
+#endif
+#endif //----- ADD for USDT -----
+
 #ifndef BABELD_CODE //+++++ ADD +++++
 #define NAME_PREFIX_LEN     1024
 #define ROUTE_CTRL_TYPE_S   0   /* "Single path"                                    */
@@ -146,9 +176,29 @@ extern int route_ctrl_type;
 extern unsigned short cefore_portnum;
 extern int cefstat_sent_update_num;
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+extern int cefstat_sent_request_num;
+extern int cefstat_suppressed_request_num;
+extern int cefstat_overbudget_request_num;
+#endif //----- ADD for REQUEST LIMIT -----
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+extern int cefstat_route_switch_num;
+extern int cefstat_held_switch_num;
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+extern int cefstat_lfa_failover_num;
+#endif //----- ADD for LFA -----
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+extern int cefstat_bulk_flush_num;
+#endif //----- ADD for BULK FLUSH -----
 extern int max_request_hopcount;
 
 void schedule_neighbours_check(int msecs, int override);
 void schedule_interfaces_check(int msecs, int override);
 int resize_receive_buffer(int size);
 int reopen_logfile(void);
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+int dump_table_page(FILE *out, int table, const char *filter,
+                    unsigned char *cursor, int *cursor_len,
+                    int max_entries, long max_bytes, int *more);
+#endif //----- ADD for PAGED DUMP -----
@@ -37,6 +37,7 @@
  ****************************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <errno.h>
 #include <poll.h>
 #include <string.h>
@@ -63,6 +64,72 @@
 /****************************************************************************************
  State Variables
  ****************************************************************************************/
+/* Names of the counters of the Get Counters response, in wire order */
+static const char* counter_names[CefC_Cnt_Num] = {
+    "Updates Accepted",
+    "Updates Unfeasible",
+    "Updates Ignored",
+    "Updates Sent",
+    "Requests Sent",
+    "Requests Forwarded",
+    "Requests Suppressed",
+    "Requests Over-budget",
+    "FIB Add Requests",
+    "FIB Delete Requests",
+    "FIB Requests Failed",
+    "Route Switches",
+    "Held Switches",
+    "LFA Failovers",
+    "Bulk Flushed Routes",
+    "Damped Prefixes",
+    "Routes",
+    "Installed Routes",
+    "Sources",
+    "Exported Routes",
+    "Best Routes",
+    "Neighbours",
+};
+/* Names of the latency histograms of the Get Latency response, in wire order */
+static const char* latency_names[CefC_Lat_Num] = {
+    "FIB Add",
+    "FIB Delete",
+    "FIB Batch",
+    "Parse Packet",
+    "Route Selection",
+    "Flush Updates",
+    "Expire Routes",
+    "Expire Sources",
+    "Main Loop",
+    "Conv. FIB",
+    "Conv. Advertise",
+};
+/* Subcommands dumping tables page by page, and the tables they dump */
+static const struct {
+    const char* name;
+    int tables[2];
+} dump_commands[] = {
+    { "routes",     { CefC_Dump_Xroutes, CefC_Dump_Routes } },
+    { "sources",    { CefC_Dump_Bestroutes, CefC_Dump_Sources } },
+    { "neighbours", { CefC_Dump_Neighbours, 0 } },
+};
+static const char* dump_table_names[] = {
+    "", "routes", "xroutes", "sources", "bestroutes", "neighbours",
+};
+/* Names of the tables of a snapshot */
+static const char* snapshot_table_names[CefC_Snap_Num] = {
+    "", "neighbours", "xroutes", "routes", "sources", "bestroutes", "resends",
+};
+/* Names of the events of a trace */
+static const char* trace_event_names[CefC_Trace_Num] = {
+    "", "update", "request", "install", "uninstall", "switch", "flush",
+    "neigh-flush", "fib-add", "fib-del", "fib-fail",
+};
+/* Names of the TLV types, as in message.h */
+static const char* tlv_names[] = {
+    "Pad1", "PadN", "Ack Request", "Ack", "Hello", "IHU", "Router-Id",
+    "Next Hop", "Update", "Request", "MH Request", "Digest", "Digest Request",
+    "Name Fragment", "Multi Request", "Multi MH Request", "Compressed",
+};
 
 
 /****************************************************************************************
@@ -83,6 +150,63 @@ cef_cbabel_send_msg (
     unsigned char* msg,
     uint16_t msg_len
 );
+static void
+print_counters (
+    const unsigned char* body,
+    uint32_t len
+);
+static void
+print_latency (
+    const unsigned char* body,
+    uint32_t len
+);
+static int                                  /* The return value is negative if an error occurs  */
+cef_cbabel_recv_rsp (
+    int tcp_sock,
+    uint8_t type,
+    unsigned char** frame_r,
+    uint32_t* msg_len_r
+);
+static int                                  /* number of entries, or -1                 */
+dump_table (
+    const char* dst,
+    const char* port_str,
+    int table,
+    const char* filter
+);
+static int                                  /* The return value is negative if an error occurs  */
+watch_events (
+    const char* dst,
+    const char* port_str
+);
+static int                                  /* The return value is negative if an error occurs  */
+print_snapshot (
+    FILE* out,
+    const unsigned char* snap,
+    uint32_t len,
+    int json
+);
+static int                                  /* The return value is negative if an error occurs  */
+print_trace (
+    FILE* out,
+    const unsigned char* trace,
+    uint32_t len,
+    int json
+);
+static int                                  /* The return value is negative if an error occurs  */
+get_snapshot (
+    const char* dst,
+    const char* port_str,
+    int type,
+    const char* out_file,
+    int json
+);
+static int                                  /* The return value is negative if an error occurs  */
+read_snapshot (
+    const char* file,
+    int type,
+    int json
+);
 
 /****************************************************************************************
  ****************************************************************************************/
@@ -97,19 +221,26 @@ main (
     /////int frame_size;
     unsigned char buff[CefC_Cbabel_Stat_Mtu] = {0};
     uint16_t value16;
-    struct pollfd fds[1];
     unsigned char *frame;
     char dst[64] = {0};
     char port_str[32] = {0};
     int i;
     char*   work_arg;
-    uint32_t msg_len, rcvd_size;
-    int rc;
-    int blocks;
+    uint32_t msg_len;
 
     /***** flags        *****/
     int host_f          = 0;
     int port_f          = 0;
+    int counters_f      = 0;
+    int latency_f       = 0;
+    int reset_f         = 0;
+    int watch_f         = 0;
+    int snapshot_f      = 0;
+    int json_f          = 0;
+    int dump_cmd        = -1;
+    const char* filter  = "";
+    const char* snap_in = NULL;
+    const char* snap_out = NULL;
 
     /***** state variavles  *****/
     uint16_t index      = 0;
@@ -152,6 +283,29 @@ main (
             strcpy (port_str, work_arg);
             port_f++;
             i++;
+        } else if (strcmp (work_arg, "-c") == 0) {
+            counters_f++;
+        } else if (strcmp (work_arg, "-l") == 0) {
+            latency_f++;
+        } else if (strcmp (work_arg, "-r") == 0) {
+            latency_f++;
+            reset_f++;
+        } else if (strcmp (work_arg, "--watch") == 0) {
+            watch_f++;
+        } else if (strcmp (work_arg, "--json") == 0) {
+            json_f++;
+        } else if (strcmp (work_arg, "-f") == 0 || strcmp (work_arg, "-o") == 0) {
+            if (i + 1 == argc) {
+                fprintf (stderr, "cefbabelstatus: [ERROR] file is not specified.");
+                print_usage ();
+                return (-1);
+            }
+            if (work_arg[1] == 'f') {
+                snap_in = argv[i + 1];
+            } else {
+                snap_out = argv[i + 1];
+            }
+            i++;
         } else {
 
             work_arg = argv[i];
@@ -161,7 +315,58 @@ main (
                 print_usage ();
                 return (-1);
             }
+            if (strcmp (work_arg, "snapshot") == 0 && dump_cmd < 0 && !snapshot_f) {
+                snapshot_f = CefC_Cbabel_Msg_Type_Snapshot;
+            } else if (strcmp (work_arg, "trace") == 0 && dump_cmd < 0 && !snapshot_f) {
+                snapshot_f = CefC_Cbabel_Msg_Type_Trace;
+            } else if (snapshot_f) {
+                fprintf (stderr, "cefbabelstatus: [ERROR] unknown command is specified.");
+                print_usage ();
+                return (-1);
+            } else if (dump_cmd < 0) {
+                int n;
+                for (n = 0 ; n < (int)(sizeof (dump_commands) / sizeof (dump_commands[0])) ; n++) {
+                    if (strcmp (work_arg, dump_commands[n].name) == 0) {
+                        dump_cmd = n;
+                    }
+                }
+                if (dump_cmd < 0) {
+                    fprintf (stderr, "cefbabelstatus: [ERROR] unknown command is specified.");
+                    print_usage ();
+                    return (-1);
+                }
+            } else {
+                /* Name prefix filter, with or without the scheme */
+                filter = work_arg;
+                if (strncmp (filter, "ccnx:", 5) == 0) {
+                    filter += 5;
+                }
+                if (strlen (filter) > CefC_Cbabel_Dump_FilterMaxLen) {
+                    fprintf (stderr, "cefbabelstatus: [ERROR] filter is too long.");
+                    return (-1);
+                }
+            }
+        }
+    }
+
+    if ((counters_f != 0) + (latency_f != 0) + (watch_f != 0) + (dump_cmd >= 0)
+            + (snapshot_f != 0) > 1) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] -c, -l, --watch and commands cannot be used together.");
+        print_usage ();
+        return (-1);
+    }
+    if ((json_f || snap_in || snap_out) && !snapshot_f) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] --json, -f and -o go with snapshot or trace.");
+        print_usage ();
+        return (-1);
+    }
+    if (snap_in) {
+        if (snap_out) {
+            fprintf (stderr, "cefbabelstatus: [ERROR] -f and -o cannot be used together.");
+            print_usage ();
+            return (-1);
         }
+        return (read_snapshot (snap_in, snapshot_f, json_f));
     }
 
     /* check port flag */
@@ -174,6 +379,27 @@ main (
         strcpy (dst, "127.0.0.1");
     }
     fprintf (stderr, "\ncefbabelstatus: Connect to %s:%s\n", dst, port_str);
+    
+    if (dump_cmd >= 0) {
+        /* Each page is a request of its own */
+        fprintf (stderr, "-----\n");
+        for (i = 0 ; i < 2 && dump_commands[dump_cmd].tables[i] ; i++) {
+            int table = dump_commands[dump_cmd].tables[i];
+            fprintf (stderr, "----- %s -----\n", dump_table_names[table]);
+            if (dump_table (dst, port_str, table, filter) < 0) {
+                return (-1);
+            }
+        }
+        fprintf (stderr, "\n");
+        return (0);
+    }
+    if (watch_f) {
+        return (watch_events (dst, port_str));
+    }
+    if (snapshot_f) {
+        return (get_snapshot (dst, port_str, snapshot_f, snap_out, json_f));
+    }
+    
     tcp_sock = cef_connect_tcp_to_cbabeld (dst, port_str);
 
     if (tcp_sock < 1) {
@@ -184,8 +410,15 @@ main (
     /* Create Upload Request message    */
     /* set header   */
     buff[CefC_O_Fix_Ver]  = CefC_Version;
-    /* Get Status   */
-    buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Status;
+    /* Get Status, Get Counters or Get Latency  */
+    if (counters_f) {
+        buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Counters;
+    } else if (latency_f) {
+        buff[CefC_O_Fix_Type] = reset_f ?
+            CefC_Cbabel_Msg_Type_Latency_Reset : CefC_Cbabel_Msg_Type_Latency;
+    } else {
+        buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Status;
+    }
     index += CefC_Cbabel_CmdMsg_HeaderLen;
     /* set Length   */
     value16 = htons (index);
@@ -200,88 +433,32 @@ main (
     }
 
     /* receive message  */
-    rcvd_size = 0;
-    /////frame_size = 0;
-    msg_len = 0;
-    frame = calloc (1, CefC_Cbabel_Stat_Mtu);
-    if (frame == NULL) {
-        fprintf (stderr, "cefbabelstatus: Frame buffer allocation (alloc) error\n");
-        close (tcp_sock);
-        return (-1);
-    }
-
-RERECV:;
-    fds[0].fd = tcp_sock;
-    fds[0].events = POLLIN | POLLERR;
-    res = poll(fds, 1, 60000);
+    res = cef_cbabel_recv_rsp (tcp_sock, buff[CefC_O_Fix_Type], &frame, &msg_len);
     if (res < 0) {
-        /* poll error   */
-        fprintf (stderr, "cefbabelstatus: poll error (%s)\n", strerror (errno));
-        close (tcp_sock);
-        free (frame);
-        return (-1);
-    } else  if (res == 0) {
-        /* timeout  */
-        fprintf (stderr, "cefbabelstatus: timeout\n");
         close (tcp_sock);
-        free (frame);
         return (-1);
     }
-    if (fds[0].revents & POLLIN) {  
-        rc = recv (tcp_sock, frame+rcvd_size , CefC_Cbabel_Stat_Mtu, 0);
-        if (rc < 0) {
-            fprintf (stderr, "cefbabelstatus: Receive message error (%s)\n", strerror (errno));
-            close (tcp_sock);
-            free (frame);
-            return (-1);
-        }
-    } else {
-        if (fds[0].revents & POLLERR) {
-            fprintf (stderr, "cefbabelstatus: Poll event is POLLERR\n");
-        } else if (fds[0].revents & POLLNVAL) {
-            fprintf (stderr, "cefbabelstatus: Poll event is POLLNVAL\n");
+    /////frame_size = msg_len;
+    /* Output responce */
+    fprintf (stderr, "-----\n");
+    if (counters_f || latency_f) {
+        if (counters_f) {
+            print_counters (&frame[CefC_Cbabel_RspMsg_HeaderLen],
+                            msg_len - CefC_Cbabel_RspMsg_HeaderLen);
         } else {
-            fprintf (stderr, "cefbabelstatus: Poll event is POLLHUP\n");
+            print_latency (&frame[CefC_Cbabel_RspMsg_HeaderLen],
+                           msg_len - CefC_Cbabel_RspMsg_HeaderLen);
         }
         close (tcp_sock);
         free (frame);
-        return (-1);
-    }
-    rcvd_size += rc;
-    if (rcvd_size == rc) {
-        if ((rc < 6/* Ver(1)+Type(1)+Length(4) */) 
-            || (frame[CefC_O_Fix_Ver] != CefC_Version)
-            || (frame[CefC_O_Fix_Type] != CefC_Cbabel_Msg_Type_Status) ){
-            fprintf (stderr, "cefbabelstatus: Response type is not status\n");
-            close (tcp_sock);
-            free (frame);
-            return (-1);
-        }
-            
-        memcpy (&msg_len, &frame[2], sizeof (uint32_t));
-        msg_len = ntohl (msg_len);
-        blocks = (msg_len) / CefC_Cbabel_Stat_Mtu;
-        if (((msg_len) % CefC_Cbabel_Stat_Mtu) != 0){
-            blocks += 1;
-        }
-        if (blocks > 1) {
-            void *new = realloc(frame, blocks * CefC_Cbabel_Stat_Mtu);
-            if (new == NULL) {
-                fprintf (stderr, "cefbabelstatus: Frame buffer allocation (realloc) error\n");
-                close (tcp_sock);
-                free (frame);
-                return (-1);
-            }
-            frame = new;
-        }
+        return (0);
     }
-    if (rcvd_size < msg_len){
-        goto RERECV;
+    /* The response is a sequence of NUL-terminated lines */
+    index = CefC_Cbabel_RspMsg_HeaderLen;
+    while (index < msg_len) {
+        fprintf (stderr, "%s\n", &frame[index]);
+        index += strnlen ((char*) &frame[index], msg_len - index) + 1;
     }
-    /////frame_size = msg_len;
-    /* Output responce */
-    fprintf (stderr, "-----\n");
-    fprintf (stderr, "%s\n", &frame[CefC_Cbabel_RspMsg_HeaderLen]);
     fprintf (stderr, "\n");
     
     close (tcp_sock);
@@ -294,10 +471,35 @@ print_usage (
 ) {
     fprintf (stderr,
         "\nUsage: cefbabelstatus\n\n"
-        "  cefbabelstatus [-h host] [-p port]\n\n"
+        "  cefbabelstatus [-h host] [-p port] [-c | -l | -r | --watch]\n"
+        "  cefbabelstatus [-h host] [-p port] routes | sources [name-prefix]\n"
+        "  cefbabelstatus [-h host] [-p port] neighbours [interface]\n"
+        "  cefbabelstatus [-h host] [-p port] [--json | -o file] snapshot\n"
+        "  cefbabelstatus [--json] -f file snapshot\n"
+        "  cefbabelstatus [-h host] [-p port] [--json | -o file] trace\n"
+        "  cefbabelstatus [--json] -f file trace\n\n"
         "  host   Specify the host identifier (e.g., IP address) on which cefbabeld \n"
         "         is running. The default value is localhost (i.e., 127.0.0.1).\n"
-        "  port   Port number to connect cefbabelstatus. The default value is 9897.\n\n"
+        "  port   Port number to connect cefbabelstatus. The default value is 9897.\n"
+        "  -c     Print the runtime counters instead of the status.\n"
+        "  -l     Print the latency histograms instead of the status.\n"
+        "  -r     Print the latency histograms, then reset them.\n"
+        "  --watch  Print the tables, then every change as it happens,\n"
+        "           until cefbabeld goes away.\n"
+        "  routes       Print the exported and learned routes.\n"
+        "  sources      Print the best routes and the sources.\n"
+        "  neighbours   Print the neighbours.\n"
+        "  name-prefix  Only print the entries under this name prefix (e.g., ccnx:/a).\n"
+        "  interface    Only print the neighbours on this interface.\n"
+        "  snapshot     Print all the tables at once, from a binary snapshot,\n"
+        "               to the standard output.\n"
+        "  trace        Print the recent events of the binary trace ring,\n"
+        "               oldest first, to the standard output.\n"
+        "  --json       Print the snapshot or trace as JSON instead of text.\n"
+        "  -o file      Save the snapshot or trace to file instead of printing it.\n"
+        "  -f file      Print a snapshot or trace saved by -o or written by\n"
+        "               cefbabeld to its snapshot-file or trace-file, instead of\n"
+        "               asking cefbabeld.\n\n"
     );
     return;
 }
@@ -407,3 +609,1129 @@ cef_cbabel_send_msg (
     return (0);
 }
 
+/*--------------------------------------------------------------------------------------
+    Receives a whole response of the given type.  The frame is allocated here and
+    must be freed by the caller.
+----------------------------------------------------------------------------------------*/
+static int                                  /* The return value is negative if an error occurs  */
+cef_cbabel_recv_rsp (
+    int tcp_sock,                           /* socket fd                                */
+    uint8_t type,                           /* type of the request                      */
+    unsigned char** frame_r,                /* received frame                           */
+    uint32_t* msg_len_r                     /* length of the received frame             */
+) {
+    struct pollfd fds[1];
+    unsigned char *frame;
+    uint32_t frame_size, msg_len, rcvd_size;
+    int res, rc;
+    int blocks;
+    
+    rcvd_size = 0;
+    msg_len = 0;
+    frame = calloc (1, CefC_Cbabel_Stat_Mtu);
+    frame_size = CefC_Cbabel_Stat_Mtu;
+    if (frame == NULL) {
+        fprintf (stderr, "cefbabelstatus: Frame buffer allocation (alloc) error\n");
+        return (-1);
+    }
+
+RERECV:;
+    fds[0].fd = tcp_sock;
+    fds[0].events = POLLIN | POLLERR;
+    res = poll(fds, 1, 60000);
+    if (res < 0) {
+        /* poll error   */
+        fprintf (stderr, "cefbabelstatus: poll error (%s)\n", strerror (errno));
+        free (frame);
+        return (-1);
+    } else  if (res == 0) {
+        /* timeout  */
+        fprintf (stderr, "cefbabelstatus: timeout\n");
+        free (frame);
+        return (-1);
+    }
+    if (fds[0].revents & POLLIN) {  
+        rc = recv (tcp_sock, frame + rcvd_size, frame_size - rcvd_size, 0);
+        if (rc < 0) {
+            fprintf (stderr, "cefbabelstatus: Receive message error (%s)\n", strerror (errno));
+            free (frame);
+            return (-1);
+        }
+        if (rc == 0) {
+            fprintf (stderr, "cefbabelstatus: Connection closed by cefbabeld\n");
+            free (frame);
+            return (-1);
+        }
+    } else {
+        if (fds[0].revents & POLLERR) {
+            fprintf (stderr, "cefbabelstatus: Poll event is POLLERR\n");
+        } else if (fds[0].revents & POLLNVAL) {
+            fprintf (stderr, "cefbabelstatus: Poll event is POLLNVAL\n");
+        } else {
+            fprintf (stderr, "cefbabelstatus: Poll event is POLLHUP\n");
+        }
+        free (frame);
+        return (-1);
+    }
+    rcvd_size += rc;
+    if (rcvd_size == rc) {
+        if ((rc < 6/* Ver(1)+Type(1)+Length(4) */) 
+            || (frame[CefC_O_Fix_Ver] != CefC_Version)
+            || (frame[CefC_O_Fix_Type] != type) ){
+            fprintf (stderr, "cefbabelstatus: Response type is not status\n");
+            free (frame);
+            return (-1);
+        }
+            
+        memcpy (&msg_len, &frame[2], sizeof (uint32_t));
+        msg_len = ntohl (msg_len);
+        blocks = (msg_len) / CefC_Cbabel_Stat_Mtu;
+        if (((msg_len) % CefC_Cbabel_Stat_Mtu) != 0){
+            blocks += 1;
+        }
+        if (blocks > 1) {
+            void *new = realloc(frame, blocks * CefC_Cbabel_Stat_Mtu);
+            if (new == NULL) {
+                fprintf (stderr, "cefbabelstatus: Frame buffer allocation (realloc) error\n");
+                free (frame);
+                return (-1);
+            }
+            frame = new;
+            frame_size = blocks * CefC_Cbabel_Stat_Mtu;
+        }
+    }
+    if (rcvd_size < msg_len){
+        goto RERECV;
+    }
+    
+    *frame_r   = frame;
+    *msg_len_r = msg_len;
+    return (0);
+}
+static uint16_t
+get_u16 (
+    const unsigned char* p
+) {
+    uint16_t value16;
+    memcpy (&value16, p, sizeof (uint16_t));
+    return (ntohs (value16));
+}
+static unsigned long long
+get_u64 (
+    const unsigned char* p
+) {
+    uint32_t hi, lo;
+    memcpy (&hi, p, sizeof (uint32_t));
+    memcpy (&lo, p + 4, sizeof (uint32_t));
+    return (((unsigned long long) ntohl (hi) << 32) | ntohl (lo));
+}
+static void
+print_counters (
+    const unsigned char* body,
+    uint32_t len
+) {
+    uint32_t index = 0;
+    char addr[INET6_ADDRSTRLEN];
+    char name[CefC_Cbabel_Counters_NameLen + 1];
+    int num, i;
+    
+    if (len < 4) {
+        goto TRUNCATED;
+    }
+    if (get_u16 (body) != CefC_Cbabel_Counters_Ver) {
+        fprintf (stderr, "cefbabelstatus: Unknown counters version %d\n",
+                 get_u16 (body));
+        return;
+    }
+    num = get_u16 (body + 2);
+    index = 4;
+    if (index + num * 8 > len) {
+        goto TRUNCATED;
+    }
+    for (i = 0 ; i < num ; i++, index += 8) {
+        if (i < CefC_Cnt_Num) {
+            fprintf (stderr, "%-22s: %llu\n", counter_names[i], get_u64 (&body[index]));
+        } else {
+            fprintf (stderr, "Counter %-14d: %llu\n", i, get_u64 (&body[index]));
+        }
+    }
+    
+    if (index + 2 > len) {
+        goto TRUNCATED;
+    }
+    num = get_u16 (&body[index]);
+    index += 2;
+    if (index + num * 8 > len) {
+        goto TRUNCATED;
+    }
+    fprintf (stderr, "\nReceived TLVs\n");
+    for (i = 0 ; i < num ; i++, index += 8) {
+        unsigned long long value = get_u64 (&body[index]);
+        if (value == 0) {
+            continue;
+        }
+        if (i < sizeof (tlv_names) / sizeof (tlv_names[0])) {
+            fprintf (stderr, "  %-20s: %llu\n", tlv_names[i], value);
+        } else {
+            fprintf (stderr, "  Type %-15d: %llu\n", i, value);
+        }
+    }
+    
+    if (index + 2 > len) {
+        goto TRUNCATED;
+    }
+    num = get_u16 (&body[index]);
+    index += 2;
+    if (index + num * (CefC_Cbabel_Counters_NameLen + 32) > len) {
+        goto TRUNCATED;
+    }
+    fprintf (stderr, "\nInterface         Rx Packets       Rx Bytes "
+                     "      Tx Packets       Tx Bytes\n");
+    for (i = 0 ; i < num ; i++) {
+        memcpy (name, &body[index], CefC_Cbabel_Counters_NameLen);
+        name[CefC_Cbabel_Counters_NameLen] = 0;
+        index += CefC_Cbabel_Counters_NameLen;
+        fprintf (stderr, "%-16s %11llu %14llu %16llu %14llu\n", name,
+                 get_u64 (&body[index]), get_u64 (&body[index + 8]),
+                 get_u64 (&body[index + 16]), get_u64 (&body[index + 24]));
+        index += 32;
+    }
+    
+    if (index + 2 > len) {
+        goto TRUNCATED;
+    }
+    num = get_u16 (&body[index]);
+    index += 2;
+    if (index + num * (16 + CefC_Cbabel_Counters_NameLen + 4) > len) {
+        goto TRUNCATED;
+    }
+    fprintf (stderr, "\nNeighbour                               Interface         Reach  Cost\n");
+    for (i = 0 ; i < num ; i++) {
+        if (memcmp (&body[index], "\0\0\0\0\0\0\0\0\0\0\xff\xff", 12) == 0) {
+            inet_ntop (AF_INET, &body[index + 12], addr, sizeof (addr));
+        } else {
+            inet_ntop (AF_INET6, &body[index], addr, sizeof (addr));
+        }
+        index += 16;
+        memcpy (name, &body[index], CefC_Cbabel_Counters_NameLen);
+        name[CefC_Cbabel_Counters_NameLen] = 0;
+        index += CefC_Cbabel_Counters_NameLen;
+        fprintf (stderr, "%-39s %-16s %04x %5u\n", addr, name,
+                 get_u16 (&body[index]), get_u16 (&body[index + 2]));
+        index += 4;
+    }
+    fprintf (stderr, "\n");
+    return;
+    
+TRUNCATED:
+    fprintf (stderr, "cefbabelstatus: Counters response is truncated\n");
+}
+/* Upper bound, in us, of the bucket holding the given quantile */
+static unsigned long long
+latency_quantile (
+    const unsigned char* buckets,
+    int num,
+    unsigned long long count,
+    int percent
+) {
+    unsigned long long seen = 0;
+    uint32_t value32;
+    int b;
+    
+    for (b = 0 ; b < num ; b++) {
+        memcpy (&value32, &buckets[b * 4], sizeof (uint32_t));
+        seen += ntohl (value32);
+        if (seen * 100 >= count * percent) {
+            break;
+        }
+    }
+    return (1ULL << (b < num ? b : num - 1));
+}
+static void
+print_latency (
+    const unsigned char* body,
+    uint32_t len
+) {
+    uint32_t index;
+    int num, buckets, i;
+    
+    if (len < 8) {
+        goto TRUNCATED;
+    }
+    if (get_u16 (body) != CefC_Cbabel_Latency_Ver) {
+        fprintf (stderr, "cefbabelstatus: Unknown latency version %d\n",
+                 get_u16 (body));
+        return;
+    }
+    if (get_u16 (body + 2) == 0) {
+        fprintf (stderr, "Latency histograms are disabled "
+                         "(latency-histograms false).\n\n");
+    }
+    num = get_u16 (body + 4);
+    buckets = get_u16 (body + 6);
+    index = 8;
+    if (index + num * (24 + 4 * buckets) > len) {
+        goto TRUNCATED;
+    }
+    fprintf (stderr, "%-16s %10s %10s %10s %10s %10s\n",
+             "Operation", "Count", "Avg(us)", "p50(us)", "p99(us)", "Max(us)");
+    for (i = 0 ; i < num ; i++) {
+        unsigned long long count = get_u64 (&body[index]);
+        unsigned long long sum   = get_u64 (&body[index + 8]);
+        unsigned long long max   = get_u64 (&body[index + 16]);
+        const unsigned char* b   = &body[index + 24];
+        char name[32];
+        char p50[24], p99[24];
+        
+        index += 24 + 4 * buckets;
+        if (i < CefC_Lat_Num) {
+            snprintf (name, sizeof (name), "%s", latency_names[i]);
+        } else {
+            snprintf (name, sizeof (name), "Histogram %d", i);
+        }
+        if (count == 0) {
+            fprintf (stderr, "%-16s %10d\n", name, 0);
+            continue;
+        }
+        snprintf (p50, sizeof (p50), "<%llu", latency_quantile (b, buckets, count, 50));
+        snprintf (p99, sizeof (p99), "<%llu", latency_quantile (b, buckets, count, 99));
+        fprintf (stderr, "%-16s %10llu %10llu %10s %10s %10llu\n",
+                 name, count, sum / count / 1000, p50, p99, max / 1000);
+    }
+    fprintf (stderr, "\n");
+    return;
+    
+TRUNCATED:
+    fprintf (stderr, "cefbabelstatus: Latency response is truncated\n");
+}
+/*--------------------------------------------------------------------------------------
+    Prints a table, requesting it one page at a time.
+----------------------------------------------------------------------------------------*/
+static int                                  /* number of entries, or -1                 */
+dump_table (
+    const char* dst,                        /* host of cefbabeld                        */
+    const char* port_str,                   /* port of cefbabeld                        */
+    int table,                              /* CefC_Dump_*                              */
+    const char* filter                      /* name prefix, or ""                       */
+) {
+    unsigned char buff[CefC_Cbabel_Cmd_MaxLen + CefC_Cbabel_Dump_CursorMaxLen
+                        + CefC_Cbabel_Dump_FilterMaxLen];
+    unsigned char cursor[CefC_Cbabel_Dump_CursorMaxLen];
+    unsigned char* frame;
+    const unsigned char* body;
+    uint32_t msg_len, len;
+    uint16_t index, value16;
+    int cursor_len = 0;
+    int filter_len = strlen (filter);
+    int more = 1;
+    int total = 0;
+    int tcp_sock, res;
+    
+    while (more) {
+        tcp_sock = cef_connect_tcp_to_cbabeld (dst, port_str);
+        if (tcp_sock < 1) {
+            fprintf (stderr, "cefbabelstatus: [ERROR] connect to cefbabeld\n");
+            return (-1);
+        }
+        
+        /* Create Get Table Page message    */
+        buff[CefC_O_Fix_Ver]  = CefC_Version;
+        buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Dump;
+        index = CefC_Cbabel_CmdMsg_HeaderLen;
+        value16 = htons (CefC_Cbabel_Dump_Ver);
+        memcpy (&buff[index], &value16, sizeof (uint16_t));
+        index += sizeof (uint16_t);
+        buff[index++] = (unsigned char) table;
+        value16 = htons (CefC_Cbabel_Dump_MaxEntries);
+        memcpy (&buff[index], &value16, sizeof (uint16_t));
+        index += sizeof (uint16_t);
+        value16 = htons (cursor_len);
+        memcpy (&buff[index], &value16, sizeof (uint16_t));
+        index += sizeof (uint16_t);
+        memcpy (&buff[index], cursor, cursor_len);
+        index += cursor_len;
+        value16 = htons (filter_len);
+        memcpy (&buff[index], &value16, sizeof (uint16_t));
+        index += sizeof (uint16_t);
+        memcpy (&buff[index], filter, filter_len);
+        index += filter_len;
+        /* set Length   */
+        value16 = htons (index);
+        memcpy (buff + CefC_O_Length, &value16, CefC_S_Length);
+        
+        res = cef_cbabel_send_msg (tcp_sock, buff, index);
+        if (res < 0) {
+            fprintf (stderr, "cefbabelstatus: [ERROR] Send message\n");
+            close (tcp_sock);
+            return (-1);
+        }
+        res = cef_cbabel_recv_rsp (tcp_sock, CefC_Cbabel_Msg_Type_Dump, &frame, &msg_len);
+        close (tcp_sock);
+        if (res < 0) {
+            return (-1);
+        }
+        
+        /* Version(2) Table(1) More(1) NumEntries(2) CursorLen(2) Cursor Text   */
+        body = &frame[CefC_Cbabel_RspMsg_HeaderLen];
+        len  = msg_len - CefC_Cbabel_RspMsg_HeaderLen;
+        if (len < 8 || get_u16 (body) != CefC_Cbabel_Dump_Ver ||
+            get_u16 (body + 6) > CefC_Cbabel_Dump_CursorMaxLen ||
+            8 + get_u16 (body + 6) > len) {
+            fprintf (stderr, "cefbabelstatus: Table page is malformed\n");
+            free (frame);
+            return (-1);
+        }
+        more       = body[3];
+        total     += get_u16 (body + 4);
+        cursor_len = get_u16 (body + 6);
+        memcpy (cursor, body + 8, cursor_len);
+        fwrite (body + 8 + cursor_len, 1, len - 8 - cursor_len, stderr);
+        free (frame);
+    }
+    
+    return (total);
+}
+/*--------------------------------------------------------------------------------------
+    Receives exactly len bytes, waiting as long as it takes.
+----------------------------------------------------------------------------------------*/
+static int                                  /* The return value is negative if an error occurs  */
+recv_exact (
+    int tcp_sock,                           /* socket fd                                */
+    unsigned char* buff,                    /* buffer                                   */
+    uint32_t len                            /* bytes to receive                         */
+) {
+    struct pollfd fds[1];
+    uint32_t rcvd_size = 0;
+    int rc;
+    
+    while (rcvd_size < len) {
+        fds[0].fd = tcp_sock;
+        fds[0].events = POLLIN | POLLERR;
+        if (poll (fds, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf (stderr, "cefbabelstatus: poll error (%s)\n", strerror (errno));
+            return (-1);
+        }
+        rc = recv (tcp_sock, buff + rcvd_size, len - rcvd_size, 0);
+        if (rc < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                continue;
+            }
+            fprintf (stderr, "cefbabelstatus: Receive message error (%s)\n", strerror (errno));
+            return (-1);
+        }
+        if (rc == 0) {
+            fprintf (stderr, "cefbabelstatus: Connection closed by cefbabeld\n");
+            return (-1);
+        }
+        rcvd_size += rc;
+    }
+    return (0);
+}
+/*--------------------------------------------------------------------------------------
+    Prints the changes streamed by cefbabeld.  Whenever it reports that changes were
+    lost, which it does first thing, the tables are printed again.
+----------------------------------------------------------------------------------------*/
+static int                                  /* The return value is negative if an error occurs  */
+watch_events (
+    const char* dst,                        /* host of cefbabeld                        */
+    const char* port_str                    /* port of cefbabeld                        */
+) {
+    static const int resync_tables[] = {
+        CefC_Dump_Neighbours, CefC_Dump_Xroutes, CefC_Dump_Routes,
+    };
+    unsigned char buff[CefC_Cbabel_Cmd_MaxLen];
+    unsigned char header[CefC_Cbabel_RspMsg_HeaderLen];
+    unsigned char* body;
+    uint32_t msg_len;
+    uint16_t value16;
+    int tcp_sock, i;
+    
+    tcp_sock = cef_connect_tcp_to_cbabeld (dst, port_str);
+    if (tcp_sock < 1) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] connect to cefbabeld\n");
+        return (-1);
+    }
+    buff[CefC_O_Fix_Ver]  = CefC_Version;
+    buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Watch;
+    value16 = htons (CefC_Cbabel_CmdMsg_HeaderLen);
+    memcpy (buff + CefC_O_Length, &value16, CefC_S_Length);
+    if (cef_cbabel_send_msg (tcp_sock, buff, CefC_Cbabel_CmdMsg_HeaderLen) < 0) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] Send message\n");
+        close (tcp_sock);
+        return (-1);
+    }
+    
+    while (1) {
+        if (recv_exact (tcp_sock, header, CefC_Cbabel_RspMsg_HeaderLen) < 0) {
+            break;
+        }
+        memcpy (&msg_len, &header[CefC_O_Length], sizeof (uint32_t));
+        msg_len = ntohl (msg_len);
+        if (header[CefC_O_Fix_Ver] != CefC_Version ||
+            header[CefC_O_Fix_Type] != CefC_Cbabel_Msg_Type_Watch ||
+            msg_len < CefC_Cbabel_RspMsg_HeaderLen) {
+            fprintf (stderr, "cefbabelstatus: Watch frame is malformed\n");
+            break;
+        }
+        msg_len -= CefC_Cbabel_RspMsg_HeaderLen;
+        body = malloc (msg_len + 1);
+        if (body == NULL) {
+            fprintf (stderr, "cefbabelstatus: Frame buffer allocation (alloc) error\n");
+            break;
+        }
+        if (recv_exact (tcp_sock, body, msg_len) < 0) {
+            free (body);
+            break;
+        }
+        body[msg_len] = 0;
+        if (strcmp ((char*) body, "resync\n") == 0) {
+            fprintf (stderr, "----- resync -----\n");
+            for (i = 0 ; i < (int)(sizeof (resync_tables) / sizeof (resync_tables[0])) ; i++) {
+                fprintf (stderr, "----- %s -----\n", dump_table_names[resync_tables[i]]);
+                if (dump_table (dst, port_str, resync_tables[i], "") < 0) {
+                    free (body);
+                    close (tcp_sock);
+                    return (-1);
+                }
+            }
+            fprintf (stderr, "----- changes -----\n");
+        } else {
+            fwrite (body, 1, msg_len, stderr);
+        }
+        free (body);
+    }
+    
+    close (tcp_sock);
+    return (-1);
+}
+static uint32_t
+get_u32 (
+    const unsigned char* p
+) {
+    uint32_t value32;
+    memcpy (&value32, p, sizeof (uint32_t));
+    return (ntohl (value32));
+}
+/*--------------------------------------------------------------------------------------
+    Writes the URI of a name, as cefbabeld prints it
+----------------------------------------------------------------------------------------*/
+static void
+format_name (
+    char* buf,                              /* buffer to write the URI to               */
+    int size,                               /* size of buf                              */
+    const unsigned char* name,              /* name TLVs                                */
+    int len                                 /* length of name                           */
+) {
+    int x = 0, n = 0;
+    int j, seg_len, hname;
+    uint16_t sub_type;
+    
+    buf[n++] = '/';
+    while (x + 4 <= len && n < size - 16) {
+        sub_type = get_u16 (&name[x]);
+        seg_len  = get_u16 (&name[x + 2]);
+        x += 4;
+        if (seg_len > len - x) {
+            seg_len = len - x;
+        }
+        
+        /* Check if it contains non-print character */
+        hname = 0;
+        for (j = 0 ; j < seg_len ; j++) {
+            if (!isprint (name[x + j])) {
+                hname = 1;
+                break;
+            }
+        }
+        
+        if (!hname) {
+            if (sub_type >= 0x1000 && sub_type <= 0x1FFF) {
+                n += sprintf (&buf[n], "APP:%d=", sub_type - 0x1000);
+            } else if (sub_type != 0x0001) {
+                n += sprintf (&buf[n], "0x%02x%02x=", name[x - 4], name[x - 3]);
+            }
+            for (j = 0 ; j < seg_len && n < size - 16 ; j++) {
+                unsigned char c = name[x + j];
+                if (isalnum (c) || c == '-' || c == '.' || c == '/' ||
+                    c == '_' || c == '~') {
+                    buf[n++] = c;
+                } else {
+                    n += sprintf (&buf[n], "%02x", c);
+                }
+            }
+        } else {
+            n += sprintf (&buf[n], "0x");
+            for (j = 0 ; j < seg_len && n < size - 16 ; j++) {
+                n += sprintf (&buf[n], "%02x", name[x + j]);
+            }
+        }
+        buf[n++] = '/';
+        x += seg_len;
+    }
+    /* delete last '/' */
+    if (n > 0 && buf[n - 1] == '/') {
+        n--;
+    }
+    buf[n] = 0x00;
+}
+static void
+format_addr (
+    char* buf,                              /* at least INET6_ADDRSTRLEN bytes          */
+    const unsigned char* addr               /* address, IPv4 ones mapped                */
+) {
+    if (memcmp (addr, "\0\0\0\0\0\0\0\0\0\0\xff\xff", 12) == 0) {
+        inet_ntop (AF_INET, &addr[12], buf, INET6_ADDRSTRLEN);
+    } else {
+        inet_ntop (AF_INET6, addr, buf, INET6_ADDRSTRLEN);
+    }
+}
+static void
+format_id (
+    char* buf,                              /* at least 24 bytes                        */
+    const unsigned char* id                 /* router-id                                */
+) {
+    sprintf (buf, "%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
+             id[0], id[1], id[2], id[3], id[4], id[5], id[6], id[7]);
+}
+/* Copies a NUL-padded name field */
+static void
+format_ifname (
+    char* buf,                              /* at least NameLen + 1 bytes               */
+    const unsigned char* name               /* name field                               */
+) {
+    int i;
+    
+    memcpy (buf, name, CefC_Cbabel_Counters_NameLen);
+    buf[CefC_Cbabel_Counters_NameLen] = 0x00;
+    /* Interface names are printed as they are, even in JSON */
+    for (i = 0 ; buf[i] ; i++) {
+        if (!isprint ((unsigned char) buf[i]) || buf[i] == '"' || buf[i] == '\\') {
+            buf[i] = '?';
+        }
+    }
+}
+/*--------------------------------------------------------------------------------------
+    Prints one entry of a snapshot table, whose prefix key has been parsed
+----------------------------------------------------------------------------------------*/
+static void
+print_snapshot_entry (
+    FILE* out,                              /* stream to print to                       */
+    int table,                              /* CefC_Snap_*                              */
+    const unsigned char* p,                 /* fixed fields of the entry                */
+    const char* prefix,                     /* URI of the prefix                        */
+    const char* from,                       /* source prefix, or ""                     */
+    const unsigned char** neighs,           /* entries of the neighbours table          */
+    int num_neighs,                         /* number of neighbours                     */
+    int json,                               /* print JSON instead of text               */
+    int first                               /* first entry of the table                 */
+) {
+    char addr[INET6_ADDRSTRLEN], addr2[INET6_ADDRSTRLEN];
+    char id[24];
+    char ifname[CefC_Cbabel_Counters_NameLen + 1];
+    const unsigned char* neigh;
+    const char* sep = first ? "\n    " : ",\n    ";
+    
+    switch (table) {
+    case CefC_Snap_Neighbours:
+        format_addr (addr, p);
+        format_ifname (ifname, p + 16);
+        p += 16 + CefC_Cbabel_Counters_NameLen;
+        if (json) {
+            fprintf (out, "%s{\"address\": \"%s\", \"interface\": \"%s\", "
+                     "\"reach\": %u, \"ureach\": %u, \"rxcost\": %u, \"txcost\": %u, "
+                     "\"rtt\": %u, \"rttcost\": %u, \"cost\": %u}",
+                     sep, addr, ifname, get_u16 (p), get_u16 (p + 2),
+                     get_u16 (p + 4), get_u16 (p + 6), get_u32 (p + 8),
+                     get_u16 (p + 12), get_u16 (p + 14));
+        } else {
+            fprintf (out, "Neighbour %s dev %s reach %04x ureach %04x rxcost %u "
+                     "txcost %u rtt %u.%.3u rttcost %u cost %u\n",
+                     addr, ifname, get_u16 (p), get_u16 (p + 2),
+                     get_u16 (p + 4), get_u16 (p + 6),
+                     get_u32 (p + 8) / 1000, get_u32 (p + 8) % 1000,
+                     get_u16 (p + 12), get_u16 (p + 14));
+        }
+        break;
+    case CefC_Snap_Xroutes:
+        if (json) {
+            fprintf (out, "%s{\"prefix\": \"%s\", \"from\": \"%s\", \"metric\": %u, "
+                     "\"ifindex\": %u, \"proto\": %d}",
+                     sep, prefix, from, get_u16 (p), get_u32 (p + 2),
+                     (int) get_u32 (p + 6));
+        } else {
+            fprintf (out, "%s%s%s metric %u ifindex %u proto %d (exported)\n",
+                     prefix, from[0] ? " from " : "", from, get_u16 (p),
+                     get_u32 (p + 2), (int) get_u32 (p + 6));
+        }
+        break;
+    case CefC_Snap_Routes:
+        format_id (id, p);
+        neigh = get_u16 (p + 20) < num_neighs ? neighs[get_u16 (p + 20)] : NULL;
+        if (neigh) {
+            format_addr (addr, neigh);
+            format_ifname (ifname, neigh + 16);
+        } else {
+            strcpy (addr, "?");
+            strcpy (ifname, "?");
+        }
+        format_addr (addr2, p + 22);
+        if (json) {
+            fprintf (out, "%s{\"prefix\": \"%s\", \"from\": \"%s\", \"id\": \"%s\", "
+                     "\"seqno\": %u, \"metric\": %u, \"refmetric\": %u, \"cost\": %u, "
+                     "\"add_metric\": %u, \"smoothed_metric\": %u, "
+                     "\"neighbour\": \"%s\", \"interface\": \"%s\", \"nexthop\": \"%s\", "
+                     "\"port\": %u, \"age\": %u, \"installed\": %s, \"feasible\": %s}",
+                     sep, prefix, from, id, get_u16 (p + 8), get_u16 (p + 10),
+                     get_u16 (p + 12), get_u16 (p + 14), get_u16 (p + 16),
+                     get_u16 (p + 18), addr, ifname, addr2, get_u16 (p + 38),
+                     get_u32 (p + 40),
+                     (p[44] & CefC_Snap_Installed) ? "true" : "false",
+                     (p[44] & CefC_Snap_Feasible) ? "true" : "false");
+        } else {
+            fprintf (out, "%s%s%s metric %u (%u) refmetric %u id %s seqno %u age %u "
+                     "via %s neigh %s%s%s port %u%s\n",
+                     prefix, from[0] ? " from " : "", from,
+                     get_u16 (p + 10), get_u16 (p + 18), get_u16 (p + 12), id,
+                     get_u16 (p + 8), get_u32 (p + 40), ifname, addr,
+                     strcmp (addr, addr2) ? " nexthop " : "",
+                     strcmp (addr, addr2) ? addr2 : "", get_u16 (p + 38),
+                     (p[44] & CefC_Snap_Installed) ? " (installed)" :
+                     (p[44] & CefC_Snap_Feasible) ? " (feasible)" : "");
+        }
+        break;
+    case CefC_Snap_Sources:
+        format_id (id, p);
+        if (json) {
+            fprintf (out, "%s{\"prefix\": \"%s\", \"from\": \"%s\", \"id\": \"%s\", "
+                     "\"seqno\": %u, \"metric\": %u, \"route_count\": %u, \"age\": %u}",
+                     sep, prefix, from, id, get_u16 (p + 8), get_u16 (p + 10),
+                     get_u16 (p + 12), get_u32 (p + 14));
+        } else {
+            fprintf (out, "%s%s%s sourceId=%s seqno=%u my_FD=%u route_count=%u age=%u\n",
+                     prefix, from[0] ? " from " : "", from, id, get_u16 (p + 8),
+                     get_u16 (p + 10), get_u16 (p + 12), get_u32 (p + 14));
+        }
+        break;
+    case CefC_Snap_Bestroutes:
+        format_id (id, p);
+        if (json) {
+            fprintf (out, "%s{\"prefix\": \"%s\", \"from\": \"%s\", \"id\": \"%s\", "
+                     "\"seqno\": %u, \"fd\": %u, \"routes\": %u}",
+                     sep, prefix, from, id, get_u16 (p + 8), get_u16 (p + 10),
+                     get_u16 (p + 12));
+        } else {
+            fprintf (out, "%s%s%s my_sourceId=%s my_seqNo=%u my_FD=%u routes=%u\n",
+                     prefix, from[0] ? " from " : "", from, id, get_u16 (p + 8),
+                     get_u16 (p + 10), get_u16 (p + 12));
+        }
+        break;
+    case CefC_Snap_Resends:
+        format_id (id, p + 10);
+        format_ifname (ifname, p + 18);
+        if (json) {
+            fprintf (out, "%s{\"prefix\": \"%s\", \"from\": \"%s\", \"kind\": \"%s\", "
+                     "\"max\": %u, \"delay\": %u, \"age_ms\": %u, \"seqno\": %u, "
+                     "\"id\": \"%s\", \"interface\": \"%s\"}",
+                     sep, prefix, from, p[0] == 1 ? "request" : "update", p[1],
+                     get_u16 (p + 2), get_u32 (p + 4), get_u16 (p + 8), id, ifname);
+        } else {
+            fprintf (out, "%s %s%s%s seqno %u id %s dev %s max %u delay %u age %ums\n",
+                     p[0] == 1 ? "request" : "update", prefix,
+                     from[0] ? " from " : "", from, get_u16 (p + 8), id,
+                     ifname[0] ? ifname : "any", p[1], get_u16 (p + 2), get_u32 (p + 4));
+        }
+        break;
+    }
+}
+/*--------------------------------------------------------------------------------------
+    Prints a snapshot of the tables as text or JSON
+----------------------------------------------------------------------------------------*/
+static int                                  /* The return value is negative if an error occurs  */
+print_snapshot (
+    FILE* out,                              /* stream to print to                       */
+    const unsigned char* snap,              /* snapshot                                 */
+    uint32_t len,                           /* length of the snapshot                   */
+    int json                                /* print JSON instead of text               */
+) {
+    static const int fixed_lens[CefC_Snap_Num] = {
+        0, 16 + CefC_Cbabel_Counters_NameLen + 16, 10, 45, 18, 14,
+        18 + CefC_Cbabel_Counters_NameLen,
+    };
+    char prefix[8192];
+    char from[INET6_ADDRSTRLEN + 8];
+    char id[24];
+    const unsigned char** neighs = NULL;
+    int num_neighs = 0, max_neighs = 0;
+    uint32_t index, end, num, tlen, e;
+    int ntables, table, plen, src_plen, t;
+    
+    if (len < CefC_Cbabel_Snapshot_HeaderLen ||
+        memcmp (snap, CefC_Cbabel_Snapshot_Magic, 4) != 0) {
+        fprintf (stderr, "cefbabelstatus: Not a snapshot\n");
+        return (-1);
+    }
+    if (get_u16 (snap + 4) != CefC_Cbabel_Snapshot_Ver) {
+        fprintf (stderr, "cefbabelstatus: Snapshot version %u is not supported\n",
+                 get_u16 (snap + 4));
+        return (-1);
+    }
+    format_id (id, snap + 14);
+    ntables = get_u16 (snap + 24);
+    if (json) {
+        fprintf (out, "{\"version\": %u, \"time\": %llu, \"id\": \"%s\", \"seqno\": %u",
+                 get_u16 (snap + 4), get_u64 (snap + 6), id, get_u16 (snap + 22));
+    } else {
+        fprintf (out, "My id %s seqno %u time %llu\n",
+                 id, get_u16 (snap + 22), get_u64 (snap + 6));
+    }
+    
+    index = CefC_Cbabel_Snapshot_HeaderLen;
+    for (t = 0 ; t < ntables ; t++) {
+        /* Table(1) NumEntries(4) Length(4) */
+        if (index + 9 > len) {
+            goto TRUNCATED;
+        }
+        table = snap[index];
+        num   = get_u32 (&snap[index + 1]);
+        tlen  = get_u32 (&snap[index + 5]);
+        index += 9;
+        if (tlen > len - index) {
+            goto TRUNCATED;
+        }
+        end = index + tlen;
+        if (table <= 0 || table >= CefC_Snap_Num) {
+            /* Skip the tables of later versions */
+            index = end;
+            continue;
+        }
+        if (table == CefC_Snap_Neighbours && neighs == NULL) {
+            if (num > tlen / fixed_lens[table]) {
+                goto TRUNCATED;
+            }
+            neighs = calloc (num + 1, sizeof (unsigned char*));
+            if (neighs == NULL) {
+                fprintf (stderr, "cefbabelstatus: Snapshot buffer allocation (alloc) error\n");
+                return (-1);
+            }
+            max_neighs = num;
+        }
+        if (json) {
+            fprintf (out, ",\n  \"%s\": [", snapshot_table_names[table]);
+        } else {
+            fprintf (out, "----- %s -----\n", snapshot_table_names[table]);
+        }
+        for (e = 0 ; e < num ; e++) {
+            if (fixed_lens[table] > end - index) {
+                goto TRUNCATED;
+            }
+            prefix[0] = 0x00;
+            from[0]   = 0x00;
+            plen = 0;
+            if (table != CefC_Snap_Neighbours) {
+                /* Plen(2) SrcPlen(1) SrcPrefix(16) Prefix(Plen) */
+                const unsigned char* key = &snap[index + fixed_lens[table]];
+                if (19 > end - index - fixed_lens[table]) {
+                    goto TRUNCATED;
+                }
+                plen = get_u16 (key);
+                src_plen = key[2];
+                if (19 + plen > end - index - fixed_lens[table]) {
+                    goto TRUNCATED;
+                }
+                format_name (prefix, sizeof (prefix), key + 19, plen);
+                if (src_plen > 0) {
+                    format_addr (from, key + 3);
+                    sprintf (&from[strlen (from)], "/%d",
+                             memcmp (key + 3, "\0\0\0\0\0\0\0\0\0\0\xff\xff", 12) == 0 ?
+                             src_plen - 96 : src_plen);
+                }
+                plen += 19;
+            } else if (num_neighs < max_neighs) {
+                /* Routes refer to them by position */
+                neighs[num_neighs++] = &snap[index];
+            }
+            print_snapshot_entry (out, table, &snap[index], prefix, from,
+                                  neighs, num_neighs, json, e == 0);
+            index += fixed_lens[table] + plen;
+        }
+        if (json) {
+            fprintf (out, num ? "\n  ]" : "]");
+        }
+        index = end;
+    }
+    if (json) {
+        fprintf (out, "\n}\n");
+    }
+    free (neighs);
+    return (0);
+    
+TRUNCATED:
+    if (json) {
+        fprintf (out, "\n");
+    }
+    fprintf (stderr, "cefbabelstatus: Snapshot is truncated\n");
+    free (neighs);
+    return (-1);
+}
+/* A prefix named at the end of a trace */
+struct trace_name {
+    uint32_t ref;
+    const unsigned char* name;
+    int len;
+};
+static int
+trace_name_compare (
+    const void* a,
+    const void* b
+) {
+    uint32_t ra = ((const struct trace_name*) a)->ref;
+    uint32_t rb = ((const struct trace_name*) b)->ref;
+    return (ra < rb ? -1 : ra > rb ? 1 : 0);
+}
+/*--------------------------------------------------------------------------------------
+    Prints a trace of the events as text or JSON
+----------------------------------------------------------------------------------------*/
+static int                                  /* The return value is negative if an error occurs  */
+print_trace (
+    FILE* out,                              /* stream to print to                       */
+    const unsigned char* trace,             /* trace                                    */
+    uint32_t len,                           /* length of the trace                      */
+    int json                                /* print JSON instead of text               */
+) {
+    static const char* flag_names[] = { "seqno", "batched", "installed" };
+    struct trace_name* names = NULL;
+    struct trace_name key, *found;
+    char prefix[8192];
+    char addr[24];
+    const unsigned char* r;
+    uint32_t index, num, num_names, i;
+    int rlen, type, flags, f, nf;
+    
+    if (len < CefC_Cbabel_Trace_HeaderLen ||
+        memcmp (trace, CefC_Cbabel_Trace_Magic, 4) != 0) {
+        fprintf (stderr, "cefbabelstatus: Not a trace\n");
+        return (-1);
+    }
+    if (get_u16 (trace + 4) != CefC_Cbabel_Trace_Ver) {
+        fprintf (stderr, "cefbabelstatus: Trace version %u is not supported\n",
+                 get_u16 (trace + 4));
+        return (-1);
+    }
+    rlen      = get_u16 (trace + 14);
+    num       = get_u32 (trace + 16);
+    num_names = get_u32 (trace + 28);
+    if (rlen < CefC_Cbabel_Trace_RecordLen ||
+        num > (len - CefC_Cbabel_Trace_HeaderLen) / rlen) {
+        goto TRUNCATED;
+    }
+    
+    /* Ref(4) Plen(2) Prefix(Plen), after the records */
+    index = CefC_Cbabel_Trace_HeaderLen + num * rlen;
+    if (num_names > (len - index) / 6) {
+        goto TRUNCATED;
+    }
+    names = calloc (num_names + 1, sizeof (struct trace_name));
+    if (names == NULL) {
+        fprintf (stderr, "cefbabelstatus: Trace buffer allocation (alloc) error\n");
+        return (-1);
+    }
+    for (i = 0 ; i < num_names ; i++) {
+        if (6 > len - index || 6 + get_u16 (trace + index + 4) > len - index) {
+            goto TRUNCATED;
+        }
+        names[i].ref  = get_u32 (trace + index);
+        names[i].len  = get_u16 (trace + index + 4);
+        names[i].name = trace + index + 6;
+        index += 6 + names[i].len;
+    }
+    qsort (names, num_names, sizeof (struct trace_name), trace_name_compare);
+    
+    if (json) {
+        fprintf (out, "{\"version\": %u, \"time\": %llu, \"total\": %llu, \"events\": [",
+                 get_u16 (trace + 4), get_u64 (trace + 6), get_u64 (trace + 20));
+    } else {
+        fprintf (out, "%u of %llu events, time %llu\n",
+                 num, get_u64 (trace + 20), get_u64 (trace + 6));
+    }
+    for (i = 0 ; i < num ; i++) {
+        r = trace + CefC_Cbabel_Trace_HeaderLen + i * rlen;
+        type  = r[28];
+        flags = r[29];
+        key.ref = get_u32 (r + 8);
+        if (key.ref == 0) {
+            strcpy (prefix, "*");
+        } else {
+            found = bsearch (&key, names, num_names, sizeof (struct trace_name),
+                             trace_name_compare);
+            if (found) {
+                format_name (prefix, sizeof (prefix), found->name, found->len);
+            } else {
+                /* No longer known to cefbabeld */
+                sprintf (prefix, "#%08x", key.ref);
+            }
+        }
+        sprintf (addr, "::%02x%02x:%02x%02x", r[16], r[17], r[18], r[19]);
+        if (json) {
+            fprintf (out, "%s\n  {\"time\": %u.%06u, \"event\": ", i ? "," : "",
+                     get_u32 (r), get_u32 (r + 4));
+            if (type > 0 && type < CefC_Trace_Num) {
+                fprintf (out, "\"%s\"", trace_event_names[type]);
+            } else {
+                fprintf (out, "%d", type);
+            }
+            fprintf (out, ", \"prefix\": \"%s\", \"plen\": %u, \"address\": \"%s\", "
+                     "\"ifindex\": %u, \"seqno\": %u, \"metric\": %u, \"arg\": %u, "
+                     "\"flags\": [",
+                     prefix, get_u16 (r + 20), addr, get_u16 (r + 22),
+                     get_u16 (r + 24), get_u16 (r + 26), get_u32 (r + 12));
+            for (f = 0, nf = 0 ; f < 3 ; f++) {
+                if (flags & (1 << f)) {
+                    fprintf (out, "%s\"%s\"", nf++ ? ", " : "", flag_names[f]);
+                }
+            }
+            fprintf (out, "]}");
+        } else {
+            fprintf (out, "%u.%06u ", get_u32 (r), get_u32 (r + 4));
+            if (type > 0 && type < CefC_Trace_Num) {
+                fprintf (out, "%-11s", trace_event_names[type]);
+            } else {
+                fprintf (out, "%-11d", type);
+            }
+            fprintf (out, " %s via %s if %u seqno %u metric %u arg %u",
+                     prefix, addr, get_u16 (r + 22), get_u16 (r + 24),
+                     get_u16 (r + 26), get_u32 (r + 12));
+            for (f = 0 ; f < 3 ; f++) {
+                if (flags & (1 << f)) {
+                    fprintf (out, " %s", flag_names[f]);
+                }
+            }
+            fprintf (out, "\n");
+        }
+    }
+    if (json) {
+        fprintf (out, num ? "\n]}\n" : "]}\n");
+    }
+    free (names);
+    return (0);
+    
+TRUNCATED:
+    fprintf (stderr, "cefbabelstatus: Trace is truncated\n");
+    free (names);
+    return (-1);
+}
+/*--------------------------------------------------------------------------------------
+    Gets a snapshot of the tables, or the event trace, from cefbabeld, and prints or
+    saves it
+----------------------------------------------------------------------------------------*/
+static int                                  /* The return value is negative if an error occurs  */
+get_snapshot (
+    const char* dst,                        /* host of cefbabeld                        */
+    const char* port_str,                   /* port of cefbabeld                        */
+    int type,                               /* Get Snapshot or Get Trace                */
+    const char* out_file,                   /* file to save the snapshot to, or NULL    */
+    int json                                /* print JSON instead of text               */
+) {
+    unsigned char buff[CefC_Cbabel_CmdMsg_HeaderLen];
+    unsigned char* frame;
+    uint32_t msg_len;
+    uint16_t value16;
+    FILE* fp;
+    int tcp_sock, res;
+    
+    tcp_sock = cef_connect_tcp_to_cbabeld (dst, port_str);
+    if (tcp_sock < 1) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] connect to cefbabeld\n");
+        return (-1);
+    }
+    buff[CefC_O_Fix_Ver]  = CefC_Version;
+    buff[CefC_O_Fix_Type] = type;
+    value16 = htons (CefC_Cbabel_CmdMsg_HeaderLen);
+    memcpy (buff + CefC_O_Length, &value16, CefC_S_Length);
+    if (cef_cbabel_send_msg (tcp_sock, buff, CefC_Cbabel_CmdMsg_HeaderLen) < 0) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] Send message\n");
+        close (tcp_sock);
+        return (-1);
+    }
+    res = cef_cbabel_recv_rsp (tcp_sock, type, &frame, &msg_len);
+    close (tcp_sock);
+    if (res < 0) {
+        return (-1);
+    }
+    
+    if (out_file) {
+        fp = fopen (out_file, "wb");
+        if (fp == NULL) {
+            fprintf (stderr, "cefbabelstatus: [ERROR] %s: %s\n", out_file, strerror (errno));
+            free (frame);
+            return (-1);
+        }
+        if (fwrite (&frame[CefC_Cbabel_RspMsg_HeaderLen], 1,
+                    msg_len - CefC_Cbabel_RspMsg_HeaderLen, fp)
+                != msg_len - CefC_Cbabel_RspMsg_HeaderLen || fclose (fp) != 0) {
+            fprintf (stderr, "cefbabelstatus: [ERROR] %s: %s\n", out_file, strerror (errno));
+            free (frame);
+            return (-1);
+        }
+        fprintf (stderr, "cefbabelstatus: %u bytes saved to %s\n",
+                 msg_len - CefC_Cbabel_RspMsg_HeaderLen, out_file);
+        res = 0;
+    } else if (type == CefC_Cbabel_Msg_Type_Trace) {
+        res = print_trace (stdout, &frame[CefC_Cbabel_RspMsg_HeaderLen],
+                           msg_len - CefC_Cbabel_RspMsg_HeaderLen, json);
+    } else {
+        res = print_snapshot (stdout, &frame[CefC_Cbabel_RspMsg_HeaderLen],
+                              msg_len - CefC_Cbabel_RspMsg_HeaderLen, json);
+    }
+    free (frame);
+    return (res);
+}
+/*--------------------------------------------------------------------------------------
+    Prints a snapshot or a trace saved to a file
+----------------------------------------------------------------------------------------*/
+static int                                  /* The return value is negative if an error occurs  */
+read_snapshot (
+    const char* file,                       /* snapshot or trace file                   */
+    int type,                               /* Get Snapshot or Get Trace                */
+    int json                                /* print JSON instead of text               */
+) {
+    unsigned char* snap;
+    long len;
+    FILE* fp;
+    int res;
+    
+    fp = fopen (file, "rb");
+    if (fp == NULL) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] %s: %s\n", file, strerror (errno));
+        return (-1);
+    }
+    if (fseek (fp, 0, SEEK_END) < 0 || (len = ftell (fp)) < 0 ||
+        fseek (fp, 0, SEEK_SET) < 0) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] %s: %s\n", file, strerror (errno));
+        fclose (fp);
+        return (-1);
+    }
+    snap = malloc (len + 1);
+    if (snap == NULL) {
+        fprintf (stderr, "cefbabelstatus: Snapshot buffer allocation (alloc) error\n");
+        fclose (fp);
+        return (-1);
+    }
+    if (fread (snap, 1, len, fp) != (size_t) len) {
+        fprintf (stderr, "cefbabelstatus: [ERROR] %s: short read\n", file);
+        free (snap);
+        fclose (fp);
+        return (-1);
+    }
+    fclose (fp);
+    
+    if (type == CefC_Cbabel_Msg_Type_Trace) {
+        res = print_trace (stdout, snap, len, json);
+    } else {
+        res = print_snapshot (stdout, snap, len, json);
+    }
+    free (snap);
+    return (res);
+}
@@ -69,6 +69,25 @@
 #ifndef BABELD_CODE //+++++ ADD +++++
 #include "source.h"
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+#include "damping.h"
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+#include "latency.h"
+#endif //----- ADD for LATENCY -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+#include "convergence.h"
+#endif //----- ADD for CONVERGENCE -----
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+#include "local.h"
+#include "watch.h"
+#endif //----- ADD for WATCH -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+#include "snapshot.h"
+#endif //----- ADD for SNAPSHOT -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+#include "trace.h"
+#endif //----- ADD for TRACE -----
 
 /****************************************************************************************
  Macros
@@ -83,6 +102,13 @@
 #define Cmd_FibDel                  "/CTRLBABELD"
 #define Cmd_FibDel_Len              strlen (Cmd_FibDel)
 
+#define Fib_Batch_Size              65535
+#define Fib_Batch_Timeout           1000        /* ms to wait for batched replies */
+
+/* Room left in a status response of index bytes, never negative */
+#define Stat_Rsp_Room(index) \
+    ((index) < CefC_Cbabel_Stat_Mtu ? CefC_Cbabel_Stat_Mtu - (int)(index) : 0)
+
 /****************************************************************************************
  Structures Declaration
  ****************************************************************************************/
@@ -114,6 +140,30 @@ static char cef_conf_dir[PATH_MAX] = {"/usr/local/cefore"};
 static unsigned char v4prefix[16] =
     {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0, 0, 0, 0 };
 
+/* FIB requests queued by cefore_fib_*_batch_add */
+static unsigned char fib_batch[Fib_Batch_Size];
+static int fib_batch_len = 0;
+static int fib_batch_num = 0;
+/* Nesting depth of cefore_fib_defer_begin */
+static int fib_defer = 0;
+/* Listen socket of cefbabelstatus requests */
+static int tcp_listen_fd = -1;
+/* Connections of cefbabelstatus: each request comes in, then its response
+   goes out, a piece at a time as the socket allows. */
+struct cefbabel_stat_client {
+    int fd;
+    time_t since;                           /* accepted at, or last written to          */
+    int in_len;
+    unsigned char in[CefC_Cbabel_Cmd_MaxLen + CefC_Cbabel_Dump_CursorMaxLen
+                        + CefC_Cbabel_Dump_FilterMaxLen];
+    unsigned char* out;                     /* output not written yet                   */
+    int out_start;
+    int out_len;
+    int replied;                            /* out holds the response                   */
+};
+static struct cefbabel_stat_client stat_clients[CefC_Cbabel_Stat_MaxClients];
+static int stat_client_num = 0;
+
 /****************************************************************************************
  Static Function Declaration
  ****************************************************************************************/
@@ -127,16 +177,101 @@ cefore_trim_line_string (
     char* p2,                                   /* name string after trimming           */
     char* p3                                    /* value string after trimming          */
 );
+/*--------------------------------------------------------------------------------------
+    Creates the FIB Add Request message
+----------------------------------------------------------------------------------------*/
+static int
+cefore_fib_add_msg_create (
+    unsigned char* msg, 
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface,
+    int weight
+);
+/*--------------------------------------------------------------------------------------
+    Creates the FIB Delete Request message
+----------------------------------------------------------------------------------------*/
+static int
+cefore_fib_del_msg_create (
+    unsigned char* msg, 
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+);
+/*--------------------------------------------------------------------------------------
+    Sends a FIB Add Request to cefnetd and waits for its response
+----------------------------------------------------------------------------------------*/
+static int
+cefore_fib_add_req_exchange (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+);
+/*--------------------------------------------------------------------------------------
+    Sends a FIB Delete Request to cefnetd and waits for its response
+----------------------------------------------------------------------------------------*/
+static int
+cefore_fib_del_req_exchange (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+);
+/*--------------------------------------------------------------------------------------
+    Sends the queued FIB Requests
+----------------------------------------------------------------------------------------*/
+static int
+cefore_fib_batch_flush (
+    void
+);
+/*--------------------------------------------------------------------------------------
+    Counts and traces num failed FIB Requests
+----------------------------------------------------------------------------------------*/
+static void
+cefore_fib_failed (
+    int num
+);
 
 
 /*--------------------------------------------------------------------------------------
-    Send status command to cefbbabald.
+    Writes the body of the Get Counters response
+----------------------------------------------------------------------------------------*/
+static int                                  /* length of the body                       */
+cefbabel_counters_rsp_create (
+    unsigned char* buff,                    /* buffer to write the body to              */
+    int len                                 /* size of buff                             */
+);
+/*--------------------------------------------------------------------------------------
+    Writes the body of the Get Latency response
 ----------------------------------------------------------------------------------------*/
-static int                                  /* The return value is negative if an error occurs  */
-cef_cbabel_send_msg (
-    int fd,                                 /* socket fd                                */
-    unsigned char* msg,                     /* send message                             */
-    uint16_t msg_len                        /* message length                           */
+static int                                  /* length of the body                       */
+cefbabel_latency_rsp_create (
+    unsigned char* buff                     /* buffer to write the body to              */
+);
+/*--------------------------------------------------------------------------------------
+    Writes the body of the Get Table Page response
+----------------------------------------------------------------------------------------*/
+static int                                  /* length of the body, or -1                */
+cefbabel_dump_rsp_create (
+    unsigned char* buff,                    /* buffer to write the body to              */
+    int len,                                /* size of buff                             */
+    const unsigned char* req,               /* request body                             */
+    int req_len                             /* length of the request body               */
+);
+/*--------------------------------------------------------------------------------------
+    Creates the Get Snapshot or Get Trace response
+----------------------------------------------------------------------------------------*/
+static int                                  /* length of the response, or -1            */
+cefbabel_bulk_rsp_create (
+    int type,                               /* type of the request                      */
+    unsigned char** rsp_r                   /* allocated response                       */
 );
 
 
@@ -441,6 +576,9 @@ cefore_xroute_update (
     croute.plen     = length;
     croute.metric   = 0;
     croute.src_plen = 128;
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_start (croute.prefix, croute.plen);
+#endif //----- ADD for CONVERGENCE -----
     
     FOR_ALL_INTERFACES(ifp) {
         
@@ -462,18 +600,11 @@ cefore_xroute_update (
                 croute.metric, croute.ifindex, 0);
             if (rc == 1) {
                 if (route_ctrl_type == ROUTE_CTRL_TYPE_MM) {        	
-                    struct source* src;
 	                unsigned char src_prefix[16];
 	                memset(src_prefix, 0, sizeof(src_prefix));
    	                clear_all_routes_mpms(croute.prefix, croute.plen, src_prefix, 0);
                     delete_bestroute_entry(croute.prefix, croute.plen, src_prefix, 0);
-                    while(1) {
-                        src = get_src_rcd_mp(croute.prefix, croute.plen, src_prefix, 0);
-                        if (src == NULL){
-        	                break;
-                        }
-                        delete_source_mp(src);
-                    }
+                    delete_sources_mp(croute.prefix, croute.plen, src_prefix, 0);
                 }
                 send_update(NULL, 0, 
                 croute.prefix, croute.plen, croute.src_prefix, croute.src_plen);
@@ -494,6 +625,10 @@ cefore_xroute_update (
             if (route) {
                 route->installed = 0;
                 route->refmetric = 0xFFFF;
+                bestroute_metric_changed(route);
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+                local_notify_route(route, LOCAL_CHANGE);
+#endif //----- ADD for WATCH -----
                 rc = 1;
             }
             
@@ -503,32 +638,32 @@ cefore_xroute_update (
             }
         }
     }
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_settle ();
+#endif //----- ADD for CONVERGENCE -----
     
     return (1);
 }
-int 
-cefore_fib_add_req_send (
+static int
+cefore_fib_add_msg_create (
+    unsigned char* msg, 
     const unsigned char* prefix, 
     int plen, 
     const unsigned char* nexthop, 
     unsigned short port,
-    char* interface
+    char* interface,
+    int weight
 ) {
-    unsigned char msg[65535];
     uint16_t index;
     struct tlv_hdr tlv_hdr;
     const char* node;
     uint16_t value16;
-    int rc;
     char hostname[1024];
-
-    if(cefore_socket == -1){
-        return(-1);
-    }
     
     /*-----------------------------------------------------------
         Create FIB Add Request
     -------------------------------------------------------------*/
+    cefstat.fib_add++;
     memcpy (&msg[0], Cmd_FibAdd, Cmd_FibAdd_Len);
     index = Cmd_FibAdd_Len + sizeof (uint16_t);
     
@@ -564,13 +699,74 @@ cefore_fib_add_req_send (
     memcpy (&msg[index], &port, sizeof (unsigned short));
     index += sizeof (unsigned short);
     
+    /* Set T_COST (only understood by a cefnetd with weighted faces) */
+    if (weight >= 0) {
+        value16 = (uint16_t) weight;
+        tlv_hdr.type   = 0x0002/* T_COST */;
+        tlv_hdr.length = sizeof (uint16_t);
+        memcpy (&msg[index], &tlv_hdr, sizeof (struct tlv_hdr));
+        index += sizeof (struct tlv_hdr);
+        memcpy (&msg[index], &value16, sizeof (uint16_t));
+        index += sizeof (uint16_t);
+    }
+    
     value16 = index - (Cmd_FibAdd_Len + sizeof (uint16_t));
     memcpy (&msg[Cmd_FibAdd_Len], &value16, sizeof (uint16_t));
     
+    return (index);
+}
 
+int 
+cefore_fib_add_req_send (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+) {
+    int rc;
+
+    if(cefore_socket == -1){
+        return(-1);
+    }
+    if (fib_defer) {
+        return (cefore_fib_add_batch_add (prefix, plen, nexthop, port, interface, -1));
+    }
+    USDT_PROBE3 (fib_add_start, prefix, plen, port);
+    rc = cefore_fib_add_req_exchange (prefix, plen, nexthop, port, interface);
+    USDT_PROBE3 (fib_add_end, prefix, plen, rc);
+    
+    return (rc);
+}
+
+static int 
+cefore_fib_add_req_exchange (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+) {
+    unsigned char msg[65535];
+    uint16_t index;
+    int rc;
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    struct timespec start;
+#endif //----- ADD for LATENCY -----
+
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix (CefC_Trace_Fib_Add, prefix, plen, nexthop, 0, 0, 0xFFFF, port, 0);
+#endif //----- ADD for TRACE -----
+    
+    index = cefore_fib_add_msg_create (msg, prefix, plen, nexthop, port, interface, -1);
+
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    latency_start (&start);
+#endif //----- ADD for LATENCY -----
     rc = send (cefore_socket, msg, index, 0);
     if (rc < 0) {
         cefore_socket = -1;
+        cefore_fib_failed (1);
         return (-1);
     }
 {
@@ -582,40 +778,49 @@ cefore_fib_add_req_send (
         rc = recv (cefore_socket, msg, 65535, 0);
         if (rc < 0) {
             cefore_socket = -1;
+            cefore_fib_failed (1);
             return (-1);
         }
     } else {
         cefore_socket = -1;
+        cefore_fib_failed (1);
         return (-1);
     }
 }
 
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    latency_record (CefC_Lat_Fib_Add, &start);
+#endif //----- ADD for LATENCY -----
     if ((msg[0] != 0x02) || (rc != 3)) {
+        cefore_fib_failed (1);
         return (-1);
     }
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_fib (prefix, plen, 0);
+#endif //----- ADD for CONVERGENCE -----
     
     return (1);
 }
 
-int 
-cefore_fib_del_req_send (
+static int
+cefore_fib_del_msg_create (
+    unsigned char* msg, 
     const unsigned char* prefix, 
     int plen, 
     const unsigned char* nexthop, 
     unsigned short port,
     char* interface
 ) {
-    unsigned char msg[65535];
     uint16_t index;
     struct tlv_hdr tlv_hdr;
     const char* node;
     uint16_t value16;
-    int rc;
     char hostname[1024];
     
     /*-----------------------------------------------------------
         Create FIB Delete Request
     -------------------------------------------------------------*/
+    cefstat.fib_del++;
     memcpy (&msg[0], Cmd_FibDel, Cmd_FibDel_Len);
     index = Cmd_FibDel_Len + sizeof (uint16_t);
     
@@ -651,11 +856,58 @@ cefore_fib_del_req_send (
     value16 = index - (Cmd_FibDel_Len + sizeof (uint16_t));
     memcpy (&msg[Cmd_FibDel_Len], &value16, sizeof (uint16_t));
     
+    return (index);
+}
+
+int 
+cefore_fib_del_req_send (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+) {
+    int rc;
+    
+    if (fib_defer) {
+        return (cefore_fib_del_batch_add (prefix, plen, nexthop, port, interface));
+    }
+    USDT_PROBE3 (fib_del_start, prefix, plen, port);
+    rc = cefore_fib_del_req_exchange (prefix, plen, nexthop, port, interface);
+    USDT_PROBE3 (fib_del_end, prefix, plen, rc);
+    
+    return (rc);
+}
+
+static int 
+cefore_fib_del_req_exchange (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+) {
+    unsigned char msg[65535];
+    uint16_t index;
+    int rc;
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    struct timespec start;
+#endif //----- ADD for LATENCY -----
+    
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix (CefC_Trace_Fib_Del, prefix, plen, nexthop, 0, 0, 0, port, 0);
+#endif //----- ADD for TRACE -----
+    index = cefore_fib_del_msg_create (msg, prefix, plen, nexthop, port, interface);
+    
 //  cef_buff_print (msg, index);
     
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    latency_start (&start);
+#endif //----- ADD for LATENCY -----
     rc = send (cefore_socket, msg, index, 0);
     if (rc < 0) {
         cefore_socket = -1;
+        cefore_fib_failed (1);
         return (-1);
     }
 {
@@ -667,20 +919,274 @@ cefore_fib_del_req_send (
         rc = recv (cefore_socket, msg, 65535, 0);
         if (rc < 0) {
             cefore_socket = -1;
+            cefore_fib_failed (1);
             return (-1);
         }
     } else {
         cefore_socket = -1;
+        cefore_fib_failed (1);
         return (-1);
     }
 }
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    latency_record (CefC_Lat_Fib_Del, &start);
+#endif //----- ADD for LATENCY -----
     if ((msg[0] != 0x02) || (rc != 3)) {
+        cefore_fib_failed (1);
         return (-1);
     }
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_fib (prefix, plen, 0);
+#endif //----- ADD for CONVERGENCE -----
     
     return (index);
 }
 
+/*--------------------------------------------------------------------------------------
+    Appends a request to the batch
+----------------------------------------------------------------------------------------*/
+static int
+cefore_fib_batch_append (
+    const unsigned char* msg, 
+    int len
+) {
+    if (fib_batch_len + len > Fib_Batch_Size) {
+        cefore_fib_batch_flush ();
+    }
+    memcpy (&fib_batch[fib_batch_len], msg, len);
+    fib_batch_len += len;
+    fib_batch_num++;
+    
+    return (fib_batch_num);
+}
+
+/*--------------------------------------------------------------------------------------
+    Queues a FIB Add Request; the queue goes out with cefore_fib_batch_send.
+    A negative weight leaves out the T_COST TLV.
+----------------------------------------------------------------------------------------*/
+int 
+cefore_fib_add_batch_add (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface,
+    int weight
+) {
+    unsigned char msg[65535];
+    int len, num;
+    
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix (CefC_Trace_Fib_Add, prefix, plen, nexthop, 0, 0,
+                  weight < 0 ? 0xFFFF : weight, port, CefC_Trace_Batched);
+#endif //----- ADD for TRACE -----
+    len = cefore_fib_add_msg_create (msg, prefix, plen, nexthop, port, interface, weight);
+    num = cefore_fib_batch_append (msg, len);
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_fib (prefix, plen, 1);
+#endif //----- ADD for CONVERGENCE -----
+    
+    return (num);
+}
+
+/*--------------------------------------------------------------------------------------
+    Queues a FIB Delete Request; the queue goes out with cefore_fib_batch_send.
+    The requests are the same as the ones sent by cefore_fib_*_req_send, written
+    back to back, so that cefnetd sees k requests but we pay for one round trip.
+----------------------------------------------------------------------------------------*/
+int 
+cefore_fib_del_batch_add (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+) {
+    unsigned char msg[65535];
+    int len, num;
+    
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix (CefC_Trace_Fib_Del, prefix, plen, nexthop, 0, 0, 0, port,
+                  CefC_Trace_Batched);
+#endif //----- ADD for TRACE -----
+    len = cefore_fib_del_msg_create (msg, prefix, plen, nexthop, port, interface);
+    num = cefore_fib_batch_append (msg, len);
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_fib (prefix, plen, 1);
+#endif //----- ADD for CONVERGENCE -----
+    
+    return (num);
+}
+
+/*--------------------------------------------------------------------------------------
+    Sends the queued FIB Requests and collects one reply for each of them.
+    Route notifications arriving in between are handed to cefore_xroute_update
+    once all replies are in. Returns the number of requests acknowledged, or -1.
+----------------------------------------------------------------------------------------*/
+static int 
+cefore_fib_batch_flush (
+    void
+) {
+    unsigned char rsp[65535];
+    int num = fib_batch_num;
+    int got = 0, pos = 0;
+    int replies = 0;
+    int ack = 0;
+    int rc, i;
+    uint16_t length;
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    struct timespec start;
+#endif //----- ADD for LATENCY -----
+    
+    if (num == 0) {
+        return (0);
+    }
+    fib_batch_num = 0;
+    
+    if (cefore_socket == -1) {
+        fib_batch_len = 0;
+        cefore_fib_failed (num);
+        return (-1);
+    }
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    latency_start (&start);
+#endif //----- ADD for LATENCY -----
+    rc = send (cefore_socket, fib_batch, fib_batch_len, 0);
+    fib_batch_len = 0;
+    if (rc < 0) {
+        cefore_socket = -1;
+        cefore_fib_failed (num);
+        return (-1);
+    }
+    
+    /* Each request is answered by a 3 byte response, but cefnetd may also 
+       send a route notification (0x03, length, body) at any time */
+    while (replies < num || pos < got) {
+        struct pollfd fds[1];
+        
+        while (pos < got) {
+            if (rsp[pos] == 0x03) {
+                if (got - pos < 3) {
+                    break;
+                }
+                memcpy (&length, &rsp[pos + 1], sizeof (uint16_t));
+                if (got - pos < length + 3) {
+                    break;
+                }
+                pos += length + 3;
+            } else {
+                if (got - pos < 3) {
+                    break;
+                }
+                if (rsp[pos] == 0x02) {
+                    ack++;
+                }
+                replies++;
+                pos += 3;
+            }
+        }
+        if (replies >= num && pos == got) {
+            break;
+        }
+        if (got == sizeof (rsp)) {
+            fprintf (stderr, "cefnetd sent a malformed reply.\n");
+            break;
+        }
+        
+        fds[0].fd = cefore_socket;
+        fds[0].events = POLLIN | POLLERR;
+        rc = poll (fds, 1, Fib_Batch_Timeout);
+        if (rc == 0) {
+            fprintf (stderr, "cefnetd answered %d of %d FIB requests.\n",
+                     replies, num);
+            break;
+        }
+        if (rc < 0 || !(fds[0].revents & POLLIN)) {
+            cefore_socket = -1;
+            cefore_fib_failed (num);
+            return (-1);
+        }
+        rc = recv (cefore_socket, rsp + got, sizeof (rsp) - got, 0);
+        if (rc <= 0) {
+            cefore_socket = -1;
+            cefore_fib_failed (num);
+            return (-1);
+        }
+        got += rc;
+    }
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    latency_record (CefC_Lat_Fib_Batch, &start);
+#endif //----- ADD for LATENCY -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_fib_flushed ();
+#endif //----- ADD for CONVERGENCE -----
+    cefore_fib_failed (num - ack);
+    
+    /* The notifications may queue FIB Requests of their own, so they are
+       only processed after this batch is complete */
+    for (i = 0 ; i < pos ; ) {
+        if (rsp[i] == 0x03) {
+            memcpy (&length, &rsp[i + 1], sizeof (uint16_t));
+            cefore_xroute_update (&rsp[i], length + 3);
+            i += length + 3;
+        } else {
+            i += 3;
+        }
+    }
+    
+    return (ack);
+}
+
+static void
+cefore_fib_failed (
+    int num
+) {
+    if (num <= 0) {
+        return;
+    }
+    cefstat.fib_failed += num;
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix (CefC_Trace_Fib_Fail, NULL, 0, NULL, 0, 0, 0, num, 0);
+#endif //----- ADD for TRACE -----
+}
+
+/*--------------------------------------------------------------------------------------
+    Sends the queued FIB Requests, unless they are being deferred.
+----------------------------------------------------------------------------------------*/
+int 
+cefore_fib_batch_send (
+    void
+) {
+    if (fib_defer) {
+        return (0);
+    }
+    return (cefore_fib_batch_flush ());
+}
+
+/*--------------------------------------------------------------------------------------
+    Until the matching cefore_fib_defer_end, FIB Requests are queued rather than
+    sent one at a time, and are assumed to succeed.
+----------------------------------------------------------------------------------------*/
+void 
+cefore_fib_defer_begin (
+    void
+) {
+    fib_defer++;
+}
+
+/*--------------------------------------------------------------------------------------
+    Sends the FIB Requests queued since the outermost cefore_fib_defer_begin.
+----------------------------------------------------------------------------------------*/
+int 
+cefore_fib_defer_end (
+    void
+) {
+    if (fib_defer == 0 || --fib_defer > 0) {
+        return (0);
+    }
+    return (cefore_fib_batch_flush ());
+}
+
 static int
 cefore_trim_line_string (
     const char* p1,                             /* target string for trimming           */
@@ -830,26 +1336,183 @@ cefbabeld_tcp_sock_create (
     return (-1);
 }
 
+/*--------------------------------------------------------------------------------------
+    Closes the connection of a cefbabelstatus client, unless it was handed over
+----------------------------------------------------------------------------------------*/
+static void
+cefbabel_stat_client_remove (
+    int i,                                  /* index in stat_clients                    */
+    int close_f                             /* close the connection                     */
+) {
+    if (close_f) {
+        close (stat_clients[i].fd);
+    }
+    free (stat_clients[i].out);
+    stat_clients[i] = stat_clients[--stat_client_num];
+}
+/*--------------------------------------------------------------------------------------
+    Writes the response to a cefbabelstatus request
+----------------------------------------------------------------------------------------*/
+static int                                  /* length of the response, 0 if the connection  */
+                                            /* was handed over, or -1 to close it           */
+cefbabel_stat_rsp_create (
+    int cs,                                 /* connection of the request                */
+    const unsigned char* req,               /* request                                  */
+    int rlen,                               /* length of the request                    */
+    unsigned char* buff                     /* buffer to write the response to          */
+) {
+    uint32_t value32;
+    uint32_t index = 0;
+    
+    if (req[CefC_O_Fix_Ver] != CefC_Version) {
+        return (-1);
+    }
+    if (req[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Status) {
+        /* set header   */
+        buff[CefC_O_Fix_Ver]  = CefC_Version;
+        /* Get Status   */
+        buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Status;
+        index += CefC_Cbabel_RspMsg_HeaderLen;
+        {
+            char rsp[128];
+            sprintf (rsp, "Number of Sent Update TLV  : %d", cefstat_sent_update_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+            sprintf (rsp, "Number of Sent Requests    : %d", cefstat_sent_request_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+            sprintf (rsp, "Number of Suppressed Req.  : %d", cefstat_suppressed_request_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+            sprintf (rsp, "Number of Over-budget Req. : %d", cefstat_overbudget_request_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+#endif //----- ADD for REQUEST LIMIT -----
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+            sprintf (rsp, "Number of Route Switches   : %d", cefstat_route_switch_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+            sprintf (rsp, "Number of Held Switches    : %d", cefstat_held_switch_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+            sprintf (rsp, "Number of LFA Failovers    : %d", cefstat_lfa_failover_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+#endif //----- ADD for LFA -----
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+            sprintf (rsp, "Number of Bulk Flushed Routes: %d", cefstat_bulk_flush_num);
+            memcpy (&buff[index], rsp, strlen(rsp)+1);
+            index += strlen(rsp)+1;
+#endif //----- ADD for BULK FLUSH -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            if (flap_damping) {
+                sprintf (rsp, "Number of Damped Prefixes  : %d", cefstat_damped_num);
+                memcpy (&buff[index], rsp, strlen(rsp)+1);
+                index += strlen(rsp)+1;
+            }
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+            /* The per-prefix lists go last, as they may fill the rest of buff */
+            index += route_switch_status ((char*) &buff[index],
+                                          Stat_Rsp_Room (index));
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            if (flap_damping) {
+                index += damping_status ((char*) &buff[index],
+                                         Stat_Rsp_Room (index));
+            }
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+            if (convergence_tracing) {
+                index += convergence_status ((char*) &buff[index],
+                                             Stat_Rsp_Room (index));
+            }
+#endif //----- ADD for CONVERGENCE -----
+        }
+        /* set Length   */
+        value32 = htonl (index);
+        memcpy (buff + CefC_O_Length, &value32, CefC_L_Length);
+        /* Send rsp to cefbablestatus. */
+        return (index);
+    } else if (req[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Counters) {
+        /* set header   */
+        buff[CefC_O_Fix_Ver]  = CefC_Version;
+        buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Counters;
+        index += CefC_Cbabel_RspMsg_HeaderLen;
+        index += cefbabel_counters_rsp_create (&buff[index],
+                                               CefC_Cbabel_Stat_Mtu - index);
+        /* set Length   */
+        value32 = htonl (index);
+        memcpy (buff + CefC_O_Length, &value32, CefC_L_Length);
+        return (index);
+    } else if (req[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Latency ||
+               req[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Latency_Reset) {
+        /* set header   */
+        buff[CefC_O_Fix_Ver]  = CefC_Version;
+        buff[CefC_O_Fix_Type] = req[CefC_O_Fix_Type];
+        index += CefC_Cbabel_RspMsg_HeaderLen;
+        index += cefbabel_latency_rsp_create (&buff[index]);
+        /* set Length   */
+        value32 = htonl (index);
+        memcpy (buff + CefC_O_Length, &value32, CefC_L_Length);
+        if (req[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Latency_Reset) {
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+            latency_reset ();
+#endif //----- ADD for LATENCY -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+            convergence_reset ();
+#endif //----- ADD for CONVERGENCE -----
+        }
+        return (index);
+    } else if (req[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Dump) {
+        int body_len;
+        
+        index += CefC_Cbabel_RspMsg_HeaderLen;
+        body_len = cefbabel_dump_rsp_create (&buff[index], CefC_Cbabel_Stat_Mtu - index,
+                        &req[CefC_Cbabel_CmdMsg_HeaderLen],
+                        rlen - CefC_Cbabel_CmdMsg_HeaderLen);
+        if (body_len < 0) {
+            return (-1);
+        }
+        index += body_len;
+        /* set header   */
+        buff[CefC_O_Fix_Ver]  = CefC_Version;
+        buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Dump;
+        /* set Length   */
+        value32 = htonl (index);
+        memcpy (buff + CefC_O_Length, &value32, CefC_L_Length);
+        return (index);
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+    } else if (req[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Watch) {
+        /* The connection stays open, and belongs to watch.c from now on */
+        if (watch_add (cs) < 0) {
+            return (-1);
+        }
+        return (0);
+#endif //----- ADD for WATCH -----
+    }
+    return (-1);
+}
+
+/*--------------------------------------------------------------------------------------
+    Accepts the connections of cefbabelstatus, and drops those that take too long.
+    The requests are read and answered by cefbabel_tcp_stat_io.
+----------------------------------------------------------------------------------------*/
 void
 cefbabel_tcp_stat_prcess ()
 {
-    struct sockaddr_storage* sa;
-    socklen_t len = sizeof (struct sockaddr_storage);
-    static int tcp_listen_fd = -1;
+    struct sockaddr_storage sa;
+    socklen_t len;
+    struct cefbabel_stat_client* c;
     int cs;
     int flag;
     char ip_str[NI_MAXHOST];
     char port_str[NI_MAXSERV];
-    int new_accept_f = 1;
     int err;
-    unsigned char buff[CefC_Cbabel_Stat_Mtu];
-    struct pollfd fds[1];
-    int rlen;
-    ///int blen;
-    int res;
-    uint16_t value16; 
-    uint32_t value32; 
-    uint32_t index = 0;
+    int i;
 
     /* Create listen socket */
     if (tcp_listen_fd == -1) {
@@ -860,101 +1523,442 @@ cefbabel_tcp_stat_prcess ()
         }
     }
     
-    /* Accepts the TCP SYN      */
-    sa = (struct sockaddr_storage*) malloc (sizeof (struct sockaddr_storage));
-    memset (sa, 0, sizeof (struct sockaddr_storage));
-    cs = accept (tcp_listen_fd, (struct sockaddr*) sa, &len);
-    if (cs < 0) {
-        if (sa) {
-            free (sa);
+    for (i = stat_client_num - 1 ; i >= 0 ; i--) {
+        if (now.tv_sec - stat_clients[i].since > CefC_Cbabel_Stat_Timeout) {
+            cefbabel_stat_client_remove (i, 1);
         }
-        return;
     }
-
-    flag = fcntl (cs, F_GETFL, 0);
-    if (flag < 0) {
-        fprintf(stderr, "[cefore] Warning: Failed to create new tcp connection : %s\n", strerror (errno));
-        goto POST_ACCEPT;
+    
+    while (stat_client_num < CefC_Cbabel_Stat_MaxClients) {
+        /* Accepts the TCP SYN      */
+        len = sizeof (struct sockaddr_storage);
+        memset (&sa, 0, sizeof (struct sockaddr_storage));
+        cs = accept (tcp_listen_fd, (struct sockaddr*) &sa, &len);
+        if (cs < 0) {
+            return;
+        }
+        
+        flag = fcntl (cs, F_GETFL, 0);
+        if (flag < 0) {
+            fprintf(stderr, "[cefore] Warning: Failed to create new tcp connection : %s\n", strerror (errno));
+            close (cs);
+            continue;
+        }
+        if (fcntl (cs, F_SETFL, flag | O_NONBLOCK) < 0) {
+            fprintf(stderr, "[cefore] Warning: Failed to create new tcp connection : %s\n", strerror (errno));
+            close (cs);
+            continue;
+        }
+        if ((err = getnameinfo ((struct sockaddr*) &sa, len, ip_str, sizeof (ip_str),
+                port_str, sizeof (port_str), NI_NUMERICHOST | NI_NUMERICSERV)) != 0) {
+            fprintf(stderr, "[cefore] Warning: Failed to create new tcp connection : %s\n", gai_strerror (err));
+            close (cs);
+            continue;
+        }
+        
+        c = &stat_clients[stat_client_num];
+        memset (c, 0, sizeof (struct cefbabel_stat_client));
+        c->out = malloc (strlen (CefC_Cbabel_Cmd_ConnOK));
+        if (c->out == NULL) {
+            close (cs);
+            return;
+        }
+        c->fd = cs;
+        c->since = now.tv_sec;
+        /* cefbablestatus sends its command once it gets this */
+        memcpy (c->out, CefC_Cbabel_Cmd_ConnOK, strlen (CefC_Cbabel_Cmd_ConnOK));
+        c->out_len = strlen (CefC_Cbabel_Cmd_ConnOK);
+        stat_client_num++;
     }
-    if (fcntl (cs, F_SETFL, flag | O_NONBLOCK) < 0) {
-        fprintf(stderr, "[cefore] Warning: Failed to create new tcp connection : %s\n", strerror (errno));
-        goto POST_ACCEPT;
+}
+/*--------------------------------------------------------------------------------------
+    Adds the sockets of cefbabelstatus to the sets of the main loop, which must not
+    wait for them, but wakes up as soon as they are ready.
+----------------------------------------------------------------------------------------*/
+int                                         /* largest descriptor, or -1                */
+cefbabel_tcp_stat_fds (
+    fd_set* readfds,                        /* sockets to read                          */
+    fd_set* writefds                        /* sockets to write                         */
+) {
+    int maxfd = -1;
+    int i;
+    
+    if (tcp_listen_fd >= 0 && stat_client_num < CefC_Cbabel_Stat_MaxClients) {
+        FD_SET (tcp_listen_fd, readfds);
+        maxfd = tcp_listen_fd;
     }
-    if ((err = getnameinfo ((struct sockaddr*) sa, len, ip_str, sizeof (ip_str),
-            port_str, sizeof (port_str), NI_NUMERICHOST | NI_NUMERICSERV)) != 0) {
-        fprintf(stderr, "[cefore] Warning: Failed to create new tcp connection : %s\n", gai_strerror (err));
-        goto POST_ACCEPT;
+    for (i = 0 ; i < stat_client_num ; i++) {
+        if (!stat_clients[i].replied) {
+            FD_SET (stat_clients[i].fd, readfds);
+        }
+        if (stat_clients[i].out_len > 0) {
+            FD_SET (stat_clients[i].fd, writefds);
+        }
+        maxfd = MAX (maxfd, stat_clients[i].fd);
     }
-
-    if (new_accept_f) {
-        cef_cbabel_send_msg (cs,
-            (unsigned char*) CefC_Cbabel_Cmd_ConnOK, strlen (CefC_Cbabel_Cmd_ConnOK));
-
-        /* Recive cmd from cefbablestatus. */
-        fds[0].fd     = cs;
-        fds[0].events = POLLIN | POLLERR;
-        res = poll (fds, 1, 100);
-        if (res == 0) {
-            /* poll time out */
-            goto POST_ACCEPT;
-        }
-        if (fds[0].revents & (POLLERR | POLLNVAL | POLLHUP)) {
-            ; /* NOP */
-        } else if (fds[0].revents & POLLIN) {
-            rlen = recv (fds[0].fd, buff, 65535, 0);
-            if (rlen > 0) {
-                if (buff[CefC_O_Fix_Ver] != CefC_Version) {
-                    goto POST_ACCEPT;
+    return (maxfd);
+}
+/*--------------------------------------------------------------------------------------
+    Reads the requests of cefbabelstatus and writes out the responses, as much as
+    the sockets take without blocking.
+----------------------------------------------------------------------------------------*/
+void
+cefbabel_tcp_stat_io (
+    fd_set* readfds,                        /* sockets ready to read                    */
+    fd_set* writefds                        /* sockets ready to write                   */
+) {
+    static unsigned char buff[CefC_Cbabel_Stat_Mtu];
+    struct cefbabel_stat_client* c;
+    uint16_t value16;
+    int rc, need;
+    int i;
+    
+    for (i = stat_client_num - 1 ; i >= 0 ; i--) {
+        c = &stat_clients[i];
+        
+        if (c->out_len > 0 && FD_ISSET (c->fd, writefds)) {
+            rc = send (c->fd, c->out + c->out_start, c->out_len, MSG_NOSIGNAL);
+            if (rc < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    cefbabel_stat_client_remove (i, 1);
+                    continue;
                 }
-                if (buff[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Status) {
-                    memcpy (&value16, &buff[CefC_O_Length], CefC_S_Length);
-                    ///blen = ntohs (value16);
-
-                    /* set header   */
-                    buff[CefC_O_Fix_Ver]  = CefC_Version;
-                    /* Get Status   */
-                    buff[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Status;
-                    index += CefC_Cbabel_RspMsg_HeaderLen;
-                    {
-                        char rsp[128];
-                        sprintf (rsp, "Number of Sent Update TLV  : %d", cefstat_sent_update_num);
-                        memcpy (&buff[index], rsp, strlen(rsp)+1);
-                        index += strlen(rsp)+1;
-                    }
-                    /* set Length   */
-                    value32 = htonl (index);
-                    memcpy (buff + CefC_O_Length, &value32, CefC_L_Length);
-                    /* Send rsp to cefbablestatus. */
-                    cef_cbabel_send_msg (cs, buff, index);
-                } else {
-                    goto POST_ACCEPT;
+            } else {
+                c->out_start += rc;
+                c->out_len   -= rc;
+                /* A large response takes as long as it takes to drain */
+                c->since = now.tv_sec;
+            }
+            if (c->out_len == 0) {
+                free (c->out);
+                c->out = NULL;
+                c->out_start = 0;
+                if (c->replied) {
+                    cefbabel_stat_client_remove (i, 1);
+                    continue;
                 }
             }
         }
+        
+        if (!c->replied && FD_ISSET (c->fd, readfds)) {
+            rc = recv (c->fd, c->in + c->in_len, sizeof (c->in) - c->in_len, 0);
+            if (rc == 0 ||
+                (rc < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                cefbabel_stat_client_remove (i, 1);
+                continue;
+            }
+            if (rc < 0) {
+                continue;
+            }
+            c->in_len += rc;
+            
+            /* Wait for the whole request */
+            if (c->in_len < CefC_Cbabel_CmdMsg_HeaderLen) {
+                continue;
+            }
+            memcpy (&value16, &c->in[CefC_O_Length], CefC_S_Length);
+            need = MAX (ntohs (value16), CefC_Cbabel_CmdMsg_HeaderLen);
+            if (need > (int) sizeof (c->in)) {
+                cefbabel_stat_client_remove (i, 1);
+                continue;
+            }
+            if (c->in_len < need) {
+                continue;
+            }
+            
+            if (c->in[CefC_O_Fix_Ver] == CefC_Version &&
+                (c->in[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Snapshot ||
+                 c->in[CefC_O_Fix_Type] == CefC_Cbabel_Msg_Type_Trace)) {
+                /* Much larger than buff, so built in place */
+                rc = cefbabel_bulk_rsp_create (c->in[CefC_O_Fix_Type], &c->out);
+                if (rc < 0) {
+                    cefbabel_stat_client_remove (i, 1);
+                    continue;
+                }
+                c->out_len = rc;
+                c->replied = 1;
+                continue;
+            }
+            rc = cefbabel_stat_rsp_create (c->fd, c->in, need, buff);
+            if (rc <= 0) {
+                cefbabel_stat_client_remove (i, rc < 0);
+                continue;
+            }
+            c->out = malloc (rc);
+            if (c->out == NULL) {
+                cefbabel_stat_client_remove (i, 1);
+                continue;
+            }
+            memcpy (c->out, buff, rc);
+            c->out_len = rc;
+            c->replied = 1;
+        }
     }
-
-POST_ACCEPT:
-    close (cs);
-    if (sa) {
-        free (sa);
+}
+static void
+cef_put_u16 (
+    unsigned char* buff,
+    int* index,
+    uint16_t value
+) {
+    value = htons (value);
+    memcpy (&buff[*index], &value, sizeof (uint16_t));
+    *index += sizeof (uint16_t);
+}
+static uint16_t
+cef_get_u16 (
+    const unsigned char* buff
+) {
+    uint16_t value;
+    
+    memcpy (&value, buff, sizeof (uint16_t));
+    return (ntohs (value));
+}
+static void
+cef_put_u64 (
+    unsigned char* buff,
+    int* index,
+    unsigned long long value
+) {
+    uint32_t value32;
+    
+    value32 = htonl ((uint32_t)(value >> 32));
+    memcpy (&buff[*index], &value32, sizeof (uint32_t));
+    value32 = htonl ((uint32_t) value);
+    memcpy (&buff[*index + 4], &value32, sizeof (uint32_t));
+    *index += 8;
+}
+static void
+cef_put_name (
+    unsigned char* buff,
+    int* index,
+    const char* name
+) {
+    memset (&buff[*index], 0, CefC_Cbabel_Counters_NameLen);
+    strncpy ((char*) &buff[*index], name, CefC_Cbabel_Counters_NameLen - 1);
+    *index += CefC_Cbabel_Counters_NameLen;
+}
+static int                                  /* length of the body                       */
+cefbabel_counters_rsp_create (
+    unsigned char* buff,                    /* buffer to write the body to              */
+    int len                                 /* size of buff                             */
+) {
+    unsigned long long cnt[CefC_Cnt_Num];
+    unsigned long long rcvd;
+    struct interface* ifp;
+    struct neighbour* neigh;
+    int index = 0;
+    int num_pos, num;
+    int i;
+    
+    rcvd = cefstat.tlv_rcvd[MESSAGE_UPDATE];
+    cnt[CefC_Cnt_Update_Accepted]    = cefstat.update_accepted;
+    cnt[CefC_Cnt_Update_Unfeasible]  = cefstat.update_unfeasible;
+    cnt[CefC_Cnt_Update_Ignored]     = 
+        rcvd > cefstat.update_accepted + cefstat.update_unfeasible ?
+        rcvd - cefstat.update_accepted - cefstat.update_unfeasible : 0;
+    cnt[CefC_Cnt_Update_Sent]        = cefstat.update_sent;
+    cnt[CefC_Cnt_Request_Sent]       = cefstat_sent_request_num;
+    cnt[CefC_Cnt_Request_Forwarded]  = cefstat.request_forwarded;
+    cnt[CefC_Cnt_Request_Suppressed] = cefstat_suppressed_request_num;
+    cnt[CefC_Cnt_Request_Overbudget] = cefstat_overbudget_request_num;
+    cnt[CefC_Cnt_Fib_Add]            = cefstat.fib_add;
+    cnt[CefC_Cnt_Fib_Del]            = cefstat.fib_del;
+    cnt[CefC_Cnt_Fib_Failed]         = cefstat.fib_failed;
+    cnt[CefC_Cnt_Route_Switches]     = cefstat_route_switch_num;
+    cnt[CefC_Cnt_Held_Switches]      = cefstat_held_switch_num;
+    cnt[CefC_Cnt_Lfa_Failovers]      = cefstat_lfa_failover_num;
+    cnt[CefC_Cnt_Bulk_Flushed]       = cefstat_bulk_flush_num;
+    cnt[CefC_Cnt_Damped]             = cefstat_damped_num;
+    cnt[CefC_Cnt_Routes]             = route_count (0);
+    cnt[CefC_Cnt_Installed_Routes]   = route_count (1);
+    cnt[CefC_Cnt_Sources]            = source_count ();
+    cnt[CefC_Cnt_Xroutes]            = xroutes_estimate ();
+    cnt[CefC_Cnt_Best_Routes]        = bestroute_count ();
+    num = 0;
+    FOR_ALL_NEIGHBOURS (neigh) {
+        num++;
     }
-    return;
+    cnt[CefC_Cnt_Neighbours]         = num;
+    
+    /* The fixed part always fits in the status MTU */
+    cef_put_u16 (buff, &index, CefC_Cbabel_Counters_Ver);
+    cef_put_u16 (buff, &index, CefC_Cnt_Num);
+    for (i = 0 ; i < CefC_Cnt_Num ; i++) {
+        cef_put_u64 (buff, &index, cnt[i]);
+    }
+    cef_put_u16 (buff, &index, CEFSTAT_TLV_TYPES);
+    for (i = 0 ; i < CEFSTAT_TLV_TYPES ; i++) {
+        cef_put_u64 (buff, &index, cefstat.tlv_rcvd[i]);
+    }
+    
+    /* Interfaces and neighbours that do not fit are left out */
+    num_pos = index;
+    num = 0;
+    index += sizeof (uint16_t);
+    FOR_ALL_INTERFACES (ifp) {
+        if (index + CefC_Cbabel_Counters_NameLen + 4 * 8 + 2 > len) {
+            break;
+        }
+        cef_put_name (buff, &index, ifp->name);
+        cef_put_u64 (buff, &index, ifp->rx_packets);
+        cef_put_u64 (buff, &index, ifp->rx_bytes);
+        cef_put_u64 (buff, &index, ifp->tx_packets);
+        cef_put_u64 (buff, &index, ifp->tx_bytes);
+        num++;
+    }
+    cef_put_u16 (buff, &num_pos, num);
+    
+    num_pos = index;
+    num = 0;
+    index += sizeof (uint16_t);
+    FOR_ALL_NEIGHBOURS (neigh) {
+        if (index + 16 + CefC_Cbabel_Counters_NameLen + 2 + 2 > len) {
+            break;
+        }
+        memcpy (&buff[index], neigh->address, 16);
+        index += 16;
+        cef_put_name (buff, &index, neigh->ifp->name);
+        cef_put_u16 (buff, &index, neigh->hello.reach);
+        cef_put_u16 (buff, &index, neighbour_cost (neigh));
+        num++;
+    }
+    cef_put_u16 (buff, &num_pos, num);
+    
+    return (index);
 }
-static int                                  /* The return value is negative if an error occurs  */
-cef_cbabel_send_msg (
-    int fd,                                 /* socket fd                                */
-    unsigned char* msg,                     /* send message                             */
-    uint16_t msg_len                        /* message length                           */
+
+static int                                  /* length of the body                       */
+cefbabel_latency_rsp_create (
+    unsigned char* buff                     /* buffer to write the body to              */
 ) {
-    int res;
-    res = send (fd, msg, msg_len, 0);
-    if (res < 0) {
-        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
-            return (-1);
+    uint32_t value32;
+    int index = 0;
+    int i, b;
+    
+    /* CefC_Lat_Num * (24 + 4 * LATENCY_BUCKETS) bytes, well below the MTU */
+    cef_put_u16 (buff, &index, CefC_Cbabel_Latency_Ver);
+    cef_put_u16 (buff, &index, latency_histograms);
+    cef_put_u16 (buff, &index, CefC_Lat_Num);
+    cef_put_u16 (buff, &index, LATENCY_BUCKETS);
+    for (i = 0 ; i < CefC_Lat_Num ; i++) {
+        cef_put_u64 (buff, &index, latency_hists[i].count);
+        cef_put_u64 (buff, &index, latency_hists[i].sum_ns);
+        cef_put_u64 (buff, &index, latency_hists[i].max_ns);
+        for (b = 0 ; b < LATENCY_BUCKETS ; b++) {
+            value32 = htonl (latency_hists[i].bucket[b]);
+            memcpy (&buff[index], &value32, sizeof (uint32_t));
+            index += sizeof (uint32_t);
         }
     }
-    return (0);
+    
+    return (index);
+}
+
+static int                                  /* length of the body, or -1                */
+cefbabel_dump_rsp_create (
+    unsigned char* buff,                    /* buffer to write the body to              */
+    int len,                                /* size of buff                             */
+    const unsigned char* req,               /* request body                             */
+    int req_len                             /* length of the request body               */
+) {
+    static char text[CefC_Cbabel_Dump_PageBytes * 2];
+    unsigned char cursor[CefC_Cbabel_Dump_CursorMaxLen];
+    char filter[CefC_Cbabel_Dump_FilterMaxLen + 1];
+    int table, max_entries, cursor_len, filter_len;
+    int num, more = 0;
+    long text_len;
+    FILE* out;
+    int index = 0;
+    
+    /*-----------------------------------------------------------
+        Parse the request
+    -------------------------------------------------------------*/
+    if (req_len < 9 || cef_get_u16 (&req[0]) != CefC_Cbabel_Dump_Ver) {
+        return (-1);
+    }
+    table       = req[2];
+    max_entries = cef_get_u16 (&req[3]);
+    cursor_len  = cef_get_u16 (&req[5]);
+    if (cursor_len > CefC_Cbabel_Dump_CursorMaxLen || 9 + cursor_len > req_len) {
+        return (-1);
+    }
+    memcpy (cursor, &req[7], cursor_len);
+    filter_len = cef_get_u16 (&req[7 + cursor_len]);
+    if (filter_len > CefC_Cbabel_Dump_FilterMaxLen ||
+        9 + cursor_len + filter_len > req_len) {
+        return (-1);
+    }
+    memcpy (filter, &req[9 + cursor_len], filter_len);
+    filter[filter_len] = 0x00;
+    if (max_entries == 0 || max_entries > CefC_Cbabel_Dump_MaxEntries) {
+        max_entries = CefC_Cbabel_Dump_MaxEntries;
+    }
+    
+    /*-----------------------------------------------------------
+        Dump one page; the text buffer leaves room for the entry
+        that crosses CefC_Cbabel_Dump_PageBytes
+    -------------------------------------------------------------*/
+    out = fmemopen (text, sizeof (text), "w");
+    if (out == NULL) {
+        return (-1);
+    }
+    num = dump_table_page (out, table, filter, cursor, &cursor_len,
+                           max_entries, CefC_Cbabel_Dump_PageBytes, &more);
+    fflush (out);
+    text_len = ftell (out);
+    fclose (out);
+    if (num < 0) {
+        return (-1);
+    }
+    if (8 + cursor_len + text_len > len) {
+        return (-1);
+    }
+    
+    /*-----------------------------------------------------------
+        Create the response
+    -------------------------------------------------------------*/
+    cef_put_u16 (buff, &index, CefC_Cbabel_Dump_Ver);
+    buff[index++] = (unsigned char) table;
+    buff[index++] = more ? 1 : 0;
+    cef_put_u16 (buff, &index, num);
+    cef_put_u16 (buff, &index, cursor_len);
+    memcpy (&buff[index], cursor, cursor_len);
+    index += cursor_len;
+    memcpy (&buff[index], text, text_len);
+    index += text_len;
+    
+    return (index);
+}
+
+static int                                  /* length of the response, or -1            */
+cefbabel_bulk_rsp_create (
+    int type,                               /* type of the request                      */
+    unsigned char** rsp_r                   /* allocated response                       */
+) {
+    unsigned char* buff;
+    uint32_t value32;
+    int len;
+    
+    if (type == CefC_Cbabel_Msg_Type_Trace) {
+        len = trace_create (&buff, CefC_Cbabel_RspMsg_HeaderLen);
+    } else {
+        len = snapshot_create (&buff, CefC_Cbabel_RspMsg_HeaderLen);
+    }
+    if (len < 0) {
+        return (-1);
+    }
+    /* set header   */
+    buff[CefC_O_Fix_Ver]  = CefC_Version;
+    buff[CefC_O_Fix_Type] = type;
+    /* set Length   */
+    value32 = htonl (len);
+    memcpy (buff + CefC_O_Length, &value32, CefC_L_Length);
+    
+    *rsp_r = buff;
+    return (len);
 }
 
+
 #endif //----- ADD -----
 
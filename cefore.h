@@ -33,6 +33,8 @@
 #ifndef __CEFORE_HEADER__
 #define __CEFORE_HEADER__
 
+#include <sys/select.h>
+
 #define CefC_Default_Tcp_Prot           9897        /* cefbubeld's listen port num  */
 #define CefC_Cbabel_Stat_Mtu            65535
 #define CefC_O_Fix_Ver                  0
@@ -46,8 +48,217 @@
 #define CefC_L_Length                   4           /* Length field is 4 bytes      */
 #define CefC_Cbabel_Cmd_MaxLen          1024
 #define CefC_Cbabel_Cmd_ConnOK          "CMD://CbabelConnOK"
+#define CefC_Cbabel_Stat_MaxClients     16          /* connections at a time        */
+#define CefC_Cbabel_Stat_Timeout        2           /* seconds for a request        */
 #define CefC_S_Length                   2           /* Length field is 2 bytes      */
 
+/*
+    The Get Counters response has the same header as the Get Status response,
+    followed by (all integers in network byte order):
+        Version(2) NumCounters(2) Counter(8) * NumCounters
+        NumTlvTypes(2) ReceivedTlvs(8) * NumTlvTypes
+        NumInterfaces(2) {Name(16) RxPackets(8) RxBytes(8) TxPackets(8) TxBytes(8)}
+        NumNeighbours(2) {Address(16) Interface(16) Reach(2) Cost(2)}
+    Readers must skip counters they do not know, so that new ones can be
+    appended without bumping the version.
+*/
+#define CefC_Cbabel_Msg_Type_Counters   0x11        /* Type Get Counters            */
+#define CefC_Cbabel_Counters_Ver        1
+#define CefC_Cbabel_Counters_NameLen    16
+
+enum {
+    CefC_Cnt_Update_Accepted = 0,
+    CefC_Cnt_Update_Unfeasible,
+    CefC_Cnt_Update_Ignored,
+    CefC_Cnt_Update_Sent,
+    CefC_Cnt_Request_Sent,
+    CefC_Cnt_Request_Forwarded,
+    CefC_Cnt_Request_Suppressed,
+    CefC_Cnt_Request_Overbudget,
+    CefC_Cnt_Fib_Add,
+    CefC_Cnt_Fib_Del,
+    CefC_Cnt_Fib_Failed,
+    CefC_Cnt_Route_Switches,
+    CefC_Cnt_Held_Switches,
+    CefC_Cnt_Lfa_Failovers,
+    CefC_Cnt_Bulk_Flushed,
+    CefC_Cnt_Damped,
+    CefC_Cnt_Routes,
+    CefC_Cnt_Installed_Routes,
+    CefC_Cnt_Sources,
+    CefC_Cnt_Xroutes,
+    CefC_Cnt_Best_Routes,
+    CefC_Cnt_Neighbours,
+    CefC_Cnt_Num
+};
+
+/* Received TLVs are counted by type; types beyond the last slot share it. */
+#define CEFSTAT_TLV_TYPES               32
+
+/* Runtime counters served in the Get Counters response.  Unlike
+   cefstat_sent_update_num, these are never reset. */
+struct cefbabel_counters {
+    unsigned long long tlv_rcvd[CEFSTAT_TLV_TYPES];
+    unsigned long long update_accepted;
+    unsigned long long update_unfeasible;
+    unsigned long long update_sent;
+    unsigned long long request_forwarded;
+    unsigned long long fib_add;
+    unsigned long long fib_del;
+    unsigned long long fib_failed;
+};
+
+extern struct cefbabel_counters cefstat;
+
+/*
+    The Get Latency response has the same header, followed by:
+        Version(2) Enabled(2) NumHistograms(2) NumBuckets(2)
+        {Count(8) SumNs(8) MaxNs(8) Bucket(4) * NumBuckets} * NumHistograms
+    Bucket 0 counts operations that took less than 1us, bucket b those that
+    took from 2^(b-1) to 2^b us.  The Reset Latency request gets the same
+    response, and then clears the histograms.
+*/
+#define CefC_Cbabel_Msg_Type_Latency        0x12    /* Type Get Latency             */
+#define CefC_Cbabel_Msg_Type_Latency_Reset  0x13    /* Type Get and Reset Latency   */
+#define CefC_Cbabel_Latency_Ver             1
+
+enum {
+    CefC_Lat_Fib_Add = 0,                   /* cefore_fib_add_req_send round trip   */
+    CefC_Lat_Fib_Del,                       /* cefore_fib_del_req_send round trip   */
+    CefC_Lat_Fib_Batch,                     /* batched FIB requests round trip      */
+    CefC_Lat_Parse_Packet,
+    CefC_Lat_Route_Selection,               /* deferred selection after a packet    */
+    CefC_Lat_Flush_Updates,
+    CefC_Lat_Expire_Routes,
+    CefC_Lat_Expire_Sources,
+    CefC_Lat_Main_Loop,                     /* one iteration, not counting select   */
+    CefC_Lat_Conv_Fib,                      /* update received to FIB programmed    */
+    CefC_Lat_Conv_Advertise,                /* update received to prefix advertised */
+    CefC_Lat_Num
+};
+
+/*
+    The Get Table Page request carries, after the command header:
+        Version(2) Table(1) MaxEntries(2) CursorLen(2) Cursor FilterLen(2) Filter
+    and its response, after the response header:
+        Version(2) Table(1) More(1) NumEntries(2) CursorLen(2) Cursor Text
+    Text holds one line per entry, as in the table dump on SIGUSR1.  The cursor
+    is opaque to the client, which starts with an empty one and sends back the
+    one it received to get the next page, until More is 0.  The daemon keeps no
+    state between pages, each of which is a connection of its own.  The filter
+    is a name prefix (e.g. /a/b), or an interface name for the neighbours.
+*/
+#define CefC_Cbabel_Msg_Type_Dump       0x14        /* Type Get Table Page          */
+#define CefC_Cbabel_Dump_Ver            1
+#define CefC_Cbabel_Dump_CursorMaxLen   1051        /* Id(8) Plen(2) SrcPlen(1)     */
+                                                    /* SrcPrefix(16) Prefix(1024)   */
+#define CefC_Cbabel_Dump_FilterMaxLen   1024
+#define CefC_Cbabel_Dump_MaxEntries     256         /* per page                     */
+#define CefC_Cbabel_Dump_PageBytes      16384       /* of Text per page, roughly    */
+
+enum {
+    CefC_Dump_Routes = 1,
+    CefC_Dump_Xroutes,
+    CefC_Dump_Sources,
+    CefC_Dump_Bestroutes,
+    CefC_Dump_Neighbours,
+};
+
+/*
+    The Watch request has no body.  The daemon keeps the connection open and
+    sends it Watch frames, each with the same header as the responses and a
+    text body holding one line per change seen during an iteration of the
+    main loop:
+        add|change|flush interface|neighbour|route|xroute ...
+    Successive changes to the same object within an iteration are merged.
+    A frame whose body is "resync\n" means that changes were lost (the first
+    frame is always one): the client reloads the tables with Get Table Page.
+*/
+#define CefC_Cbabel_Msg_Type_Watch      0x15        /* Type Watch                   */
+
+/*
+    The Get Snapshot request has no body, and its response, after the response
+    header, is a snapshot of all the tables, as written to the snapshot-file:
+        Magic(4) Version(2) Time(8) MyId(8) MySeqno(2) NumTables(2)
+        {Table(1) NumEntries(4) Length(4) Entry * NumEntries} * NumTables
+    Length is that of the entries, so that readers can skip the tables they do
+    not know.  An entry is made of fixed fields, followed, except for the
+    neighbours, by the key of its prefix
+        Plen(2) SrcPlen(1) SrcPrefix(16) Prefix(Plen)
+    The fixed fields are
+        neighbours  Address(16) Interface(16) Reach(2) UReach(2) RxCost(2)
+                    TxCost(2) Rtt(4) RttCost(2) Cost(2)
+        xroutes     Metric(2) Ifindex(4) Proto(4)
+        routes      Id(8) Seqno(2) Metric(2) RefMetric(2) Cost(2) AddMetric(2)
+                    SmoothedMetric(2) Neighbour(2) Nexthop(16) Port(2) Age(4)
+                    Flags(1)
+        sources     Id(8) Seqno(2) Metric(2) RouteCount(2) Age(4)
+        bestroutes  Id(8) Seqno(2) Fd(2) NumRoutes(2)
+        resends     Kind(1) Max(1) Delay(2) AgeMs(4) Seqno(2) Id(8) Interface(16)
+    Neighbour is the position of the route's neighbour in the neighbours table,
+    ages are in seconds unless stated otherwise, and Time is the daemon's
+    clock, in seconds, when the snapshot was taken.  Entries may grow fields at
+    their end only with a new version.
+*/
+#define CefC_Cbabel_Msg_Type_Snapshot   0x16        /* Type Get Snapshot            */
+#define CefC_Cbabel_Snapshot_Magic      "CBSN"
+#define CefC_Cbabel_Snapshot_Ver        1
+#define CefC_Cbabel_Snapshot_HeaderLen  26
+
+enum {
+    CefC_Snap_Neighbours = 1,
+    CefC_Snap_Xroutes,
+    CefC_Snap_Routes,
+    CefC_Snap_Sources,
+    CefC_Snap_Bestroutes,
+    CefC_Snap_Resends,
+    CefC_Snap_Num
+};
+
+/* Flags of the routes */
+#define CefC_Snap_Installed             0x01
+#define CefC_Snap_Feasible              0x02
+
+/*
+    The Get Trace request has no body, and its response, after the response
+    header, is the content of the event trace ring, as written to the
+    trace-file:
+        Magic(4) Version(2) Time(8) RecordLen(2) NumRecords(4) TotalEvents(8)
+        NumNames(4) Record * NumRecords {Ref(4) Plen(2) Prefix(Plen)} * NumNames
+    The records, oldest first, are
+        Sec(4) Usec(4) Ref(4) Arg(4) Addr(4) Plen(2) Ifindex(2) Seqno(2)
+        Metric(2) Type(1) Flags(1) Pad(2)
+    Sec and Usec are the daemon's clock at the iteration of the main loop where
+    the event happened, Ref a hash of the prefix (0 for none) that the names at
+    the end map back to the prefixes still known to the daemon, and Addr the
+    last 4 bytes of the neighbour's or next hop's address.  TotalEvents counts
+    the events since startup, including the ones overwritten in the ring.
+*/
+#define CefC_Cbabel_Msg_Type_Trace      0x17        /* Type Get Trace               */
+#define CefC_Cbabel_Trace_Magic         "CBTR"
+#define CefC_Cbabel_Trace_Ver           1
+#define CefC_Cbabel_Trace_HeaderLen     32
+#define CefC_Cbabel_Trace_RecordLen     32
+
+enum {
+    CefC_Trace_Update = 1,          /* Update received, Arg: interval           */
+    CefC_Trace_Request,             /* Request sent, Arg: hop count             */
+    CefC_Trace_Install,             /* Route installed                          */
+    CefC_Trace_Uninstall,           /* Route uninstalled                        */
+    CefC_Trace_Switch,              /* Route switched, Arg: old metric          */
+    CefC_Trace_Flush,               /* Route flushed                            */
+    CefC_Trace_Neigh_Flush,         /* Neighbour flushed, Metric: cost          */
+    CefC_Trace_Fib_Add,             /* FIB Add, Metric: weight, Arg: port       */
+    CefC_Trace_Fib_Del,             /* FIB Delete, Arg: port                    */
+    CefC_Trace_Fib_Fail,            /* FIB Requests failed, Arg: how many       */
+    CefC_Trace_Num
+};
+
+/* Flags of the records */
+#define CefC_Trace_Seqno                0x01        /* seqno request            */
+#define CefC_Trace_Batched              0x02        /* FIB Request batched      */
+#define CefC_Trace_Installed            0x04        /* flushed route installed  */
+
 int 
 cefore_init (
     int port_num, 
@@ -86,6 +297,35 @@ cefore_fib_del_req_send (
     unsigned short port,
     char* interface
 );
+int 
+cefore_fib_del_batch_add (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface
+);
+int 
+cefore_fib_add_batch_add (
+    const unsigned char* prefix, 
+    int plen, 
+    const unsigned char* nexthop, 
+    unsigned short port,
+    char* interface,
+    int weight
+);
+int 
+cefore_fib_batch_send (
+    void
+);
+void 
+cefore_fib_defer_begin (
+    void
+);
+int 
+cefore_fib_defer_end (
+    void
+);
 
 int
 cefbabeld_tcp_sock_create (
@@ -95,5 +335,17 @@ cefbabeld_tcp_sock_create (
 void
 cefbabel_tcp_stat_prcess ();
 
+int 
+cefbabel_tcp_stat_fds (
+    fd_set* readfds,
+    fd_set* writefds
+);
+
+void
+cefbabel_tcp_stat_io (
+    fd_set* readfds,
+    fd_set* writefds
+);
+
 #endif // __CEFORE_HEADER__
 
@@ -0,0 +1,211 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * compress.c
+ *
+ * Packet compression.  The encoding is a plain LZ77 stream of tokens:
+ *
+ *   0lllllll  literal run of l + 1 bytes, which follow the token
+ *   1mmmmmmm  match of m + 4 bytes, followed by a 2-byte offset
+ *
+ * A match never costs more than the literals it replaces, so the size
+ * of the output is bounded by that of an all-literal encoding, which is
+ * what lets the sender fill a packet exactly.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "compress.h"
+
+int packet_compression = 0;
+
+#define MIN_MATCH 4
+#define MAX_MATCH (0x7F + MIN_MATCH)
+#define MAX_LITERALS 0x80
+#define MAX_OFFSET 0xFFFF
+
+struct compressor *
+compressor_new(int capacity)
+{
+    struct compressor *zc;
+
+    zc = calloc(1, sizeof(struct compressor));
+    if(zc == NULL)
+        return NULL;
+    zc->capacity = capacity;
+    zc->hist = malloc(capacity);
+    zc->out = malloc(capacity + (capacity + MAX_LITERALS - 1) / MAX_LITERALS);
+    if(zc->hist == NULL || zc->out == NULL) {
+        compressor_free(zc);
+        return NULL;
+    }
+    compressor_reset(zc);
+    return zc;
+}
+
+void
+compressor_free(struct compressor *zc)
+{
+    if(zc == NULL)
+        return;
+    free(zc->hist);
+    free(zc->out);
+    free(zc);
+}
+
+void
+compressor_reset(struct compressor *zc)
+{
+    zc->hlen = 0;
+    zc->pos = 0;
+    zc->lit = 0;
+    zc->zlen = 0;
+    memset(zc->table, 0xFF, sizeof(zc->table));
+}
+
+static unsigned int
+hash4(const unsigned char *p)
+{
+    unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+    return ((v * 2654435761U) >> 21) & (COMPRESS_HASH_SIZE - 1);
+}
+
+static void
+emit_literals(struct compressor *zc, int end)
+{
+    int n;
+    while(zc->lit < end) {
+        n = end - zc->lit;
+        if(n > MAX_LITERALS)
+            n = MAX_LITERALS;
+        zc->out[zc->zlen++] = n - 1;
+        memcpy(zc->out + zc->zlen, zc->hist + zc->lit, n);
+        zc->zlen += n;
+        zc->lit += n;
+    }
+}
+
+int
+compressor_feed(struct compressor *zc, const unsigned char *data, int len)
+{
+    if(zc->hlen + len > zc->capacity)
+        return -1;
+    memcpy(zc->hist + zc->hlen, data, len);
+    zc->hlen += len;
+
+    while(zc->pos + MIN_MATCH <= zc->hlen) {
+        const unsigned char *p = zc->hist + zc->pos;
+        unsigned int h = hash4(p);
+        int cand = zc->table[h];
+        int m;
+
+        zc->table[h] = zc->pos;
+        if(cand < 0 || zc->pos - cand > MAX_OFFSET ||
+           memcmp(zc->hist + cand, p, MIN_MATCH) != 0) {
+            zc->pos++;
+            continue;
+        }
+        m = MIN_MATCH;
+        while(m < MAX_MATCH && zc->pos + m < zc->hlen &&
+              zc->hist[cand + m] == p[m])
+            m++;
+        emit_literals(zc, zc->pos);
+        zc->out[zc->zlen++] = 0x80 | (m - MIN_MATCH);
+        zc->out[zc->zlen++] = (zc->pos - cand) >> 8;
+        zc->out[zc->zlen++] = (zc->pos - cand) & 0xFF;
+        zc->pos += m;
+        zc->lit = zc->pos;
+    }
+    return 0;
+}
+
+/* Largest size the output can have once extra more bytes are fed. */
+int
+compressor_bound(const struct compressor *zc, int extra)
+{
+    int l = zc->hlen - zc->lit + extra;
+    return zc->zlen + l + (l + MAX_LITERALS - 1) / MAX_LITERALS;
+}
+
+/* Largest number of bytes that can still be fed while keeping the output
+   within avail bytes. */
+int
+compressor_room(const struct compressor *zc, int avail)
+{
+    int l = zc->hlen - zc->lit;
+    int n = (avail - zc->zlen) * MAX_LITERALS / (MAX_LITERALS + 1) - l;
+    n = n < 0 ? 0 : n;
+    if(n > zc->capacity - zc->hlen)
+        n = zc->capacity - zc->hlen;
+    return n;
+}
+
+int
+compressor_finish(struct compressor *zc)
+{
+    emit_literals(zc, zc->hlen);
+    zc->pos = zc->hlen;
+    return zc->zlen;
+}
+
+int
+decompress_block(const unsigned char *in, int inlen,
+                 unsigned char *out, int outmax)
+{
+    int i = 0, o = 0, n, off;
+
+    while(i < inlen) {
+        unsigned char t = in[i++];
+        if(t & 0x80) {
+            if(i + 2 > inlen)
+                return -1;
+            n = (t & 0x7F) + MIN_MATCH;
+            off = (in[i] << 8) | in[i + 1];
+            i += 2;
+            if(off == 0 || off > o || o + n > outmax)
+                return -1;
+            while(n-- > 0) {
+                out[o] = out[o - off];
+                o++;
+            }
+        } else {
+            n = t + 1;
+            if(i + n > inlen || o + n > outmax)
+                return -1;
+            memcpy(out + o, in + i, n);
+            i += n;
+            o += n;
+        }
+    }
+    return o;
+}
+#endif //----- ADD -----
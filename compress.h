@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * compress.h
+ */
+
+#ifndef __COMPRESS_HEADER__
+#define __COMPRESS_HEADER__
+
+/* How much raw data a compressing send buffer may hold, relative to the
+   size of a packet. */
+#define PACKET_COMPRESSION_RATIO 8
+
+#define COMPRESS_HASH_SIZE 2048
+
+/* Incremental LZ77 compressor.  Input is fed one message at a time, and
+   the output is always the encoding of everything fed so far, except
+   for a tail of pending literals. */
+struct compressor {
+    unsigned char *hist;
+    int hlen;
+    int capacity;
+    int pos;                    /* next input position to look at */
+    int lit;                    /* start of the pending literals */
+    unsigned char *out;
+    int zlen;
+    int table[COMPRESS_HASH_SIZE];
+};
+
+/* Compress packets sent to neighbours that support it. */
+extern int packet_compression;
+
+struct compressor *compressor_new(int capacity);
+void compressor_free(struct compressor *zc);
+void compressor_reset(struct compressor *zc);
+int compressor_feed(struct compressor *zc, const unsigned char *data, int len);
+int compressor_bound(const struct compressor *zc, int extra);
+int compressor_room(const struct compressor *zc, int avail);
+int compressor_finish(struct compressor *zc);
+int decompress_block(const unsigned char *in, int inlen,
+                     unsigned char *out, int outmax);
+
+#endif
@@ -70,6 +70,32 @@ THE SOFTWARE.
 #include "kernel.h"
 #include "configuration.h"
 #include "rule.h"
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+#include "neighbour.h"
+#include "digest.h"
+#endif //----- ADD for DIGEST -----
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+#include "resend.h"
+#endif //----- ADD for REQUEST LIMIT -----
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+#include "compress.h"
+#endif //----- ADD for PACKET COMPRESSION -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+#include "damping.h"
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+#include <time.h>
+#include "latency.h"
+#endif //----- ADD for LATENCY -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+#include "convergence.h"
+#endif //----- ADD for CONVERGENCE -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+#include "snapshot.h"
+#endif //----- ADD for SNAPSHOT -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+#include "trace.h"
+#endif //----- ADD for TRACE -----
 
 struct filter *input_filters = NULL;
 struct filter *output_filters = NULL;
@@ -1006,6 +1032,122 @@ parse_option(int c, gnc_t gnc, void *closure, char *token)
 #endif //----- DEL -----
         else
             abort();
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+    } else if(strcmp(token, "delta-updates") == 0) {
+        int b;
+        c = getbool(c, &b, gnc, closure);
+        if(c < -1)
+            goto error;
+        delta_updates = (b == CONFIG_YES);
+#endif //----- ADD for DIGEST -----
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+    } else if(strcmp(token, "request-budget") == 0) {
+        int v;
+        c = getint(c, &v, gnc, closure);
+        if(c < -1 || v < 0)
+            goto error;
+        request_budget = v;
+#endif //----- ADD for REQUEST LIMIT -----
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+    } else if(strcmp(token, "packet-compression") == 0) {
+        int b;
+        c = getbool(c, &b, gnc, closure);
+        if(c < -1)
+            goto error;
+        packet_compression = (b == CONFIG_YES);
+#endif //----- ADD for PACKET COMPRESSION -----
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+    } else if(strcmp(token, "switch-hysteresis") == 0) {
+        int v;
+        c = getint(c, &v, gnc, closure);
+        if(c < -1 || v < 0 || v >= INFINITY)
+            goto error;
+        switch_hysteresis = v;
+    } else if(strcmp(token, "switch-dwell") == 0) {
+        int v;
+        c = getint(c, &v, gnc, closure);
+        if(c < -1 || v < 0)
+            goto error;
+        switch_dwell = v;
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for WEIGHTED MULTIPATH +++++
+    } else if(strcmp(token, "fib-weights") == 0) {
+        int b;
+        c = getbool(c, &b, gnc, closure);
+        if(c < -1)
+            goto error;
+        fib_weights = (b == CONFIG_YES);
+#endif //----- ADD for WEIGHTED MULTIPATH -----
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+    } else if(strcmp(token, "latency-histograms") == 0) {
+        int b;
+        c = getbool(c, &b, gnc, closure);
+        if(c < -1)
+            goto error;
+        latency_histograms = (b == CONFIG_YES);
+#endif //----- ADD for LATENCY -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    } else if(strcmp(token, "convergence-tracing") == 0) {
+        int b;
+        c = getbool(c, &b, gnc, closure);
+        if(c < -1)
+            goto error;
+        convergence_tracing = (b == CONFIG_YES);
+#endif //----- ADD for CONVERGENCE -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    } else if(strcmp(token, "flap-damping") == 0) {
+        int b;
+        c = getbool(c, &b, gnc, closure);
+        if(c < -1)
+            goto error;
+        flap_damping = (b == CONFIG_YES);
+    } else if(strcmp(token, "damping-half-life") == 0 ||
+              strcmp(token, "damping-max-suppress") == 0 ||
+              strcmp(token, "damping-suppress") == 0 ||
+              strcmp(token, "damping-reuse") == 0) {
+        int v;
+        c = getint(c, &v, gnc, closure);
+        if(c < -1 || v <= 0)
+            goto error;
+        if(strcmp(token, "damping-half-life") == 0)
+            damping_half_life = v;
+        else if(strcmp(token, "damping-max-suppress") == 0)
+            damping_max_suppress = v;
+        else if(strcmp(token, "damping-suppress") == 0)
+            damping_suppress = v;
+        else
+            damping_reuse = v;
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+    } else if(strcmp(token, "snapshot-file") == 0) {
+        char *file;
+        c = getstring(c, &file, gnc, closure);
+        if(c < -1)
+            goto error;
+        free(snapshot_file);
+        snapshot_file = file;
+    } else if(strcmp(token, "snapshot-interval") == 0) {
+        int v;
+        c = getint(c, &v, gnc, closure);
+        if(c < -1 || v < 0)
+            goto error;
+        snapshot_interval = v;
+#endif //----- ADD for SNAPSHOT -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    } else if(strcmp(token, "trace-file") == 0) {
+        char *file;
+        c = getstring(c, &file, gnc, closure);
+        if(c < -1)
+            goto error;
+        free(trace_file);
+        trace_file = file;
+    } else if(strcmp(token, "trace-records") == 0) {
+        int v;
+        c = getint(c, &v, gnc, closure);
+        if(c < -1 || v < 0 || v > (1 << 24))
+            goto error;
+        trace_records = v;
+#endif //----- ADD for TRACE -----
     } else if(strcmp(token, "protocol-group") == 0) {
         unsigned char *group = NULL;
         c = getip(c, &group, NULL, gnc, closure);
@@ -0,0 +1,348 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * convergence.c
+ *
+ * Per-prefix convergence tracing.  A trace is opened when an update for a
+ * prefix is received from a neighbour, or when cefnetd tells us about a
+ * local prefix, and records how long it takes until the FIB entry for the
+ * prefix is programmed in cefnetd and until we advertise the prefix.
+ * Both delays feed the latency histograms, and the slowest prefixes are
+ * kept for the status report.
+ *
+ * Most updates change nothing.  A trace that has neither programmed the
+ * FIB nor scheduled an update by the end of the packet that opened it is
+ * dropped in convergence_settle, so that a later unrelated change is not
+ * measured from a stale start.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "babeld.h"
+#include "util.h"
+#include "cefore.h"
+#include "latency.h"
+#include "convergence.h"
+
+int convergence_tracing = 0;
+
+#define CONVERGENCE_BUCKETS 256
+
+#define CONVERGENCE_FIB 1           /* FIB programmed */
+#define CONVERGENCE_FIB_QUEUED 2    /* FIB request waiting in a batch */
+#define CONVERGENCE_SCHEDULED 4     /* update scheduled */
+
+struct convergence {
+    unsigned char *prefix;
+    uint16_t plen;
+    int progress;
+    struct timespec received;
+    unsigned long long fib_ns;
+    struct convergence *next;
+};
+
+struct slow_prefix {
+    unsigned char *prefix;
+    uint16_t plen;
+    unsigned long long fib_ns;
+    unsigned long long adv_ns;
+};
+
+static struct convergence *convergence_table[CONVERGENCE_BUCKETS];
+static int num_fresh = 0;       /* traces opened since the last settle */
+static int num_queued = 0;      /* traces with CONVERGENCE_FIB_QUEUED */
+
+static struct slow_prefix slowest[CONVERGENCE_SLOWEST];
+static int num_slowest = 0;
+
+static unsigned int
+convergence_hash(const unsigned char *prefix, uint16_t plen)
+{
+    return hash_prefix(prefix, plen) & (CONVERGENCE_BUCKETS - 1);
+}
+
+static unsigned long long
+elapsed_ns(const struct timespec *start)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)(ts.tv_sec - start->tv_sec) * 1000000000ULL +
+        ts.tv_nsec - start->tv_nsec;
+}
+
+static struct convergence *
+find_convergence(const unsigned char *prefix, uint16_t plen)
+{
+    struct convergence *c;
+
+    for(c = convergence_table[convergence_hash(prefix, plen)]; c; c = c->next) {
+        if(c->plen == plen && memcmp(c->prefix, prefix, plen) == 0)
+            return c;
+    }
+    return NULL;
+}
+
+static void
+free_convergence(struct convergence *c)
+{
+    if(c->progress & CONVERGENCE_FIB_QUEUED)
+        num_queued--;
+    free(c->prefix);
+    free(c);
+}
+
+static void
+remove_convergence(struct convergence *c)
+{
+    struct convergence **p = &convergence_table[convergence_hash(c->prefix,
+                                                                 c->plen)];
+    while(*p != c)
+        p = &(*p)->next;
+    *p = c->next;
+    free_convergence(c);
+}
+
+void
+convergence_start(const unsigned char *prefix, uint16_t plen)
+{
+    struct convergence *c;
+    unsigned int h;
+
+    if(!convergence_tracing)
+        return;
+
+    /* An open trace keeps the time of the first update not yet acted on. */
+    if(find_convergence(prefix, plen))
+        return;
+
+    c = calloc(1, sizeof(struct convergence));
+    if(c == NULL) {
+        perror("malloc(convergence)");
+        return;
+    }
+    c->prefix = malloc(plen > 0 ? plen : 1);
+    if(c->prefix == NULL) {
+        perror("malloc(convergence)");
+        free(c);
+        return;
+    }
+    memcpy(c->prefix, prefix, plen);
+    c->plen = plen;
+    clock_gettime(CLOCK_MONOTONIC, &c->received);
+    h = convergence_hash(prefix, plen);
+    c->next = convergence_table[h];
+    convergence_table[h] = c;
+    num_fresh++;
+}
+
+static void
+fib_done(struct convergence *c)
+{
+    c->fib_ns = elapsed_ns(&c->received);
+    latency_add(CefC_Lat_Conv_Fib, c->fib_ns);
+    if(c->progress & CONVERGENCE_FIB_QUEUED)
+        num_queued--;
+    c->progress &= ~CONVERGENCE_FIB_QUEUED;
+    c->progress |= CONVERGENCE_FIB;
+}
+
+/* A FIB request for the prefix was answered by cefnetd or, if queued,
+   was added to a batch that convergence_fib_flushed will account for. */
+void
+convergence_fib(const unsigned char *prefix, uint16_t plen, int queued)
+{
+    struct convergence *c;
+
+    if(!convergence_tracing)
+        return;
+    c = find_convergence(prefix, plen);
+    if(c == NULL || (c->progress & (CONVERGENCE_FIB | CONVERGENCE_FIB_QUEUED)))
+        return;
+    if(queued) {
+        c->progress |= CONVERGENCE_FIB_QUEUED;
+        num_queued++;
+    } else {
+        fib_done(c);
+    }
+}
+
+void
+convergence_fib_flushed(void)
+{
+    struct convergence *c;
+    int i;
+
+    for(i = 0; i < CONVERGENCE_BUCKETS && num_queued > 0; i++) {
+        for(c = convergence_table[i]; c; c = c->next) {
+            if(c->progress & CONVERGENCE_FIB_QUEUED)
+                fib_done(c);
+        }
+    }
+}
+
+void
+convergence_scheduled(const unsigned char *prefix, uint16_t plen)
+{
+    struct convergence *c;
+
+    if(!convergence_tracing)
+        return;
+    c = find_convergence(prefix, plen);
+    if(c)
+        c->progress |= CONVERGENCE_SCHEDULED;
+}
+
+static void
+record_slowest(const struct convergence *c, unsigned long long adv_ns)
+{
+    unsigned char *prefix;
+    int i;
+
+    if(num_slowest == CONVERGENCE_SLOWEST &&
+       adv_ns <= slowest[num_slowest - 1].adv_ns)
+        return;
+    prefix = malloc(c->plen > 0 ? c->plen : 1);
+    if(prefix == NULL)
+        return;
+    memcpy(prefix, c->prefix, c->plen);
+
+    if(num_slowest == CONVERGENCE_SLOWEST)
+        free(slowest[--num_slowest].prefix);
+    i = num_slowest++;
+    while(i > 0 && slowest[i - 1].adv_ns < adv_ns) {
+        slowest[i] = slowest[i - 1];
+        i--;
+    }
+    slowest[i].prefix = prefix;
+    slowest[i].plen = c->plen;
+    slowest[i].fib_ns = (c->progress & CONVERGENCE_FIB) ? c->fib_ns : 0;
+    slowest[i].adv_ns = adv_ns;
+}
+
+/* We sent an update for the prefix; this closes its trace. */
+void
+convergence_advertised(const unsigned char *prefix, uint16_t plen)
+{
+    struct convergence *c;
+    unsigned long long adv_ns;
+
+    if(!convergence_tracing)
+        return;
+    c = find_convergence(prefix, plen);
+    if(c == NULL)
+        return;
+    adv_ns = elapsed_ns(&c->received);
+    latency_add(CefC_Lat_Conv_Advertise, adv_ns);
+    record_slowest(c, adv_ns);
+    remove_convergence(c);
+}
+
+/* Called once the packet or notification that opened traces has been
+   processed: drop the traces it did not act upon. */
+void
+convergence_settle(void)
+{
+    struct convergence **p, *c;
+    int i;
+
+    if(num_fresh == 0)
+        return;
+    num_fresh = 0;
+    for(i = 0; i < CONVERGENCE_BUCKETS; i++) {
+        p = &convergence_table[i];
+        while((c = *p) != NULL) {
+            if(c->progress == 0) {
+                *p = c->next;
+                free_convergence(c);
+                continue;
+            }
+            p = &c->next;
+        }
+    }
+}
+
+/* Forget the traces that will never be advertised, for example a prefix
+   whose FIB entry changed but whose announcement is unchanged. */
+void
+expire_convergence(void)
+{
+    struct convergence **p, *c;
+    struct timespec ts;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for(i = 0; i < CONVERGENCE_BUCKETS; i++) {
+        p = &convergence_table[i];
+        while((c = *p) != NULL) {
+            if(ts.tv_sec - c->received.tv_sec > CONVERGENCE_TIMEOUT) {
+                *p = c->next;
+                free_convergence(c);
+                continue;
+            }
+            p = &c->next;
+        }
+    }
+}
+
+void
+convergence_reset(void)
+{
+    int i;
+
+    for(i = 0; i < num_slowest; i++)
+        free(slowest[i].prefix);
+    num_slowest = 0;
+}
+
+/* One NUL-terminated line per slowest prefix, for the status socket.
+   Returns the number of bytes written. */
+int
+convergence_status(char *buf, int len)
+{
+    int i, n, index = 0;
+
+    for(i = 0; i < num_slowest; i++) {
+        n = snprintf(buf + index, len - index,
+                     "Slow %s : FIB %lluus, advertised %lluus",
+                     format_cefore_prefix(slowest[i].prefix, slowest[i].plen),
+                     slowest[i].fib_ns / 1000, slowest[i].adv_ns / 1000);
+        if(n < 0 || n + 1 > len - index)
+            return index;
+        index += n + 1;
+    }
+    return index;
+}
+
+#endif //----- ADD -----
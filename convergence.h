@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * convergence.h
+ */
+
+#ifndef __CONVERGENCE_HEADER__
+#define __CONVERGENCE_HEADER__
+
+/* Number of prefixes kept in the slowest-converging report. */
+#define CONVERGENCE_SLOWEST 16
+/* Traces still open after this many seconds are dropped. */
+#define CONVERGENCE_TIMEOUT 60
+
+extern int convergence_tracing;
+
+void convergence_start(const unsigned char *prefix, uint16_t plen);
+void convergence_fib(const unsigned char *prefix, uint16_t plen, int queued);
+void convergence_fib_flushed(void);
+void convergence_scheduled(const unsigned char *prefix, uint16_t plen);
+void convergence_advertised(const unsigned char *prefix, uint16_t plen);
+void convergence_settle(void);
+void expire_convergence(void);
+void convergence_reset(void);
+int convergence_status(char *buf, int len);
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * damping.c
+ *
+ * Route flap damping after RFC 2439.  Every source whose routes have
+ * flapped recently carries a penalty, which grows by DAMPING_WITHDRAW
+ * when its last usable route goes away and by DAMPING_READVERTISE when
+ * one comes back, and halves every damping_half_life seconds.  The
+ * routing code reports those changes through damping_update; per-interface
+ * sends play no part in it.  While the penalty exceeds damping_suppress
+ * the routes of the source are neither installed in cefnetd's FIB nor
+ * announced (retractions still go out), until the penalty decays below
+ * damping_reuse.
+ *
+ * A source without an entry is a reachable source with no penalty, so
+ * stable prefixes cost nothing.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#include "babeld.h"
+#include "util.h"
+#include "interface.h"
+#include "neighbour.h"
+#include "source.h"
+#include "route.h"
+#include "damping.h"
+
+int flap_damping = 0;
+int damping_half_life = 900;
+int damping_suppress = 3000;
+int damping_reuse = 750;
+int damping_max_suppress = 3600;
+
+int cefstat_damped_num = 0;
+
+/* Decay the penalty to now.  2^-x is approximated by halving once per
+   half-life and interpolating linearly in between. */
+static void
+decay_penalty(struct damping *d)
+{
+    time_t dt = now.tv_sec - d->time;
+    int hl = MAX(damping_half_life, 1);
+
+    if(dt <= 0)
+        return;
+    if(dt / hl >= 16)
+        d->penalty = 0;
+    else
+        d->penalty >>= dt / hl;
+    d->penalty -= d->penalty * (dt % hl) / (2 * hl);
+    d->time = now.tv_sec;
+}
+
+/* The penalty at which a prefix stays suppressed for damping_max_suppress
+   seconds; we never accumulate more than that. */
+static int
+max_penalty(void)
+{
+    int hl = MAX(damping_half_life, 1);
+    int shift = MIN(damping_max_suppress / hl, 16);
+    return damping_reuse << shift;
+}
+
+/* Called by the routing code whenever the routes of src may have changed.
+   Only a change of reachability moves the penalty, so repeated calls for
+   the same state are harmless. */
+void
+damping_update(struct source *src, int reachable)
+{
+    struct damping *d = src->damping;
+
+    if(!flap_damping)
+        return;
+
+    if(d == NULL) {
+        if(reachable)
+            return;
+        d = calloc(1, sizeof(struct damping));
+        if(d == NULL) {
+            perror("malloc(damping)");
+            return;
+        }
+        d->reachable = 1;
+        d->time = now.tv_sec;
+        src->damping = d;
+    }
+
+    if(d->reachable == reachable)
+        return;
+
+    decay_penalty(d);
+    d->penalty += reachable ? DAMPING_READVERTISE : DAMPING_WITHDRAW;
+    d->penalty = MIN(d->penalty, max_penalty());
+    d->reachable = reachable;
+    if(!d->suppressed && d->penalty > damping_suppress) {
+        debugf("Suppressing flapping prefix %s (penalty %d).\n",
+               source_uri(src), d->penalty);
+        d->suppressed = 1;
+        cefstat_damped_num++;
+    }
+}
+
+int
+damping_suppressed(const struct source *src)
+{
+    return src->damping != NULL && src->damping->suppressed;
+}
+
+/* The multipath modes replace a source record when its seqno moves on;
+   these carry the penalty over to the new record. */
+struct damping *
+damping_detach(struct source *src)
+{
+    struct damping *d = src->damping;
+    src->damping = NULL;
+    return d;
+}
+
+void
+damping_attach(struct source *src, struct damping *d)
+{
+    if(d == NULL)
+        return;
+    if(src == NULL || src->damping != NULL) {
+        if(d->suppressed)
+            cefstat_damped_num--;
+        free(d);
+        return;
+    }
+    src->damping = d;
+}
+
+/* Called before a source record is freed. */
+void
+damping_forget(struct source *src)
+{
+    damping_attach(NULL, damping_detach(src));
+}
+
+/* Seconds until a suppressed entry's penalty falls below damping_reuse. */
+static int
+reuse_time(const struct damping *d)
+{
+    int hl = MAX(damping_half_life, 1);
+    int penalty = d->penalty;
+    int t = 0;
+
+    while(penalty >= 2 * damping_reuse) {
+        penalty >>= 1;
+        t += hl;
+    }
+    if(penalty >= damping_reuse)
+        t += 2 * hl * (penalty - damping_reuse) / penalty + 1;
+    return t;
+}
+
+/* Called periodically: decay penalties, release sources that can be
+   reused and forget the ones that have settled down. */
+void
+expire_damping(void)
+{
+    struct source *src;
+    struct damping *d;
+    int i;
+
+    for(i = 0; (src = source_slot(i)) != NULL; i++) {
+        d = src->damping;
+        if(d == NULL)
+            continue;
+        decay_penalty(d);
+        if(d->suppressed && d->penalty < damping_reuse) {
+            debugf("Reusing prefix %s.\n", source_uri(src));
+            d->suppressed = 0;
+            cefstat_damped_num--;
+            if(d->reachable)
+                route_reused(src);
+        }
+        if(!d->suppressed && d->penalty < damping_reuse / 2) {
+            src->damping = NULL;
+            free(d);
+        }
+    }
+}
+
+/* One NUL-terminated line per suppressed prefix, for the status socket.
+   Returns the number of bytes written. */
+int
+damping_status(char *buf, int len)
+{
+    struct source *src;
+    struct damping *d;
+    int i, n, index = 0;
+
+    for(i = 0; (src = source_slot(i)) != NULL; i++) {
+        d = src->damping;
+        if(d == NULL || !d->suppressed)
+            continue;
+        decay_penalty(d);
+        n = snprintf(buf + index, len - index,
+                     "Damped %s : penalty %d, reuse in %ds%s",
+                     source_uri(src), d->penalty, reuse_time(d),
+                     d->reachable ? "" : " (unreachable)");
+        if(n < 0 || n + 1 > len - index)
+            return index;
+        index += n + 1;
+    }
+    return index;
+}
+
+#endif //----- ADD -----
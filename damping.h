@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * damping.h
+ */
+
+#ifndef __DAMPING_HEADER__
+#define __DAMPING_HEADER__
+
+/* Penalties, in the units of RFC 2439. */
+#define DAMPING_WITHDRAW 1000
+#define DAMPING_READVERTISE 500
+
+struct source;
+
+/* Hangs off the source record of a prefix that has flapped. */
+struct damping {
+    int reachable;
+    int suppressed;
+    int penalty;
+    time_t time;                /* when penalty was last decayed */
+};
+
+extern int flap_damping;
+extern int damping_half_life, damping_max_suppress;
+extern int damping_suppress, damping_reuse;
+extern int cefstat_damped_num;
+
+void damping_update(struct source *src, int reachable);
+int damping_suppressed(const struct source *src);
+struct damping *damping_detach(struct source *src);
+void damping_attach(struct source *src, struct damping *d);
+void damping_forget(struct source *src);
+void expire_damping(void);
+int damping_status(char *buf, int len);
+
+#endif
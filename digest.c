@@ -0,0 +1,473 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * digest.c
+ *
+ * Delta-only periodic updates.  Instead of dumping the whole table every
+ * update interval, we send a digest of what we announce: the announced
+ * (router-id, prefix, seqno, metric) tuples are hashed into buckets by
+ * prefix, and each bucket carries the sum of the hashes of its tuples.
+ * A neighbour computes the same digest over the routes it holds from us
+ * and the updates from us it drops, refreshes the routes in matching
+ * buckets and asks for the others.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "babeld.h"
+#include "util.h"
+#include "interface.h"
+#include "source.h"
+#include "neighbour.h"
+#include "route.h"
+#include "kernel.h"
+#include "xroute.h"
+#include "message.h"
+#include "digest.h"
+
+int delta_updates = 0;
+
+unsigned int
+digest_bucket(const unsigned char *prefix, uint16_t plen, int nbuckets)
+{
+    return hash_prefix(prefix, plen) & (nbuckets - 1);
+}
+
+static unsigned int
+digest_entry(const unsigned char *id, const unsigned char *prefix,
+             uint16_t plen, unsigned short seqno, unsigned short metric)
+{
+    unsigned char tail[6];
+    unsigned int h;
+
+    h = hash_bytes(HASH_INIT, id, 8);
+    h = hash_bytes(h, prefix, plen);
+    DO_HTONS(tail, plen);
+    DO_HTONS(tail + 2, seqno);
+    DO_HTONS(tail + 4, metric);
+    return hash_bytes(h, tail, 6);
+}
+
+/* Work out what flushupdates would announce for this prefix on ifp.
+   Returns 0 if it would announce nothing or a retraction. */
+static int
+advertised_update(struct interface *ifp,
+                  const unsigned char *prefix, uint16_t plen,
+                  const unsigned char *src_prefix, unsigned char src_plen,
+                  const unsigned char **id_r,
+                  unsigned short *seqno_r, unsigned short *metric_r)
+{
+    struct xroute *xroute;
+    struct babel_route *route;
+    unsigned short seqno, metric;
+
+    xroute = find_xroute(prefix, plen, src_prefix, src_plen);
+    route = find_installed_route(prefix, plen, src_prefix, src_plen);
+
+    if(xroute && !route) {
+        *id_r = myid;
+        *seqno_r = myseqno;
+        *metric_r = xroute->metric;
+        return xroute->metric < INFINITY;
+    }
+
+    if(!route)
+        return 0;
+
+    seqno = route->seqno;
+    metric = route_interferes(route, ifp) ?
+        route_metric(route) : route_metric_noninterfering(route);
+    if(route_ctrl_type == ROUTE_CTRL_TYPE_MS) {
+        metric = updateFeasibleDistance_mpss(prefix, plen,
+                                             src_prefix, src_plen);
+    } else if(route_ctrl_type == ROUTE_CTRL_TYPE_MM) {
+        struct best_route *broute;
+        broute = find_bestroute(prefix, plen, src_prefix, src_plen, 0);
+        if(!broute)
+            return 0;
+        route = find_route_assoc_broute(broute, prefix, plen,
+                                        src_prefix, src_plen);
+        if(!route)
+            return 0;
+        metric = broute->my_FD;
+        seqno = broute->my_seqNo;
+    }
+
+    if((ifp->flags & IF_SPLIT_HORIZON) && route->neigh->ifp == ifp)
+        return 0;
+    if(metric >= INFINITY)
+        return 0;
+
+    *id_r = route->src->id;
+    *seqno_r = seqno;
+    *metric_r = metric;
+    return 1;
+}
+
+static void
+digest_add(struct route_digest *digest, struct interface *ifp,
+           const unsigned char *prefix, uint16_t plen,
+           const unsigned char *src_prefix, unsigned char src_plen)
+{
+    const unsigned char *id;
+    unsigned short seqno, metric;
+
+    if(!advertised_update(ifp, prefix, plen, src_prefix, src_plen,
+                          &id, &seqno, &metric))
+        return;
+    digest->hash[digest_bucket(prefix, plen, digest->nbuckets)] +=
+        digest_entry(id, prefix, plen, seqno, metric);
+}
+
+/* The largest number of buckets whose digest TLV fits in a buffer of
+   size bytes, or 0 if even the smallest digest does not. */
+int
+digest_buckets(int size)
+{
+    int nbuckets = DIGEST_BUCKETS;
+
+    while(nbuckets >= DIGEST_MIN_BUCKETS && 6 + 4 * nbuckets > size)
+        nbuckets /= 2;
+    return nbuckets >= DIGEST_MIN_BUCKETS ? nbuckets : 0;
+}
+
+/* Digest of everything we currently announce on ifp. */
+void
+digest_interface(struct interface *ifp, struct route_digest *digest,
+                 int nbuckets)
+{
+    struct xroute_stream *xroutes;
+    struct route_stream *routes;
+
+    digest->nbuckets = nbuckets;
+    memset(digest->hash, 0, sizeof(digest->hash));
+
+    xroutes = xroute_stream();
+    if(xroutes) {
+        while(1) {
+            struct xroute *xroute = xroute_stream_next(xroutes);
+            if(xroute == NULL)
+                break;
+            /* Counted below, together with the installed routes. */
+            if(find_installed_route(xroute->prefix, xroute->plen,
+                                    xroute->src_prefix, xroute->src_plen))
+                continue;
+            digest_add(digest, ifp, xroute->prefix, xroute->plen,
+                       xroute->src_prefix, xroute->src_plen);
+        }
+        xroute_stream_done(xroutes);
+    } else {
+        fprintf(stderr, "Couldn't allocate xroute stream.\n");
+    }
+
+    routes = route_stream(ROUTE_INSTALLED);
+    if(routes) {
+        while(1) {
+            struct babel_route *route = route_stream_next(routes);
+            if(route == NULL)
+                break;
+            digest_add(digest, ifp, route->src->prefix, route->src->plen,
+                       route->src->src_prefix, route->src->src_plen);
+        }
+        route_stream_done(routes);
+    } else {
+        fprintf(stderr, "Couldn't allocate route stream.\n");
+    }
+}
+
+/* Updates that a neighbour announces but that we do not keep, such as our
+   own prefixes sent back to us without split horizon.  The neighbour's
+   digest covers them, so ours must too, or their buckets never match. */
+struct ignored_update {
+    struct neighbour *neigh;
+    unsigned char id[8];
+    unsigned char *prefix;
+    uint16_t plen;
+    unsigned short seqno;
+    unsigned short metric;
+};
+
+static struct ignored_update *ignored = NULL;
+static int num_ignored = 0, max_ignored = 0;
+
+static int
+find_ignored(struct neighbour *neigh,
+             const unsigned char *prefix, uint16_t plen)
+{
+    int i;
+    for(i = 0; i < num_ignored; i++) {
+        if(ignored[i].neigh == neigh && ignored[i].plen == plen &&
+           memcmp(ignored[i].prefix, prefix, plen) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void
+forget_ignored(int i)
+{
+    free(ignored[i].prefix);
+    ignored[i] = ignored[--num_ignored];
+}
+
+/* Called after an update from neigh has been handed to update_route.
+   Remembers it if it left no route behind that carries it. */
+void
+digest_update_received(struct neighbour *neigh, const unsigned char *id,
+                       const unsigned char *prefix, uint16_t plen,
+                       unsigned short seqno, unsigned short metric,
+                       const unsigned char *nexthop)
+{
+    struct babel_route *route;
+    struct ignored_update *ign;
+    int i;
+
+    route = find_route(prefix, plen, zeroes, 0, neigh, nexthop);
+    i = find_ignored(neigh, prefix, plen);
+    if(metric >= INFINITY ||
+       (route && memcmp(route->src->id, id, 8) == 0 &&
+        route->seqno == seqno && route->refmetric == metric)) {
+        if(i >= 0)
+            forget_ignored(i);
+        return;
+    }
+
+    if(i < 0) {
+        if(num_ignored >= max_ignored) {
+            int n = max_ignored < 1 ? 8 : 2 * max_ignored;
+            ign = realloc(ignored, n * sizeof(struct ignored_update));
+            if(ign == NULL) {
+                perror("realloc(ignored)");
+                return;
+            }
+            ignored = ign;
+            max_ignored = n;
+        }
+        ign = &ignored[num_ignored];
+        ign->prefix = malloc(plen);
+        if(ign->prefix == NULL) {
+            perror("malloc(ignored)");
+            return;
+        }
+        memcpy(ign->prefix, prefix, plen);
+        ign->plen = plen;
+        ign->neigh = neigh;
+        num_ignored++;
+    } else {
+        ign = &ignored[i];
+    }
+    memcpy(ign->id, id, 8);
+    ign->seqno = seqno;
+    ign->metric = metric;
+}
+
+void
+digest_flush_neighbour(struct neighbour *neigh)
+{
+    int i = 0;
+    while(i < num_ignored) {
+        if(ignored[i].neigh == neigh)
+            forget_ignored(i);
+        else
+            i++;
+    }
+}
+
+/* Compare the digest received from neigh with the routes we hold from it.
+   Sets the bit of every differing bucket to ask for in mismatch, refreshes
+   the routes in the matching buckets, and returns the number of buckets
+   to ask for. */
+int
+check_neighbour_digest(struct neighbour *neigh,
+                       const struct route_digest *remote,
+                       unsigned char *mismatch)
+{
+    struct route_digest local;
+    struct route_stream *routes;
+    unsigned char held[DIGEST_MAX_BUCKETS / 8] = {0};
+    int i, n = 0;
+
+    local.nbuckets = remote->nbuckets;
+    memset(local.hash, 0, sizeof(local.hash));
+
+    routes = route_stream(ROUTE_ALL);
+    if(routes == NULL) {
+        fprintf(stderr, "Couldn't allocate route stream.\n");
+        return -1;
+    }
+    while(1) {
+        struct babel_route *route = route_stream_next(routes);
+        if(route == NULL)
+            break;
+        if(route->neigh != neigh || route->refmetric >= INFINITY)
+            continue;
+        local.hash[digest_bucket(route->src->prefix, route->src->plen,
+                                 local.nbuckets)] +=
+            digest_entry(route->src->id, route->src->prefix,
+                         route->src->plen, route->seqno, route->refmetric);
+    }
+    route_stream_done(routes);
+    for(i = 0; i < num_ignored; i++) {
+        if(ignored[i].neigh != neigh)
+            continue;
+        local.hash[digest_bucket(ignored[i].prefix, ignored[i].plen,
+                                 local.nbuckets)] +=
+            digest_entry(ignored[i].id, ignored[i].prefix, ignored[i].plen,
+                         ignored[i].seqno, ignored[i].metric);
+    }
+
+    /* A bucket asked for last time is not asked for again straight away,
+       so that one that never matches costs a resend every other digest
+       rather than every one.  That is still well within the hold time of
+       the routes it refreshes. */
+    if(neigh->digest_nbuckets != remote->nbuckets) {
+        memset(neigh->digest_requested, 0, sizeof(neigh->digest_requested));
+        neigh->digest_nbuckets = remote->nbuckets;
+    }
+    memset(mismatch, 0, remote->nbuckets / 8);
+    for(i = 0; i < remote->nbuckets; i++) {
+        unsigned char bit = 1 << (i % 8);
+        if(local.hash[i] == remote->hash[i]) {
+            neigh->digest_requested[i / 8] &= ~bit;
+        } else if(neigh->digest_requested[i / 8] & bit) {
+            neigh->digest_requested[i / 8] &= ~bit;
+            held[i / 8] |= bit;
+        } else {
+            neigh->digest_requested[i / 8] |= bit;
+            mismatch[i / 8] |= bit;
+            n++;
+        }
+    }
+
+    /* The resend of a requested bucket brings back whatever we still
+       ignore in it. */
+    i = 0;
+    while(i < num_ignored) {
+        unsigned int b;
+        if(ignored[i].neigh == neigh) {
+            b = digest_bucket(ignored[i].prefix, ignored[i].plen,
+                              local.nbuckets);
+            if(mismatch[b / 8] & (1 << (b % 8))) {
+                forget_ignored(i);
+                continue;
+            }
+        }
+        i++;
+    }
+
+    /* The neighbour still announces everything in a matching bucket
+       exactly as we hold it, which is as good as a fresh update. */
+    routes = route_stream(ROUTE_ALL);
+    if(routes == NULL) {
+        fprintf(stderr, "Couldn't allocate route stream.\n");
+        return n;
+    }
+    while(1) {
+        struct babel_route *route = route_stream_next(routes);
+        unsigned int b;
+        if(route == NULL)
+            break;
+        if(route->neigh != neigh || route->refmetric >= INFINITY)
+            continue;
+        b = digest_bucket(route->src->prefix, route->src->plen,
+                          local.nbuckets);
+        if(!(mismatch[b / 8] & (1 << (b % 8))) &&
+           !(held[b / 8] & (1 << (b % 8))))
+            route->time = now.tv_sec;
+    }
+    route_stream_done(routes);
+
+    return n;
+}
+
+/* Resend every prefix that falls into one of the requested buckets. */
+void
+send_digest_buckets(struct interface *ifp,
+                    const unsigned char *buckets, int nbuckets)
+{
+    struct xroute_stream *xroutes;
+    struct route_stream *routes;
+    unsigned int b;
+
+    if(!if_up(ifp))
+        return;
+
+    xroutes = xroute_stream();
+    if(xroutes) {
+        while(1) {
+            struct xroute *xroute = xroute_stream_next(xroutes);
+            if(xroute == NULL)
+                break;
+            b = digest_bucket(xroute->prefix, xroute->plen, nbuckets);
+            if(buckets[b / 8] & (1 << (b % 8)))
+                send_update(ifp, 0, xroute->prefix, xroute->plen,
+                            xroute->src_prefix, xroute->src_plen);
+        }
+        xroute_stream_done(xroutes);
+    } else {
+        fprintf(stderr, "Couldn't allocate xroute stream.\n");
+    }
+
+    routes = route_stream(ROUTE_INSTALLED);
+    if(routes) {
+        while(1) {
+            struct babel_route *route = route_stream_next(routes);
+            if(route == NULL)
+                break;
+            b = digest_bucket(route->src->prefix, route->src->plen, nbuckets);
+            if(buckets[b / 8] & (1 << (b % 8)))
+                send_update(ifp, 0, route->src->prefix, route->src->plen,
+                            route->src->src_prefix, route->src->src_plen);
+        }
+        route_stream_done(routes);
+    } else {
+        fprintf(stderr, "Couldn't allocate route stream.\n");
+    }
+}
+
+/* A neighbour that has never sent us a digest or a digest request
+   may not understand them, and still needs periodic full dumps. */
+int
+digest_needs_full_update(struct interface *ifp)
+{
+    struct neighbour *neigh;
+    FOR_ALL_NEIGHBOURS(neigh) {
+        if(neigh->ifp == ifp && !neigh->digest)
+            return 1;
+    }
+    return 0;
+}
+
+#endif //----- ADD -----
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * digest.h
+ */
+
+#ifndef __DIGEST_HEADER__
+#define __DIGEST_HEADER__
+
+/* Number of buckets we put in a digest.  Must be a power of two no larger
+   than DIGEST_MAX_BUCKETS; it is halved on interfaces whose packets are too
+   small for the digest TLV (3 + 4 * buckets bytes, plus its header). */
+#define DIGEST_BUCKETS 128
+#define DIGEST_MIN_BUCKETS 8
+#define DIGEST_MAX_BUCKETS 256
+
+struct route_digest {
+    int nbuckets;
+    unsigned int hash[DIGEST_MAX_BUCKETS];
+};
+
+/* Replace periodic full dumps by a digest of the advertised table. */
+extern int delta_updates;
+
+unsigned int digest_bucket(const unsigned char *prefix, uint16_t plen,
+                           int nbuckets);
+int digest_buckets(int size);
+void digest_interface(struct interface *ifp, struct route_digest *digest,
+                      int nbuckets);
+void digest_update_received(struct neighbour *neigh, const unsigned char *id,
+                            const unsigned char *prefix, uint16_t plen,
+                            unsigned short seqno, unsigned short metric,
+                            const unsigned char *nexthop);
+void digest_flush_neighbour(struct neighbour *neigh);
+int check_neighbour_digest(struct neighbour *neigh,
+                           const struct route_digest *remote,
+                           unsigned char *mismatch);
+void send_digest_buckets(struct interface *ifp,
+                         const unsigned char *buckets, int nbuckets);
+int digest_needs_full_update(struct interface *ifp);
+
+#endif
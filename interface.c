@@ -71,6 +71,9 @@ THE SOFTWARE.
 #include "configuration.h"
 #include "local.h"
 #include "xroute.h"
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+#include "compress.h"
+#endif //----- ADD for PACKET COMPRESSION -----
 
 #define MIN_MTU 512
 
@@ -394,7 +397,18 @@ interface_updown(struct interface *ifp, int up)
 
         /* 40 for IPv6 header, 8 for UDP header, 12 for good luck. */
         ifp->buf.size = mtu - sizeof(packet_header) - 60;
+#ifdef BABELD_CODE //+++++ REPLACE +++++
         ifp->buf.buf = malloc(ifp->buf.size);
+#else // CEFBABELD
+        ifp->buf.len = 0;
+        ifp->buf.compress = -1;
+        ifp->buf.capacity = packet_compression ?
+            MIN(ifp->buf.size * PACKET_COMPRESSION_RATIO, 0xFFFF) :
+            ifp->buf.size;
+        compressor_free(ifp->buf.zc);
+        ifp->buf.zc = NULL;
+        ifp->buf.buf = malloc(ifp->buf.capacity);
+#endif //----- REPLACE -----
         if(ifp->buf.buf == NULL) {
             fprintf(stderr, "Couldn't allocate sendbuf.\n");
             ifp->buf.size = 0;
@@ -556,6 +570,13 @@ interface_updown(struct interface *ifp, int up)
         flush_interface_routes(ifp, 0);
         ifp->buf.len = 0;
         ifp->buf.size = 0;
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+        discard_requests(&ifp->buf);
+#endif //----- ADD for REQUEST AGGREGATION -----
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+        compressor_free(ifp->buf.zc);
+        ifp->buf.zc = NULL;
+#endif //----- ADD for PACKET COMPRESSION -----
         free(ifp->buf.buf);
         ifp->num_buffered_updates = 0;
         ifp->update_bufsize = 0;
@@ -66,6 +66,21 @@ struct buffered_update {
     unsigned char pad[2];
 };
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+#define BUFFERED_REQUEST 0
+#define BUFFERED_MH_REQUEST 1
+
+/* A route request waiting to be sent in the next flush of a buffer. */
+struct buffered_request {
+    unsigned char type;
+    unsigned char hop_count;
+    uint16_t plen;
+    unsigned short seqno;
+    unsigned char id[8];
+    unsigned char *prefix;
+};
+#endif //----- ADD for REQUEST AGGREGATION -----
+
 #define IF_TYPE_DEFAULT 0
 #define IF_TYPE_WIRED 1
 #define IF_TYPE_WIRELESS 2
@@ -134,6 +149,26 @@ struct buffered {
     unsigned char id[8];
     unsigned char nh[4];
     unsigned char prefix[16];
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+    /* Default name that the next compressed Update is relative to. */
+    char have_name;
+    uint16_t name_len;
+    unsigned char name[NAME_PREFIX_LEN];
+#endif //----- ADD for NAME COMPRESSION -----
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+    struct buffered_request *requests;
+    int num_requests;
+    int request_bufsize;
+#endif //----- ADD for REQUEST AGGREGATION -----
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+    /* Allocated size of buf, larger than size when we may compress. */
+    int capacity;
+    /* Whether the packet being built is compressed, or -1 if undecided. */
+    int compress;
+    /* Bytes of Hello and IHU, which are sent uncompressed. */
+    int plain_len;
+    struct compressor *zc;
+#endif //----- ADD for PACKET COMPRESSION -----
     /* Relative position of the Hello message in the send buffer, or
        (-1) if there is none. */
     int hello;
@@ -158,6 +193,15 @@ struct interface {
     unsigned char *specified_ipv6;
 #endif //----- ADD -----
     struct buffered buf;
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+    /* Token bucket bounding the rate of requests sent on this interface. */
+    int request_tokens;
+    struct timeval request_refill;
+#endif //----- ADD for REQUEST LIMIT -----
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+    unsigned long long rx_packets, rx_bytes;
+    unsigned long long tx_packets, tx_bytes;
+#endif //----- ADD for COUNTERS -----
     struct buffered_update *buffered_updates;
     int num_buffered_updates;
     int update_bufsize;
@@ -0,0 +1,99 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * latency.c
+ *
+ * Latency histograms of FIB requests and of the phases of the main loop.
+ * An operation is timed with the monotonic clock between latency_start and
+ * latency_record, which costs two clock_gettime calls (served by the vDSO)
+ * when the histograms are enabled, and nothing when they are not.  That is
+ * about 100 ns per operation, or some 0.5% of the CPU time spent on each
+ * received update packet.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "latency.h"
+#include "cefore.h"
+
+int latency_histograms = 0;
+struct latency_hist latency_hists[CefC_Lat_Num];
+
+void
+latency_start(struct timespec *start)
+{
+    if(!latency_histograms) {
+        start->tv_nsec = -1;
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+void
+latency_record(int op, const struct timespec *start)
+{
+    struct timespec end;
+
+    if(start->tv_nsec < 0)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    latency_add(op,
+                (unsigned long long)(end.tv_sec - start->tv_sec) * 1000000000ULL +
+                end.tv_nsec - start->tv_nsec);
+}
+
+/* Record a delay measured by the caller. */
+void
+latency_add(int op, unsigned long long ns)
+{
+    struct latency_hist *hist = &latency_hists[op];
+    unsigned long long us;
+    int b;
+
+    b = 0;
+    for(us = ns / 1000; us > 0 && b < LATENCY_BUCKETS - 1; us >>= 1)
+        b++;
+
+    hist->count++;
+    hist->sum_ns += ns;
+    if(ns > hist->max_ns)
+        hist->max_ns = ns;
+    hist->bucket[b]++;
+}
+
+void
+latency_reset(void)
+{
+    memset(latency_hists, 0, sizeof(struct latency_hist) * CefC_Lat_Num);
+}
+
+#endif //----- ADD -----
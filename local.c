@@ -67,6 +67,10 @@ THE SOFTWARE.
 #include "util.h"
 #include "configuration.h"
 #include "local.h"
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+#include <sys/select.h>
+#include "watch.h"
+#endif //----- ADD for WATCH -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
 #include "version.h"
 #else //CEFBAELD
@@ -84,6 +88,7 @@ char *local_server_path = NULL;
 #endif //----- REPLACE -----
 int local_server_write = 0;
 
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
 static int
 write_timeout(int fd, const void *buf, int len)
 {
@@ -114,6 +119,59 @@ write_timeout(int fd, const void *buf, int len)
         return -1;
     }
 }
+#else // CEFBABELD
+/* Where a dump has got to.  The key of the last entry dumped is kept
+   rather than a position, since the tables may change between chunks. */
+struct local_dump {
+    int stage;                  /* LOCAL_DUMP_* */
+    int started;                /* a key has been recorded */
+    unsigned char prefix[NAME_PREFIX_LEN];
+    uint16_t plen;
+    unsigned char src_prefix[16];
+    unsigned char src_plen;
+};
+
+#define LOCAL_DUMP_XROUTES 0
+#define LOCAL_DUMP_ROUTES 1
+
+/* Output goes to a queue, which local_flush writes out when the socket
+   is writable, so that a slow client never holds up the daemon. */
+static int
+local_write(struct local_socket *s, const void *buf, int len)
+{
+    if(s->out_len + len > LOCAL_OUT_MAX) {
+        free(s->out);
+        s->out = NULL;
+        s->out_start = s->out_len = s->out_size = 0;
+        free(s->dump);
+        s->dump = NULL;
+        errno = ENOSPC;
+        return -1;
+    }
+
+    if(s->out_start + s->out_len + len > s->out_size) {
+        if(s->out_start > 0) {
+            memmove(s->out, s->out + s->out_start, s->out_len);
+            s->out_start = 0;
+        }
+        if(s->out_len + len > s->out_size) {
+            int n = MAX(s->out_size, LOCAL_BUFSIZE);
+            char *new_out;
+            while(n < s->out_len + len)
+                n *= 2;
+            new_out = realloc(s->out, MIN(n, LOCAL_OUT_MAX));
+            if(new_out == NULL)
+                return -1;
+            s->out = new_out;
+            s->out_size = MIN(n, LOCAL_OUT_MAX);
+        }
+    }
+
+    memcpy(s->out + s->out_start + s->out_len, buf, len);
+    s->out_len += len;
+    return 1;
+}
+#endif //----- REPLACE for LOCAL QUEUE -----
 
 static const char *
 local_kind(int kind)
@@ -153,7 +211,11 @@ local_notify_interface_1(struct local_socket *s,
     if(rc < 0 || rc >= 512)
         goto fail;
 
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
     rc = write_timeout(s->fd, buf, rc);
+#else // CEFBABELD
+    rc = local_write(s, buf, rc);
+#endif //----- REPLACE for LOCAL QUEUE -----
     if(rc < 0)
         goto fail;
     return;
@@ -171,6 +233,9 @@ local_notify_interface(struct interface *ifp, int kind)
         if(local_sockets[i].monitor)
             local_notify_interface_1(&local_sockets[i], ifp, kind);
     }
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+    watch_interface(ifp, kind);
+#endif //----- ADD for WATCH -----
 }
 
 static void
@@ -208,7 +273,11 @@ local_notify_neighbour_1(struct local_socket *s,
     if(rc < 0 || rc >= 512)
         goto fail;
 
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
     rc = write_timeout(s->fd, buf, rc);
+#else // CEFBABELD
+    rc = local_write(s, buf, rc);
+#endif //----- REPLACE for LOCAL QUEUE -----
     if(rc < 0)
         goto fail;
     return;
@@ -226,6 +295,9 @@ local_notify_neighbour(struct neighbour *neigh, int kind)
         if(local_sockets[i].monitor)
             local_notify_neighbour_1(&local_sockets[i], neigh, kind);
     }
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+    watch_neighbour(neigh, kind);
+#endif //----- ADD for WATCH -----
 }
 
 static void
@@ -245,7 +317,11 @@ local_notify_xroute_1(struct local_socket *s, struct xroute *xroute, int kind)
     if(rc < 0 || rc >= 512)
         goto fail;
 
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
     rc = write_timeout(s->fd, buf, rc);
+#else // CEFBABELD
+    rc = local_write(s, buf, rc);
+#endif //----- REPLACE for LOCAL QUEUE -----
     if(rc < 0)
         goto fail;
     return;
@@ -263,6 +339,9 @@ local_notify_xroute(struct xroute *xroute, int kind)
         if(local_sockets[i].monitor)
             local_notify_xroute_1(&local_sockets[i], xroute, kind);
     }
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+    watch_xroute(xroute, kind);
+#endif //----- ADD for WATCH -----
 }
 
 static void
@@ -290,7 +369,11 @@ local_notify_route_1(struct local_socket *s, struct babel_route *route, int kind
     if(rc < 0 || rc >= 512)
         goto fail;
 
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
     rc = write_timeout(s->fd, buf, rc);
+#else // CEFBABELD
+    rc = local_write(s, buf, rc);
+#endif //----- REPLACE for LOCAL QUEUE -----
     if(rc < 0)
         goto fail;
     return;
@@ -308,8 +391,12 @@ local_notify_route(struct babel_route *route, int kind)
         if(local_sockets[i].monitor)
             local_notify_route_1(&local_sockets[i], route, kind);
     }
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+    watch_route(route, kind);
+#endif //----- ADD for WATCH -----
 }
 
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
 static void
 local_notify_all_1(struct local_socket *s)
 {
@@ -427,6 +514,228 @@ local_read(struct local_socket *s)
     shutdown(s->fd, 1);
     return -1;
 }
+#else // CEFBABELD
+static int local_parse(struct local_socket *s);
+
+/* Interfaces and neighbours are few and go out at once; the exported and
+   learned routes follow a chunk at a time, from local_flush. */
+static int
+local_dump_start(struct local_socket *s)
+{
+    struct interface *ifp;
+    struct neighbour *neigh;
+
+    s->dump = calloc(1, sizeof(struct local_dump));
+    if(s->dump == NULL)
+        return -1;
+
+    FOR_ALL_INTERFACES(ifp) {
+        local_notify_interface_1(s, ifp, LOCAL_ADD);
+    }
+
+    FOR_ALL_NEIGHBOURS(neigh) {
+        local_notify_neighbour_1(s, neigh, LOCAL_ADD);
+    }
+
+    /* The dump is dropped if the queue overflowed. */
+    return s->dump ? 1 : -1;
+}
+
+static void
+local_dump_key(struct local_dump *d,
+               const unsigned char *prefix, uint16_t plen,
+               const unsigned char *src_prefix, unsigned char src_plen)
+{
+    memcpy(d->prefix, prefix, sizeof(d->prefix));
+    d->plen = plen;
+    memcpy(d->src_prefix, src_prefix, sizeof(d->src_prefix));
+    d->src_plen = src_plen;
+    d->started = 1;
+}
+
+/* Queue the next chunk of a dump, and the final ok once it is over. */
+static int
+local_dump_step(struct local_socket *s)
+{
+    struct local_dump *d = s->dump;
+    int rc;
+
+    while(s->out_len < LOCAL_DUMP_CHUNK) {
+        if(d->stage == LOCAL_DUMP_XROUTES) {
+            struct xroute *xroute =
+                xroute_after(d->started ? d->prefix : NULL, d->plen,
+                             d->src_prefix, d->src_plen);
+            if(xroute == NULL) {
+                d->stage = LOCAL_DUMP_ROUTES;
+                d->started = 0;
+                continue;
+            }
+            local_dump_key(d, xroute->prefix, xroute->plen,
+                           xroute->src_prefix, xroute->src_plen);
+            local_notify_xroute_1(s, xroute, LOCAL_ADD);
+        } else {
+            struct babel_route *route =
+                route_slot_after(d->started ? d->prefix : NULL, d->plen,
+                                 d->src_prefix, d->src_plen);
+            if(route == NULL) {
+                free(d);
+                s->dump = NULL;
+                rc = local_write(s, "ok\n", 3);
+                if(rc < 0) {
+                    shutdown(s->fd, 1);
+                    return -1;
+                }
+                /* Commands received during the dump. */
+                return local_parse(s);
+            }
+            local_dump_key(d, route->src->prefix, route->src->plen,
+                           route->src->src_prefix, route->src->src_plen);
+            for(; route; route = route->next) {
+                local_notify_route_1(s, route, LOCAL_ADD);
+                if(s->dump == NULL)
+                    break;
+            }
+        }
+        if(s->dump == NULL)
+            return -1;
+    }
+    return 1;
+}
+
+/* Carry out the commands received so far.  Commands wait while a dump is
+   in progress, so that the replies stay in order. */
+static int
+local_parse(struct local_socket *s)
+{
+    int rc, n;
+    char *eol;
+    char reply[100];
+    const char *message;
+
+    while(s->n > 0 && s->dump == NULL) {
+        eol = memchr(s->buf, '\n', s->n);
+        if(eol == NULL)
+            break;
+        n = eol + 1 - s->buf;
+
+        strcpy(reply, "ok\n");
+        message = NULL;
+        rc = parse_config_from_string(s->buf, n, &message);
+        switch(rc) {
+        case CONFIG_ACTION_DONE:
+            break;
+        case CONFIG_ACTION_QUIT:
+            s->quit = 1;
+            reply[0] = '\0';
+            break;
+        case CONFIG_ACTION_DUMP:
+            /* ok comes at the end of the dump */
+            if(local_dump_start(s) < 0)
+                goto fail;
+            reply[0] = '\0';
+            break;
+        case CONFIG_ACTION_MONITOR:
+            if(local_dump_start(s) < 0)
+                goto fail;
+            s->monitor = 1;
+            reply[0] = '\0';
+            break;
+        case CONFIG_ACTION_UNMONITOR:
+            s->monitor = 0;
+            break;
+        case CONFIG_ACTION_NO:
+            snprintf(reply, sizeof(reply), "no%s%s\n",
+                     message ? " " : "", message ? message : "");
+            break;
+        default:
+            snprintf(reply, sizeof(reply), "bad\n");
+        }
+
+        if(reply[0] != '\0') {
+            rc = local_write(s, reply, strlen(reply));
+            if(rc < 0) {
+                goto fail;
+            }
+        }
+        if(s->n > n)
+            memmove(s->buf, s->buf + n, s->n - n);
+        s->n -= n;
+    }
+
+    if(s->n == 0) {
+        free(s->buf);
+        s->buf = NULL;
+    }
+
+    if(s->quit && s->out_len == 0 && s->dump == NULL)
+        shutdown(s->fd, 1);
+    return 1;
+
+ fail:
+    shutdown(s->fd, 1);
+    return -1;
+}
+
+int
+local_read(struct local_socket *s)
+{
+    int rc;
+
+    if(s->buf == NULL)
+        s->buf = malloc(LOCAL_BUFSIZE);
+    if(s->buf == NULL)
+        return -1;
+
+    if(s->n >= LOCAL_BUFSIZE) {
+        errno = ENOSPC;
+        goto fail;
+    }
+
+    rc = read(s->fd, s->buf + s->n, LOCAL_BUFSIZE - s->n);
+    if(rc <= 0)
+        return rc;
+    s->n += rc;
+
+    return local_parse(s);
+
+ fail:
+    shutdown(s->fd, 1);
+    return -1;
+}
+
+/* Called when the socket is writable: write out what is queued, after
+   adding the next chunk of a dump in progress.  Returns -1 if the client
+   is gone. */
+int
+local_flush(struct local_socket *s)
+{
+    int rc;
+
+    if(s->dump && s->out_len < LOCAL_DUMP_CHUNK) {
+        rc = local_dump_step(s);
+        if(rc < 0)
+            return -1;
+    }
+
+    while(s->out_len > 0) {
+        rc = write(s->fd, s->out + s->out_start, s->out_len);
+        if(rc < 0) {
+            if(errno == EAGAIN || errno == EINTR)
+                return 1;
+            return -1;
+        }
+        s->out_start += rc;
+        s->out_len -= rc;
+    }
+
+    free(s->out);
+    s->out = NULL;
+    s->out_start = s->out_size = 0;
+    if(s->quit && s->dump == NULL)
+        shutdown(s->fd, 1);
+    return 1;
+}
+#endif //----- REPLACE for LOCAL QUEUE -----
 
 int
 local_header(struct local_socket *s)
@@ -447,7 +756,11 @@ local_header(struct local_socket *s)
 #endif  //----- REPLACE -----
     if(rc < 0 || rc >= 512)
         goto fail;
+#ifdef BABELD_CODE //+++++ REPLACE for LOCAL QUEUE +++++
     rc = write_timeout(s->fd, buf, rc);
+#else // CEFBABELD
+    rc = local_write(s, buf, rc);
+#endif //----- REPLACE for LOCAL QUEUE -----
     if(rc < 0)
         goto fail;
 
@@ -480,6 +793,10 @@ local_socket_destroy(int i)
     }
 
     free(local_sockets[i].buf);
+#ifndef BABELD_CODE //+++++ ADD for LOCAL QUEUE +++++
+    free(local_sockets[i].out);
+    free(local_sockets[i].dump);
+#endif //----- ADD for LOCAL QUEUE -----
     close(local_sockets[i].fd);
     local_sockets[i] = local_sockets[--num_local_sockets];
     VALGRIND_MAKE_MEM_UNDEFINED(local_sockets + num_local_sockets,
@@ -34,11 +34,27 @@ struct xroute;
 
 #define LOCAL_BUFSIZE 1024
 
+#ifndef BABELD_CODE //+++++ ADD for LOCAL QUEUE +++++
+/* Output queued for a client at most; a client that lets more pile up
+   is disconnected. */
+#define LOCAL_OUT_MAX (1024 * 1024)
+/* A dump is generated a chunk at a time, whenever less is queued. */
+#define LOCAL_DUMP_CHUNK (16 * 1024)
+
+struct local_dump;
+#endif //----- ADD for LOCAL QUEUE -----
+
 struct local_socket {
     int fd;
     char *buf;
     int n;
     int monitor;
+#ifndef BABELD_CODE //+++++ ADD for LOCAL QUEUE +++++
+    char *out;                  /* output not written yet */
+    int out_start, out_len, out_size;
+    struct local_dump *dump;    /* dump in progress, or NULL */
+    int quit;                   /* shut down once the output is written */
+#endif //----- ADD for LOCAL QUEUE -----
 };
 
 extern int local_server_socket;
@@ -52,6 +68,9 @@ void local_notify_neighbour(struct neighbour *neigh, int kind);
 void local_notify_xroute(struct xroute *xroute, int kind);
 void local_notify_route(struct babel_route *route, int kind);
 int local_read(struct local_socket *s);
+#ifndef BABELD_CODE //+++++ ADD for LOCAL QUEUE +++++
+int local_flush(struct local_socket *s);
+#endif //----- ADD for LOCAL QUEUE -----
 int local_header(struct local_socket *s);
 struct local_socket *local_socket_create(int fd);
 void local_socket_destroy(int i);
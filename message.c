@@ -69,6 +69,28 @@ THE SOFTWARE.
 #include "resend.h"
 #include "message.h"
 #include "configuration.h"
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+#include "digest.h"
+#endif //----- ADD for DIGEST -----
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+#include "compress.h"
+#endif //----- ADD for PACKET COMPRESSION -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+#include "damping.h"
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+#include "cefore.h"
+#endif //----- ADD for COUNTERS -----
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+#include <time.h>
+#include "latency.h"
+#endif //----- ADD for LATENCY -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+#include "convergence.h"
+#endif //----- ADD for CONVERGENCE -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+#include "trace.h"
+#endif //----- ADD for TRACE -----
 
 unsigned char packet_header[4] = {42, 2};
 
@@ -234,14 +256,24 @@ parse_update_subtlv(struct interface *ifp, int metric, int ae,
 #endif //----- DEL -----
 
 static int
+#ifdef BABELD_CODE //+++++ REPLACE +++++
 parse_hello_subtlv(const unsigned char *a, int alen,
                    unsigned int *timestamp_return, int *have_timestamp_return)
+#else // CEFBABELD
+parse_hello_subtlv(const unsigned char *a, int alen,
+                   unsigned int *timestamp_return, int *have_timestamp_return,
+                   unsigned short *caps_return)
+#endif //----- REPLACE -----
 {
     int type, len, i = 0, have_timestamp = 0;
     unsigned int timestamp = 0;
 
     while(i < alen) {
+#ifdef BABELD_CODE //+++++ REPLACE +++++
         type = a[0];
+#else // CEFBABELD
+        type = a[i];
+#endif //----- REPLACE -----
         if(type == SUBTLV_PAD1) {
             i++;
             continue;
@@ -268,6 +300,11 @@ parse_hello_subtlv(const unsigned char *a, int alen,
                         "Received incorrect RTT sub-TLV on Hello.\n");
                 /* But don't break. */
             }
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+        } else if(type == SUBTLV_CAPABILITIES) {
+            if(len >= 2 && caps_return)
+                DO_NTOHS(*caps_return, a + i + 2);
+#endif //----- ADD for NAME COMPRESSION -----
         } else {
             debugf("Received unknown%s Hello sub-TLV %d.\n",
                    (type & 0x80) != 0 ? " mandatory" : "", type);
@@ -489,6 +526,70 @@ network_address(int ae, const unsigned char *a, unsigned int len,
     return network_prefix(ae, -1, 0, a, NULL, len, a_r);
 }
 
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+static unsigned char expanded_packet[4 + 0xFFFF];
+
+static int
+has_compressed_message(const unsigned char *packet, int bodylen)
+{
+    int i = 0;
+    uint16_t length;
+
+    while(i + 3 <= bodylen) {
+        if(packet[4 + i] == MESSAGE_PAD1) {
+            i++;
+            continue;
+        }
+        if(packet[4 + i] == MESSAGE_COMPRESSED)
+            return 1;
+        DO_NTOHS(length, packet + 4 + i + 1);
+        i += length + 3;
+    }
+    return 0;
+}
+
+/* Copy a packet to expanded_packet, replacing every Compressed TLV by
+   the messages it contains.  Returns the new body length, or -1. */
+static int
+expand_packet(const unsigned char *packet, int bodylen)
+{
+    const unsigned char *message;
+    int i = 0, len = 0, rc;
+    uint16_t length, raw;
+
+    memcpy(expanded_packet, packet, 4);
+    while(i < bodylen) {
+        message = packet + 4 + i;
+        if(message[0] == MESSAGE_PAD1) {
+            i++;
+            continue;
+        }
+        if(i + 3 > bodylen)
+            return -1;
+        DO_NTOHS(length, message + 1);
+        if(i + length + 3 > bodylen)
+            return -1;
+        if(message[0] == MESSAGE_COMPRESSED) {
+            if(length < 3)
+                return -1;
+            DO_NTOHS(raw, message + 4);
+            rc = decompress_block(message + 6, length - 3,
+                                  expanded_packet + 4 + len, 0xFFFF - len);
+            if(rc != raw)
+                return -1;
+            len += rc;
+        } else {
+            if(len + length + 3 > 0xFFFF)
+                return -1;
+            memcpy(expanded_packet + 4 + len, message, length + 3);
+            len += length + 3;
+        }
+        i += length + 3;
+    }
+    return len;
+}
+#endif //----- ADD for PACKET COMPRESSION -----
+
 void
 parse_packet(const unsigned char *from, struct interface *ifp,
              const unsigned char *packet, int packetlen)
@@ -518,11 +619,20 @@ parse_packet(const unsigned char *from, struct interface *ifp,
 #ifndef BABELD_CODE //+++++ ADD +++++
     uint16_t    length, plength;
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+    unsigned char default_name[NAME_PREFIX_LEN];
+    uint16_t default_name_len = 0;
+    int have_default_name = 0;
+#endif //----- ADD for NAME COMPRESSION -----
 
     if((ifp->flags & IF_TIMESTAMPS) != 0) {
         /* We want to track exactly when we received this packet. */
         gettime(&now);
     }
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+    ifp->rx_packets++;
+    ifp->rx_bytes += packetlen;
+#endif //----- ADD for COUNTERS -----
 
     if(!linklocal(from)) {
         fprintf(stderr, "Received packet from non-local address %s.\n",
@@ -557,10 +667,26 @@ parse_packet(const unsigned char *from, struct interface *ifp,
         return;
     }
 
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+    if(has_compressed_message(packet, bodylen)) {
+        int rc = expand_packet(packet, bodylen);
+        if(rc < 0) {
+            fprintf(stderr, "Received malformed compressed packet on %s "
+                    "from %s.\n", ifp->name, format_address(from));
+            return;
+        }
+        packet = expanded_packet;
+        bodylen = rc;
+    }
+#endif //----- ADD for PACKET COMPRESSION -----
+
     i = 0;
     while(i < bodylen) {
         message = packet + 4 + i;
         type = message[0];
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+        cefstat.tlv_rcvd[MIN(type, CEFSTAT_TLV_TYPES - 1)]++;
+#endif //----- ADD for COUNTERS -----
         if(type == MESSAGE_PAD1) {
             debugf("Received pad1 from %s on %s.\n",
                    format_address(from), ifp->name);
@@ -576,11 +702,14 @@ parse_packet(const unsigned char *from, struct interface *ifp,
         if(i + len + 2 > bodylen) {
 #else // CEFBABELD
         DO_NTOHS(length, message + 1);
-        if(i + length + 2  > bodylen) {
+        if(i + length + 3 > bodylen) {
 #endif //----- REPLACE -----
             fprintf(stderr, "Received truncated message.\n");
             break;
         }
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+        USDT_PROBE3(tlv, type, length, ifp->ifindex);
+#endif //----- ADD for USDT -----
 
         if(type == MESSAGE_PADN) {
 #ifdef BABELD_CODE //+++++ REPLACE +++++
@@ -705,10 +834,13 @@ fprintf(stderr, ">>>>> Received HELLO\n");
             }
 #else // CEFBABELD
             /* Sub-TLV handling. */
+            neigh->caps = 0;
+            neigh->caps_flag = !!(message[3] & HELLO_FLAG_CAPABILITIES);
             if(length > 8) {
                 int rc;
                 rc = parse_hello_subtlv(message + 8, length - 5,
-                                        &timestamp, &have_timestamp);
+                                        &timestamp, &have_timestamp,
+                                        &neigh->caps);
                 if(rc >= 0 && have_timestamp) {
                     neigh->hello_send_us = timestamp;
                     neigh->hello_rtt_receive_time = now;
@@ -922,6 +1054,17 @@ fprintf(stderr, ">>>>> Received NH (%s) port:%d [%d] from %s on %s.\n",
                 +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
                 /
                 +-+-+-+-+-+-+-+-+-+-+-+-
+
+                With UPDATE_FLAG_OMIT, MBZ2 carries the fragment tag (if
+                UPDATE_FLAG_FRAGMENTED) and the name is preceded by the
+                number of leading bytes taken from the default name or from
+                the reassembled fragments:
+
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |             Metric            |             Omit              |
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |   Rest of Name Prefix...
+                +-+-+-+-+-+-+-+-+-+-+-+-
             */
 #endif //----- ADD -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
@@ -975,10 +1118,50 @@ fprintf(stderr, ">>>>> Received NH (%s) port:%d [%d] from %s on %s.\n",
             DO_NTOHS(seqno, message + 10);
             DO_NTOHS(metric, message + 12);
             DO_NTOHS(plength, message + 5);
-           
-            if(plength > 0) {
+            if(plength > NAME_PREFIX_LEN) {
+                goto fail;
+            }
+
+            if(message[4] & UPDATE_FLAG_OMIT) {
+                uint16_t omit;
+                if(length < 13) {
+                    goto fail;
+                }
+                DO_NTOHS(omit, message + 14);
+                if(omit > plength || length < 13 + plength - omit) {
+                    goto fail;
+                }
+                if(message[4] & UPDATE_FLAG_FRAGMENTED) {
+                    if(neigh->frag_name == NULL ||
+                       neigh->frag_tag != message[7] ||
+                       neigh->frag_plen != plength ||
+                       neigh->frag_len < omit) {
+                        fprintf(stderr,
+                                "Received update with incomplete name "
+                                "from %s on %s.\n",
+                                format_address(from), ifp->name);
+                        goto done;
+                    }
+                    memcpy(prefix, neigh->frag_name, omit);
+                    neigh->frag_plen = 0;
+                } else {
+                    if(!have_default_name || omit > default_name_len) {
+                        goto fail;
+                    }
+                    memcpy(prefix, default_name, omit);
+                }
+                memcpy(prefix + omit, message + 16, plength - omit);
+            } else if(plength > 0) {
+                if(length < 11 + plength) {
+                    goto fail;
+                }
                 cefore_prefix (plength, message + 14, prefix);
             }
+            if(message[4] & UPDATE_FLAG_DEFAULT_NAME) {
+                memcpy(default_name, prefix, plength);
+                default_name_len = plength;
+                have_default_name = 1;
+            }
 #endif //----- REPLACE -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
             plen = message[4] + (message[2] == 1 ? 96 : 0);
@@ -1083,6 +1266,13 @@ fprintf(stderr, ">>>>> Received UPDATE for %s (plen=%u seqno=%u, metric=%u) from
             }
             memcpy(src_prefix, zeroes, 16);
             src_plen = 0;
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+            convergence_start(prefix, plen);
+#endif //----- ADD for CONVERGENCE -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+            trace_prefix(CefC_Trace_Update, prefix, plen, neigh->address,
+                         ifp->ifindex, seqno, metric, interval, 0);
+#endif //----- ADD for TRACE -----
             
             if (route_ctrl_type == ROUTE_CTRL_TYPE_MS) {
                  update_route_mpss(router_id, prefix, plen, src_prefix, src_plen, seqno,
@@ -1097,6 +1287,11 @@ fprintf(stderr, ">>>>> Received UPDATE for %s (plen=%u seqno=%u, metric=%u) from
                                metric, interval, neigh, nh, nh_port, 
                                channels, channels_len);
             }   
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+            if(neigh->digest)
+                digest_update_received(neigh, router_id, prefix, plen,
+                                       seqno, metric, nh);
+#endif //----- ADD for DIGEST -----
 #endif //----- REPLACE -----
 
         } else if(type == MESSAGE_REQUEST) {
@@ -1292,6 +1487,148 @@ fprintf(stderr, ">>>>> Received seq-request (%d) for %s from %s on %s (%s, %d).\
 #endif   //----- for DEB -----
             handle_request(neigh, prefix, plen, src_prefix, src_plen,
                            message[8], seqno, message + 12);
+        } else if(type == MESSAGE_NAME_FRAG) {
+            /*
+                0                   1                   2                   3
+                0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |   Type = 13   |            Length             |      Tag      |
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |              Plen             |            Offset             |
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |   Name Fragment...
+                +-+-+-+-+-+-+-+-+-+-+-+-
+            */
+            uint16_t fplen, offset;
+            int flen;
+
+            if(length < 5) {
+                goto fail;
+            }
+            DO_NTOHS(fplen, message + 4);
+            DO_NTOHS(offset, message + 6);
+            flen = length - 5;
+            if(fplen > NAME_PREFIX_LEN || offset + flen > fplen) {
+                goto fail;
+            }
+            if(neigh->frag_name == NULL) {
+                neigh->frag_name = malloc(NAME_PREFIX_LEN);
+                if(neigh->frag_name == NULL) {
+                    perror("malloc(frag_name)");
+                    goto done;
+                }
+            }
+            if(offset == 0) {
+                neigh->frag_tag = message[3];
+                neigh->frag_plen = fplen;
+                neigh->frag_len = 0;
+            }
+            if(neigh->frag_tag != message[3] || neigh->frag_plen != fplen ||
+               neigh->frag_len != offset) {
+                debugf("Received out of order name fragment from %s on %s.\n",
+                       format_address(from), ifp->name);
+                neigh->frag_plen = 0;
+                goto done;
+            }
+            memcpy(neigh->frag_name + offset, message + 8, flen);
+            neigh->frag_len += flen;
+        } else if(type == MESSAGE_MULTI_REQUEST ||
+                  type == MESSAGE_MULTI_MH_REQUEST) {
+            /* See send_multi_request for the layout. */
+            int mh = type == MESSAGE_MULTI_MH_REQUEST;
+            int count, j, pos;
+
+            if(length < 3) {
+                goto fail;
+            }
+            DO_NTOHS(count, message + 4);
+            debugf("Received %d %s from %s on %s.\n", count,
+                   mh ? "seq-requests" : "requests",
+                   format_address(from), ifp->name);
+            /* Validate the whole TLV before acting on any of it. */
+            pos = 6;
+            for(j = 0; j < count; j++) {
+                if(pos + (mh ? 14 : 2) > length + 3)
+                    goto fail;
+                DO_NTOHS(plength, message + pos);
+                pos += (mh ? 14 : 2) + plength;
+                if(plength == 0 || plength > NAME_PREFIX_LEN ||
+                   pos > length + 3)
+                    goto fail;
+            }
+            pos = 6;
+            for(j = 0; j < count; j++) {
+                DO_NTOHS(plength, message + pos);
+                if(mh) {
+                    unsigned short seqno;
+                    DO_NTOHS(seqno, message + pos + 2);
+                    handle_request(neigh, message + pos + 14, plength,
+                                   zeroes, 0, message[pos + 4], seqno,
+                                   message + pos + 6);
+                    pos += 14 + plength;
+                } else {
+                    send_update(neigh->ifp, 0, message + pos + 2, plength,
+                                zeroes, 0);
+                    pos += 2 + plength;
+                }
+            }
+        } else if(type == MESSAGE_DIGEST) {
+            /*
+                0                   1                   2                   3
+                0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |   Type = 11   |            Length             |    Rserved    |
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |            Buckets            |        Bucket Hash[0]...      /
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+            */
+            struct route_digest digest;
+            unsigned char mismatch[DIGEST_MAX_BUCKETS / 8];
+            int j, rc;
+
+            if(length < 3) {
+                goto fail;
+            }
+            DO_NTOHS(digest.nbuckets, message + 4);
+            if(digest.nbuckets < 8 || digest.nbuckets > DIGEST_MAX_BUCKETS ||
+               (digest.nbuckets & (digest.nbuckets - 1)) != 0 ||
+               length < 3 + 4 * digest.nbuckets) {
+                goto fail;
+            }
+            for(j = 0; j < digest.nbuckets; j++)
+                DO_NTOHL(digest.hash[j], message + 6 + 4 * j);
+            neigh->digest = 1;
+
+            rc = check_neighbour_digest(neigh, &digest, mismatch);
+            debugf("Received digest (%d buckets, %d differ) from %s on %s.\n",
+                   digest.nbuckets, rc, format_address(from), ifp->name);
+            if(rc > 0)
+                send_digest_request(neigh, mismatch, digest.nbuckets);
+        } else if(type == MESSAGE_DIGEST_REQ) {
+            /*
+                0                   1                   2                   3
+                0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |   Type = 12   |            Length             |    Rserved    |
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+                |            Buckets            |        Bucket Bitmap...       /
+                +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+            */
+            unsigned short nbuckets;
+
+            if(length < 3) {
+                goto fail;
+            }
+            DO_NTOHS(nbuckets, message + 4);
+            if(nbuckets < 8 || nbuckets > DIGEST_MAX_BUCKETS ||
+               (nbuckets & (nbuckets - 1)) != 0 ||
+               length < 3 + nbuckets / 8) {
+                goto fail;
+            }
+            neigh->digest = 1;
+            debugf("Received digest request from %s on %s.\n",
+                   format_address(from), ifp->name);
+            send_digest_buckets(neigh->ifp, message + 6, nbuckets);
         } else {
             debugf("Received unknown packet type %d from %s on %s.\n",
                    type, format_address(from), ifp->name);
@@ -1379,11 +1716,84 @@ fill_rtt_message(struct buffered *buf, struct interface *ifp)
     return 0;
 }
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+static void flush_requests(struct buffered *buf, struct interface *ifp);
+#endif //----- ADD for REQUEST AGGREGATION -----
+
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+/* Type, length, MBZ and raw length of a Compressed TLV. */
+#define COMPRESSED_HEADER_LEN 6
+
+static unsigned char compressed_packet[0xFFFF];
+
+/* Hellos and IHUs are never compressed, so that link quality estimation
+   works the same with every neighbour. */
+static int
+uncompressed_type(int type)
+{
+    return type == MESSAGE_HELLO || type == MESSAGE_IHU;
+}
+
+/* Build the packet to send from a compressing buffer.  Sends the raw
+   buffer instead when it fits and compression doesn't pay. */
+static int
+compress_packet(struct buffered *buf, unsigned char **packet_return)
+{
+    /*
+        0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |   Type = 16   |            Length             |      MBZ      |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |          Raw Length           |      Compressed TLVs...       /
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    */
+    int i = 0, len = 0, zlen, tlen;
+
+    zlen = compressor_finish(buf->zc);
+    if(buf->len <= buf->size &&
+       buf->plain_len + zlen + COMPRESSED_HEADER_LEN >= buf->len) {
+        *packet_return = buf->buf;
+        return buf->len;
+    }
+
+    while(i < buf->len) {
+        DO_NTOHS(tlen, buf->buf + i + 1);
+        if(uncompressed_type(buf->buf[i])) {
+            memcpy(compressed_packet + len, buf->buf + i, tlen + 3);
+            len += tlen + 3;
+        }
+        i += tlen + 3;
+    }
+    compressed_packet[len] = MESSAGE_COMPRESSED;
+    DO_HTONS(compressed_packet + len + 1, zlen + 3);
+    compressed_packet[len + 3] = 0;
+    DO_HTONS(compressed_packet + len + 4, buf->zc->hlen);
+    memcpy(compressed_packet + len + COMPRESSED_HEADER_LEN, buf->zc->out, zlen);
+    len += COMPRESSED_HEADER_LEN + zlen;
+    assert(len <= buf->size);
+
+    debugf("  (compressed %d bytes to %d)\n", buf->len, len);
+    *packet_return = compressed_packet;
+    return len;
+}
+#endif //----- ADD for PACKET COMPRESSION -----
+
 void
 flushbuf(struct buffered *buf, struct interface *ifp)
 {
     int rc;
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+    unsigned char *packet;
+    int len;
+#endif //----- ADD for PACKET COMPRESSION -----
+
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+    if(buf->num_requests > 0)
+        flush_requests(buf, ifp);
+#endif //----- ADD for REQUEST AGGREGATION -----
 
+#ifdef BABELD_CODE //+++++ REPLACE +++++
     assert(buf->len <= buf->size);
 
     if(buf->len > 0) {
@@ -1399,11 +1809,46 @@ flushbuf(struct buffered *buf, struct interface *ifp)
             perror("send");
     }
     VALGRIND_MAKE_MEM_UNDEFINED(buf->buf, buf->size);
+#else // CEFBABELD
+    assert(buf->len <= (buf->compress > 0 ? buf->capacity : buf->size));
+
+    if(buf->len > 0) {
+        debugf("  (flushing %d buffered bytes)\n", buf->len);
+        fill_rtt_message(buf, ifp);
+        if(buf->compress > 0) {
+            len = compress_packet(buf, &packet);
+        } else {
+            packet = buf->buf;
+            len = buf->len;
+        }
+        DO_HTONS(packet_header + 2, len);
+        rc = babel_send(protocol_socket,
+                        packet_header, sizeof(packet_header),
+                        packet, len,
+                        (struct sockaddr*)&buf->sin6,
+                        sizeof(buf->sin6));
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+        USDT_PROBE4(flushbuf, ifp->ifindex, buf->len, len, rc);
+#endif //----- ADD for USDT -----
+        if(rc < 0) {
+            perror("send");
+        } else {
+            ifp->tx_packets++;
+            ifp->tx_bytes += sizeof(packet_header) + len;
+        }
+    }
+    VALGRIND_MAKE_MEM_UNDEFINED(buf->buf, buf->capacity);
+    buf->compress = -1;
+    buf->plain_len = 0;
+#endif //----- REPLACE -----
     buf->len = 0;
     buf->hello = -1;
     buf->have_id = 0;
     buf->have_nh = 0;
     buf->have_prefix = 0;
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+    buf->have_name = 0;
+#endif //----- ADD for NAME COMPRESSION -----
     buf->timeout.tv_sec = 0;
     buf->timeout.tv_usec = 0;
 }
@@ -1429,10 +1874,57 @@ schedule_flush_now(struct buffered *buf)
     schedule_flush_ms(buf, roughly(10));
 }
 
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+static unsigned short buffer_caps(struct buffered *buf, struct interface *ifp);
+
+/* Decide whether the packet we are about to build will be compressed. */
+static void
+start_packet(struct buffered *buf, struct interface *ifp)
+{
+    buf->plain_len = 0;
+    buf->compress = packet_compression && buf->capacity > buf->size &&
+        (buffer_caps(buf, ifp) & CAP_PACKET_COMPRESSION) != 0;
+    if(buf->compress && buf->zc == NULL) {
+        buf->zc = compressor_new(buf->capacity);
+        if(buf->zc == NULL) {
+            perror("malloc(compressor)");
+            buf->compress = 0;
+        }
+    }
+    if(buf->compress)
+        compressor_reset(buf->zc);
+}
+
+/* Bytes of messages that are guaranteed to fit once compressed. */
+static int
+compressed_room(struct buffered *buf)
+{
+    return MIN(compressor_room(buf->zc, buf->size - buf->plain_len -
+                               COMPRESSED_HEADER_LEN),
+               buf->capacity - buf->len);
+}
+
+/* Bytes of messages that still fit in the packet being built.  What
+   fits uncompressed always fits, compressing or not. */
+static int
+buffer_room(struct buffered *buf, struct interface *ifp)
+{
+    if(buf->compress < 0)
+        start_packet(buf, ifp);
+    if(buf->compress > 0)
+        return MAX(compressed_room(buf), buf->size - buf->len);
+    return buf->size - buf->len;
+}
+#endif //----- ADD for PACKET COMPRESSION -----
+
 static void
 ensure_space(struct buffered *buf, struct interface *ifp, int space)
 {
+#ifdef BABELD_CODE //+++++ REPLACE +++++
     if(buf->size - buf->len < space)
+#else // CEFBABELD
+    if(buffer_room(buf, ifp) < space)
+#endif //----- REPLACE -----
         flushbuf(buf, ifp);
 }
 
@@ -1446,8 +1938,13 @@ start_message(struct buffered *buf, struct interface *ifp, int type, int len)
     buf->buf[buf->len++] = len;
 #else // CEFBABELD
     uint16_t val;
-    if(buf->size - buf->len < len + 3)
+    if(buffer_room(buf, ifp) < len + 3)
         flushbuf(buf, ifp);
+    if(buf->compress < 0)
+        start_packet(buf, ifp);
+    /* Only fits uncompressed, give up compressing this packet. */
+    if(buf->compress > 0 && compressed_room(buf) < len + 3)
+        buf->compress = 0;
     buf->buf[buf->len] = type;
     val = htons (len);
     memcpy (&(buf->buf[buf->len+1]), &val, 2);
@@ -1466,6 +1963,13 @@ end_message(struct buffered *buf, int type, int bytes)
 #else // CEFBABELD
     assert(buf->len >= bytes + 3);
     assert(buf->buf[buf->len - bytes - 3] == type);
+    if(buf->compress > 0) {
+        if(uncompressed_type(type))
+            buf->plain_len += bytes + 3;
+        else
+            compressor_feed(buf->zc, buf->buf + buf->len - bytes - 3,
+                            bytes + 3);
+    }
     schedule_flush(buf);
 #endif //----- REPLACE -----
 }
@@ -1528,6 +2032,31 @@ send_ack(struct neighbour *neigh, unsigned short nonce, unsigned short interval)
     schedule_flush_ms(&neigh->buf, roughly(interval * 6));
 }
 
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+/* Older peers take every Hello sub-TLV for the first one, and complain
+   that a Capabilities sub-TLV after the timestamp is a short timestamp.
+   So a timestamped Hello only carries one when buf is read by at least one
+   neighbour and every one of them has flagged its own Hellos with
+   HELLO_FLAG_CAPABILITIES. */
+static int
+hello_caps_allowed(struct buffered *buf, struct interface *ifp)
+{
+    struct neighbour *neigh;
+    int found = 0;
+
+    FOR_ALL_NEIGHBOURS(neigh) {
+        if(&neigh->buf == buf)
+            return neigh->caps_flag;
+        if(buf == &ifp->buf && neigh->ifp == ifp) {
+            if(!neigh->caps_flag)
+                return 0;
+            found = 1;
+        }
+    }
+    return found;
+}
+#endif //----- ADD for NAME COMPRESSION -----
+
 static void
 buffer_hello(struct buffered *buf, struct interface *ifp,
              unsigned short seqno, unsigned interval, int unicast)
@@ -1545,6 +2074,9 @@ buffer_hello(struct buffered *buf, struct interface *ifp,
     
 #endif //----- ADD -----
     int timestamp = !!(ifp->flags & IF_TIMESTAMPS);
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+    int caps;
+#endif //----- ADD for NAME COMPRESSION -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
     start_message(buf, ifp, MESSAGE_HELLO, timestamp ? 12 : 6);
     buf->hello = buf->len - 2;
@@ -1553,9 +2085,11 @@ buffer_hello(struct buffered *buf, struct interface *ifp,
 #ifdef DEB_UPDATE   //+++++ for DEB +++++
     fprintf(stderr, "<<<<< Send HELLO\n");
 #endif              //----- for DEB -----
-    start_message(buf, ifp, MESSAGE_HELLO, timestamp ? 11 : 5);
+    caps = !timestamp || hello_caps_allowed(buf, ifp);
+    start_message(buf, ifp, MESSAGE_HELLO,
+                  (timestamp ? 11 : 5) + (caps ? 4 : 0));
     buf->hello = buf->len - 3;
-    accumulate_byte(buf, unicast ? 0x80 : 0);
+    accumulate_byte(buf, (unicast ? 0x80 : 0) | HELLO_FLAG_CAPABILITIES);
 #endif //----- REPLACE -----
     accumulate_short(buf, seqno);
     accumulate_short(buf, interval > 0xFFFF ? 0xFFFF : interval);
@@ -1569,7 +2103,14 @@ buffer_hello(struct buffered *buf, struct interface *ifp,
 #ifdef BABELD_CODE //+++++ REPLACE +++++
     end_message(buf, MESSAGE_HELLO, timestamp ? 12 : 6);
 #else // CEFBABELD  
-    end_message(buf, MESSAGE_HELLO, timestamp ? 11 : 5);
+    /* Kept after the timestamp, which fill_rtt_message expects first. */
+    if(caps) {
+        accumulate_byte(buf, SUBTLV_CAPABILITIES);
+        accumulate_byte(buf, 2);
+        accumulate_short(buf, CAP_NAME_COMPRESSION | CAP_MULTI_REQUEST |
+                         CAP_PACKET_COMPRESSION);
+    }
+    end_message(buf, MESSAGE_HELLO, (timestamp ? 11 : 5) + (caps ? 4 : 0));
 #endif //----- REPLACE -----
 }
 
@@ -1640,6 +2181,67 @@ send_hello(struct interface *ifp)
         send_marginal_ihu(ifp);
 }
 
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+/* Capabilities shared by every neighbour that reads buf. */
+static unsigned short
+buffer_caps(struct buffered *buf, struct interface *ifp)
+{
+    struct neighbour *neigh;
+    unsigned short caps = 0xFFFF;
+    int n = 0;
+
+    FOR_ALL_NEIGHBOURS(neigh) {
+        if(&neigh->buf == buf)
+            return neigh->caps;
+        if(buf == &ifp->buf && neigh->ifp == ifp) {
+            caps &= neigh->caps;
+            n++;
+        }
+    }
+    return n > 0 ? caps : 0;
+}
+
+static unsigned char name_frag_tag = 0;
+
+/* Send a name that doesn't fit in a single packet as a sequence of Name
+   Fragment TLVs; the Update that follows refers to it by tag. */
+static void
+buffer_name_fragments(struct buffered *buf, struct interface *ifp,
+                      const unsigned char *prefix, uint16_t plen)
+{
+    /*
+        0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |   Type = 13   |            Length             |      Tag      |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |              Plen             |            Offset             |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |   Name Fragment...
+        +-+-+-+-+-+-+-+-+-+-+-+-
+    */
+    uint16_t offset = 0;
+    int chunk;
+
+    name_frag_tag++;
+    while(offset < plen) {
+        chunk = buffer_room(buf, ifp) - 3 - 5;
+        if(chunk < 64) {
+            flushbuf(buf, ifp);
+            continue;
+        }
+        chunk = MIN(chunk, plen - offset);
+        start_message(buf, ifp, MESSAGE_NAME_FRAG, 5 + chunk);
+        accumulate_byte(buf, name_frag_tag);
+        accumulate_short(buf, plen);
+        accumulate_short(buf, offset);
+        accumulate_bytes(buf, prefix + offset, chunk);
+        end_message(buf, MESSAGE_NAME_FRAG, 5 + chunk);
+        offset += chunk;
+    }
+}
+#endif //----- ADD for NAME COMPRESSION -----
+
 static void
 really_buffer_update(struct buffered *buf, struct interface *ifp,
                      const unsigned char *id,
@@ -1760,6 +2362,10 @@ really_buffer_update(struct buffered *buf, struct interface *ifp,
         buf->have_prefix = 1;
     }
 #else // CEFBABELD  
+    int compress, fragmented = 0, flushed = 0, len;
+    unsigned char flags;
+    uint16_t omit;
+
     if(diversity_kind != DIVERSITY_CHANNEL)
         channels_len = -1;
     
@@ -1767,6 +2373,7 @@ really_buffer_update(struct buffered *buf, struct interface *ifp,
         return;
     
     metric = MIN(metric, INFINITY);
+    compress = (buffer_caps(buf, ifp) & CAP_NAME_COMPRESSION) != 0;
     
     /* Worst case */
     ensure_space(buf, ifp, 20 + 12 + 28 + 18);
@@ -1881,9 +2488,42 @@ fprintf(stderr, "<<<<< Send ROUTER_ID (%s)\n", format_eui64(id));
         /
         +-+-+-+-+-+-+-+-+-+-+-+-
     */
-        
-    if (((11 + plen) + buf->len) > buf->size){
-        flushbuf(buf, ifp);
+    flags = 0;
+    omit = 0;
+    if(fragmented) {
+        /* The whole name went out in Name Fragment TLVs. */
+        flags = UPDATE_FLAG_DEFAULT_NAME | UPDATE_FLAG_OMIT |
+            UPDATE_FLAG_FRAGMENTED;
+        omit = plen;
+        len = 13;
+    } else if(compress) {
+        flags = UPDATE_FLAG_DEFAULT_NAME | UPDATE_FLAG_OMIT;
+        if(buf->have_name) {
+            while(omit < plen && omit < buf->name_len &&
+                  buf->name[omit] == prefix[omit])
+                omit++;
+        }
+        len = 13 + plen - omit;
+    } else {
+        len = 11 + plen;
+    }
+
+    if(len + 3 > buffer_room(buf, ifp)) {
+        if(!flushed) {
+            flushbuf(buf, ifp);
+            flushed = 1;
+            goto RESET_NH;
+        }
+        /* Doesn't fit even in an empty packet. */
+        if(!compress || fragmented) {
+            fprintf(stderr,
+                    "Couldn't send update for %s on %s: name too long.\n",
+                    format_cefore_prefix(prefix, plen), ifp->name);
+            return;
+        }
+        buffer_name_fragments(buf, ifp, prefix, plen);
+        fragmented = 1;
+        flushed = 0;
         goto RESET_NH;
     }
     
@@ -1893,16 +2533,23 @@ fprintf(stderr, "<<<<< Send ROUTER_ID (%s)\n", format_eui64(id));
 #endif              //----- for DEB -----
     debugf("Sent update prefix=%s (plen=%u, seqno=%u, metric=%u) to %s\n"
                   , format_cefore_prefix(prefix, plen), plen, seqno, metric, ifp->name);
-    start_message(buf, ifp, MESSAGE_UPDATE, 11 + plen);
-    accumulate_byte(buf, 0);
+    start_message(buf, ifp, MESSAGE_UPDATE, len);
     accumulate_byte(buf, 0);
+    accumulate_byte(buf, flags);
     accumulate_short(buf, (unsigned short) plen);
-    accumulate_byte(buf, 0);
+    accumulate_byte(buf, fragmented ? name_frag_tag : 0);
     accumulate_short(buf, (ifp->update_interval + 5) / 10);
     accumulate_short(buf, seqno);
     accumulate_short(buf, metric);
-    accumulate_bytes(buf, prefix, plen);
-    end_message(buf, MESSAGE_UPDATE, 11 + plen);
+    if(flags & UPDATE_FLAG_OMIT)
+        accumulate_short(buf, omit);
+    accumulate_bytes(buf, prefix + omit, plen - omit);
+    end_message(buf, MESSAGE_UPDATE, len);
+    if(flags & UPDATE_FLAG_DEFAULT_NAME) {
+        memcpy(buf->name, prefix, plen);
+        buf->name_len = plen;
+        buf->have_name = 1;
+    }
 #endif //----- REPLACE -----
 }
 
@@ -1923,6 +2570,13 @@ really_send_update(struct interface *ifp, const unsigned char *id,
     if(!if_up(ifp))
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+    cefstat.update_sent++;
+#endif //----- ADD for COUNTERS -----
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    convergence_advertised(prefix, plen);
+#endif //----- ADD for CONVERGENCE -----
+
     if((ifp->flags & IF_UNICAST) != 0) {
         struct neighbour *neigh;
         FOR_ALL_NEIGHBOURS(neigh) {
@@ -1983,19 +2637,28 @@ compare_buffered_updates(const void *av, const void *bv)
         return 1;
 #endif //----- DEL -----
     
+#ifdef BABELD_CODE //+++++ REPLACE +++++
     if(a->plen < b->plen)
         return 1;
     else if(a->plen > b->plen)
         return -1;
 
-#ifdef BABELD_CODE //+++++ REPLACE +++++
     rc = memcmp(a->prefix, b->prefix, 16);
+    if(rc != 0)
+        return rc;
 #else // CEFBABELD
-    rc = memcmp(a->prefix, b->prefix, a->plen);
-#endif //----- REPLACE -----
+    /* Lexicographic order, so that names sharing leading segments are
+       sent back to back and compress against each other. */
+    rc = memcmp(a->prefix, b->prefix, MIN(a->plen, b->plen));
     if(rc != 0)
         return rc;
 
+    if(a->plen < b->plen)
+        return -1;
+    else if(a->plen > b->plen)
+        return 1;
+#endif //----- REPLACE -----
+
     if(a->src_plen < b->src_plen)
         return -1;
     else if(a->src_plen > b->src_plen)
@@ -2034,6 +2697,10 @@ flushupdates(struct interface *ifp)
     if(ifp->num_buffered_updates > 0) {
         struct buffered_update *b = ifp->buffered_updates;
         int n = ifp->num_buffered_updates;
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+        struct timespec start;
+        latency_start(&start);
+#endif //----- ADD for LATENCY -----
 
         ifp->buffered_updates = NULL;
         ifp->update_bufsize = 0;
@@ -2152,6 +2819,10 @@ flushupdates(struct interface *ifp)
                 }
                     
 #endif //----- ADD for MP -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+                if(metric < INFINITY && damping_suppressed(route->src))
+                    continue;
+#endif //----- ADD for DAMPING -----
 
                 if(metric < INFINITY)
                     satisfy_request(route->src->prefix, route->src->plen,
@@ -2244,6 +2915,9 @@ flushupdates(struct interface *ifp)
         }
     done:
         free(b);
+#ifndef BABELD_CODE //+++++ ADD for LATENCY +++++
+        latency_record(CefC_Lat_Flush_Updates, &start);
+#endif //----- ADD for LATENCY -----
     }
     ifp->update_flush_timeout.tv_sec = 0;
     ifp->update_flush_timeout.tv_usec = 0;
@@ -2322,6 +2996,10 @@ send_update(struct interface *ifp, int urgent,
 #endif //----- REPLACE -----
             const unsigned char *src_prefix, unsigned char src_plen)
 {
+#ifndef BABELD_CODE //+++++ ADD for CONVERGENCE +++++
+    if(prefix)
+        convergence_scheduled(prefix, plen);
+#endif //----- ADD for CONVERGENCE -----
     if(ifp == NULL) {
         struct interface *ifp_aux;
         struct babel_route *route;
@@ -2478,6 +3156,100 @@ send_wildcard_retraction(struct interface *ifp)
     }
 }
 
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+static void
+buffer_digest(struct buffered *buf, struct interface *ifp,
+              const struct route_digest *digest)
+{
+    /*
+        0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |   Type = 11   |            Length             |    Rserved    |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |            Buckets            |        Bucket Hash[0]...      /
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    */
+    int i, len = 3 + 4 * digest->nbuckets;
+
+    /* start_message can only make room up to the size of the buffer. */
+    if(len + 3 > buf->size)
+        return;
+    start_message(buf, ifp, MESSAGE_DIGEST, len);
+    accumulate_byte(buf, 0);
+    accumulate_short(buf, digest->nbuckets);
+    for(i = 0; i < digest->nbuckets; i++)
+        accumulate_int(buf, digest->hash[i]);
+    end_message(buf, MESSAGE_DIGEST, len);
+}
+
+/* Sent instead of a full dump when delta updates are enabled.  Returns -1
+   if the packets of ifp are too small for a digest. */
+int
+send_digest(struct interface *ifp)
+{
+    struct route_digest digest;
+    int nbuckets;
+
+    if(ifp == NULL) {
+        struct interface *ifp_aux;
+        FOR_ALL_INTERFACES(ifp_aux)
+            send_digest(ifp_aux);
+        return 0;
+    }
+
+    if(!if_up(ifp))
+        return 0;
+
+    /* The neighbours' buffers are as large as the interface's. */
+    nbuckets = digest_buckets(ifp->buf.size);
+    if(nbuckets == 0)
+        return -1;
+
+    /* Make the digest describe what is already on the wire. */
+    flushupdates(ifp);
+    digest_interface(ifp, &digest, nbuckets);
+
+    debugf("Sending digest to %s.\n", ifp->name);
+    if((ifp->flags & IF_UNICAST) != 0) {
+        struct neighbour *neigh;
+        FOR_ALL_NEIGHBOURS(neigh) {
+            if(neigh->ifp == ifp) {
+                buffer_digest(&neigh->buf, ifp, &digest);
+            }
+        }
+    } else {
+        buffer_digest(&ifp->buf, ifp, &digest);
+    }
+    set_timeout(&ifp->update_timeout, ifp->update_interval);
+    return 1;
+}
+
+void
+send_digest_request(struct neighbour *neigh,
+                    const unsigned char *buckets, int nbuckets)
+{
+    /*
+        0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |   Type = 12   |            Length             |    Rserved    |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |            Buckets            |        Bucket Bitmap...       /
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    */
+    int len = 3 + nbuckets / 8;
+
+    debugf("Sending digest request to %s on %s.\n",
+           format_address(neigh->address), neigh->ifp->name);
+    start_message(&neigh->buf, neigh->ifp, MESSAGE_DIGEST_REQ, len);
+    accumulate_byte(&neigh->buf, 0);
+    accumulate_short(&neigh->buf, nbuckets);
+    accumulate_bytes(&neigh->buf, buckets, nbuckets / 8);
+    end_message(&neigh->buf, MESSAGE_DIGEST_REQ, len);
+}
+#endif //----- ADD for DIGEST -----
+
 void
 update_myseqno()
 {
@@ -2651,6 +3423,253 @@ send_marginal_ihu(struct interface *ifp)
     }
 }
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+/* Requests for specific prefixes are not sent straight away: they are
+   queued on the buffer and go out together when it is next flushed,
+   packed into multi-prefix TLVs for neighbours that understand them. */
+
+static void
+queue_request(struct buffered *buf, unsigned char type,
+              const unsigned char *prefix, uint16_t plen,
+              unsigned short seqno, const unsigned char *id,
+              unsigned short hop_count)
+{
+    struct buffered_request *r;
+
+    if(buf->num_requests >= buf->request_bufsize) {
+        int n = buf->request_bufsize == 0 ? 16 : 2 * buf->request_bufsize;
+        r = realloc(buf->requests, n * sizeof(struct buffered_request));
+        if(r == NULL) {
+            perror("realloc(requests)");
+            return;
+        }
+        buf->requests = r;
+        buf->request_bufsize = n;
+    }
+
+    r = &buf->requests[buf->num_requests];
+    r->prefix = malloc(MAX(plen, 1));
+    if(r->prefix == NULL) {
+        perror("malloc(request)");
+        return;
+    }
+    memcpy(r->prefix, prefix, plen);
+    r->plen = plen;
+    r->type = type;
+    r->seqno = seqno;
+    r->hop_count = hop_count;
+    if(id)
+        memcpy(r->id, id, 8);
+    else
+        memset(r->id, 0, 8);
+    buf->num_requests++;
+    schedule_flush(buf);
+}
+
+void
+discard_requests(struct buffered *buf)
+{
+    int i;
+    for(i = 0; i < buf->num_requests; i++)
+        free(buf->requests[i].prefix);
+    free(buf->requests);
+    buf->requests = NULL;
+    buf->num_requests = 0;
+    buf->request_bufsize = 0;
+}
+
+static int
+compare_buffered_requests(const void *av, const void *bv)
+{
+    const struct buffered_request *a = av, *b = bv;
+    int rc;
+
+    if(a->type != b->type)
+        return a->type < b->type ? -1 : 1;
+    rc = memcmp(a->prefix, b->prefix, MIN(a->plen, b->plen));
+    if(rc != 0)
+        return rc;
+    if(a->plen != b->plen)
+        return a->plen < b->plen ? -1 : 1;
+    return memcmp(a->id, b->id, 8);
+}
+
+/* Size of one entry of a multi-prefix request. */
+static int
+request_entry_len(const struct buffered_request *r)
+{
+    return (r->type == BUFFERED_MH_REQUEST ? 14 : 2) + r->plen;
+}
+
+/* Size of the legacy single-prefix TLV body for a request. */
+static int
+request_legacy_len(const struct buffered_request *r)
+{
+    return (r->type == BUFFERED_MH_REQUEST ? 17 : 3) + r->plen;
+}
+
+static void
+send_legacy_request(struct buffered *buf, struct interface *ifp,
+                    const struct buffered_request *r)
+{
+    int len = request_legacy_len(r);
+
+    if(r->type == BUFFERED_REQUEST) {
+#ifdef DEB_REQ   //+++++ for DEB +++++
+        fprintf(stderr, "<<<<< Sending request for %s.\n",
+                format_cefore_prefix(r->prefix, r->plen));
+#endif              //----- for DEB -----
+        start_message(buf, ifp, MESSAGE_REQUEST, len);
+        accumulate_byte(buf, 1);
+        accumulate_short(buf, r->plen);
+        accumulate_bytes(buf, r->prefix, r->plen);
+        end_message(buf, MESSAGE_REQUEST, len);
+    } else {
+#ifdef DEB_REQ   //+++++ for DEB +++++
+        fprintf(stderr, "<<<<< Send MH_REQUEST prefix=%s (plen=%u, seqno=%u, hop_count=%u id=%s)\n"
+                      , format_cefore_prefix(r->prefix, r->plen), r->plen
+                      , r->seqno, r->hop_count, format_eui64(r->id));
+#endif              //----- for DEB -----
+        start_message(buf, ifp, MESSAGE_MH_REQUEST, len);
+        accumulate_byte(buf, 0);
+        accumulate_short(buf, r->plen);
+        accumulate_short(buf, r->seqno);
+        accumulate_byte(buf, r->hop_count);
+        accumulate_byte(buf, 0);
+        accumulate_byte(buf, 0);
+        accumulate_byte(buf, 0);
+        accumulate_bytes(buf, r->id, 8);
+        accumulate_bytes(buf, r->prefix, r->plen);
+        end_message(buf, MESSAGE_MH_REQUEST, len);
+    }
+}
+
+/* Send a run of requests of the same type as a single TLV. */
+static void
+send_multi_request(struct buffered *buf, struct interface *ifp,
+                   const struct buffered_request *reqs, int n, int len)
+{
+    /*
+        0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        | Type = 14/15  |            Length             |      MBZ      |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |             Count             |          Entries...           /
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+        Entry of a Multi Request (14):
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |              Plen             |          Name Prefix...       /
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+        Entry of a Multi Seqno Request (15):
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |              Plen             |            Seqno              |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |  Hop Count    |    Rserved    |                               |
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+                               +
+        |                           Router-Id                           |
+        +                               +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        |                               |          Name Prefix...       /
+        +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    */
+    int type, i;
+
+    type = reqs[0].type == BUFFERED_MH_REQUEST ?
+        MESSAGE_MULTI_MH_REQUEST : MESSAGE_MULTI_REQUEST;
+    debugf("Sending %d requests in one %s TLV on %s.\n", n,
+           type == MESSAGE_MULTI_MH_REQUEST ? "seqno request" : "request",
+           ifp->name);
+    start_message(buf, ifp, type, len);
+    accumulate_byte(buf, 0);
+    accumulate_short(buf, n);
+    for(i = 0; i < n; i++) {
+        accumulate_short(buf, reqs[i].plen);
+        if(type == MESSAGE_MULTI_MH_REQUEST) {
+            accumulate_short(buf, reqs[i].seqno);
+            accumulate_byte(buf, reqs[i].hop_count);
+            accumulate_byte(buf, 0);
+            accumulate_bytes(buf, reqs[i].id, 8);
+        }
+        accumulate_bytes(buf, reqs[i].prefix, reqs[i].plen);
+    }
+    end_message(buf, type, len);
+}
+
+static void
+flush_requests(struct buffered *buf, struct interface *ifp)
+{
+    struct buffered_request *reqs = buf->requests;
+    int n = buf->num_requests;
+    int i, j, len, multi;
+
+    /* Detach the queue first, since emitting may flush buf again. */
+    buf->requests = NULL;
+    buf->num_requests = 0;
+    buf->request_bufsize = 0;
+
+    /* Sort so that duplicates are adjacent, and merge them. */
+    qsort(reqs, n, sizeof(struct buffered_request), compare_buffered_requests);
+    j = 0;
+    for(i = 0; i < n; i++) {
+        if(j > 0 && compare_buffered_requests(&reqs[j - 1], &reqs[i]) == 0) {
+            if(seqno_compare(reqs[i].seqno, reqs[j - 1].seqno) > 0)
+                reqs[j - 1].seqno = reqs[i].seqno;
+            reqs[j - 1].hop_count = MAX(reqs[j - 1].hop_count,
+                                        reqs[i].hop_count);
+            free(reqs[i].prefix);
+            continue;
+        }
+        reqs[j++] = reqs[i];
+    }
+    n = j;
+
+    multi = (buffer_caps(buf, ifp) & CAP_MULTI_REQUEST) != 0;
+
+    i = 0;
+    while(i < n) {
+        if(!multi) {
+            if(request_legacy_len(&reqs[i]) + 3 > buf->size)
+                fprintf(stderr,
+                        "Couldn't send request for %s on %s: name too long.\n",
+                        format_cefore_prefix(reqs[i].prefix, reqs[i].plen),
+                        ifp->name);
+            else
+                send_legacy_request(buf, ifp, &reqs[i]);
+            i++;
+            continue;
+        }
+
+        len = 3;
+        for(j = i; j < n && reqs[j].type == reqs[i].type; j++) {
+            if(len + request_entry_len(&reqs[j]) + 3 > buffer_room(buf, ifp) ||
+               j - i >= 0xFFFF)
+                break;
+            len += request_entry_len(&reqs[j]);
+        }
+        if(j == i) {
+            if(buf->len > 0) {
+                flushbuf(buf, ifp);
+                continue;
+            }
+            fprintf(stderr,
+                    "Couldn't send request for %s on %s: name too long.\n",
+                    format_cefore_prefix(reqs[i].prefix, reqs[i].plen),
+                    ifp->name);
+            i++;
+            continue;
+        }
+        send_multi_request(buf, ifp, reqs + i, j - i, len);
+        i = j;
+    }
+
+    for(i = 0; i < n; i++)
+        free(reqs[i].prefix);
+    free(reqs);
+}
+#endif //----- ADD for REQUEST AGGREGATION -----
+
 /* Standard wildcard request with prefix == NULL && src_prefix == zeroes,
    Specific wildcard request with prefix == zeroes && src_prefix == NULL. */
 static void
@@ -2685,6 +3704,10 @@ send_request(struct buffered *buf, struct interface *ifp,
     if(is_ss && (ifp->flags & IF_RFC6126) != 0)
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix(CefC_Trace_Request, prefix, plen, buf->sin6.sin6_addr.s6_addr,
+                 ifp->ifindex, 0, 0, 0, 0);
+#endif //----- ADD for TRACE -----
     if(!prefix) {
         assert(!src_prefix);
         debugf("sending request for any.\n");
@@ -2741,16 +3764,7 @@ send_request(struct buffered *buf, struct interface *ifp,
     }
     end_message(buf, MESSAGE_REQUEST, len);
 #else // CEFBABELD
-#ifdef DEB_REQ   //+++++ for DEB +++++
-    fprintf(stderr, "<<<<< Sending request for %s from %s.\n",
-           format_cefore_prefix(prefix, plen),
-           format_prefix(src_prefix, src_plen));
-#endif              //----- for DEB -----
-    start_message(buf, ifp, MESSAGE_REQUEST, 3 + plen);
-    accumulate_byte(buf, 1);
-    accumulate_short(buf, plen);
-    accumulate_bytes(buf, prefix, plen);
-    end_message(buf, MESSAGE_REQUEST, 3 + plen);
+    queue_request(buf, BUFFERED_REQUEST, prefix, plen, 0, NULL, 0);
 #endif //----- REPLACE -----
 
 }
@@ -2777,6 +3791,11 @@ send_multicast_request(struct interface *ifp,
     if(!if_up(ifp))
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+    if(prefix && !request_allowed(ifp, prefix, plen, NULL))
+        return;
+#endif //----- ADD for REQUEST LIMIT -----
+
     /* make sure any buffered updates go out before this request. */
     flushupdates(ifp);
 
@@ -2805,6 +3824,11 @@ send_unicast_request(struct neighbour *neigh,
     if(!if_up(neigh->ifp))
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+    if(prefix && !request_allowed(neigh->ifp, prefix, plen, NULL))
+        return;
+#endif //----- ADD for REQUEST LIMIT -----
+
     flushupdates(neigh->ifp);
 
     send_request(&neigh->buf, neigh->ifp, prefix, plen, src_prefix, src_plen);
@@ -2848,6 +3872,10 @@ send_multihop_request(struct buffered *buf, struct interface *ifp,
     if(is_ss && (ifp->flags & IF_RFC6126) != 0)
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix(CefC_Trace_Request, prefix, plen, buf->sin6.sin6_addr.s6_addr,
+                 ifp->ifindex, seqno, 0, hop_count, CefC_Trace_Seqno);
+#endif //----- ADD for TRACE -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
     debugf("Sending request (%d) for %s.\n",
            hop_count, format_prefix(prefix, plen));
@@ -2886,24 +3914,8 @@ send_multihop_request(struct buffered *buf, struct interface *ifp,
     }
     end_message(buf, MESSAGE_MH_REQUEST, len);
 #else // CEFBABELD
-#ifdef DEB_REQ   //+++++ for DEB +++++
-    fprintf(stderr, "<<<<< Send MH_REQUEST prefix=%s (plen=%u, seqno=%u, hop_count=%u id=%s)\n"
-                  , format_cefore_prefix(prefix, plen), plen, seqno, hop_count
-                  , format_eui64(id));
-#endif              //----- for DEB -----
-    start_message(buf, ifp, MESSAGE_MH_REQUEST, 17+plen);
-
-    accumulate_byte(buf, 0);
-    accumulate_short(buf, plen);
-    accumulate_short(buf, seqno);
-    accumulate_byte(buf, hop_count);
-    accumulate_byte(buf, 0);
-    accumulate_byte(buf, 0);
-    accumulate_byte(buf, 0);
-    accumulate_bytes(buf, id, 8);
-    accumulate_bytes(buf, prefix, plen);
-    
-    end_message(buf, MESSAGE_MH_REQUEST, 17+plen);
+    queue_request(buf, BUFFERED_MH_REQUEST, prefix, plen, seqno, id,
+                  hop_count);
 #endif //----- REPLACE -----
 }
 
@@ -2935,6 +3947,11 @@ send_multicast_multihop_request(struct interface *ifp,
     if(!if_up(ifp))
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+    if(!request_allowed(ifp, prefix, plen, id))
+        return;
+#endif //----- ADD for REQUEST LIMIT -----
+
     if((ifp->flags & IF_UNICAST) != 0) {
             struct neighbour *neigh;
             FOR_ALL_NEIGHBOURS(neigh) {
@@ -2965,6 +3982,10 @@ send_unicast_multihop_request(struct neighbour *neigh,
                               unsigned short seqno, const unsigned char *id,
                               unsigned short hop_count)
 {
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+    if(!request_allowed(neigh->ifp, prefix, plen, id))
+        return;
+#endif //----- ADD for REQUEST LIMIT -----
     flushupdates(neigh->ifp);
     send_multihop_request(&neigh->buf, neigh->ifp,
                           prefix, plen, src_prefix, src_plen,
@@ -2996,6 +4017,10 @@ send_request_resend(const unsigned char *prefix, uint16_t plen,
         struct interface *ifp;
         FOR_ALL_INTERFACES(ifp) {
         if(!if_up(ifp)) continue;
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+            if(!request_allowed(ifp, prefix, plen, id))
+                continue;
+#endif //----- ADD for REQUEST LIMIT -----
             send_multihop_request(&ifp->buf, ifp,
                                   prefix, plen, src_prefix, src_plen,
                                   seqno, id, 127);
@@ -3096,6 +4121,9 @@ handle_request(struct neighbour *neigh, const unsigned char *prefix,
         /* Give up */
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+    cefstat.request_forwarded++;
+#endif //----- ADD for COUNTERS -----
     send_unicast_multihop_request(successor, prefix, plen, src_prefix, src_plen,
                                   seqno, id, hop_count - 1);
     record_resend(RESEND_REQUEST, prefix, plen, src_prefix, src_plen, seqno, id,
@@ -62,6 +62,36 @@ THE SOFTWARE.
 #define MESSAGE_UPDATE 8
 #define MESSAGE_REQUEST 9
 #define MESSAGE_MH_REQUEST 10
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+#define MESSAGE_DIGEST 11
+#define MESSAGE_DIGEST_REQ 12
+#endif //----- ADD for DIGEST -----
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+#define MESSAGE_NAME_FRAG 13
+
+/* Flags of the Update TLV. */
+#define UPDATE_FLAG_DEFAULT_NAME 0x80   /* name becomes the default name */
+#define UPDATE_FLAG_OMIT 0x40           /* name starts with an Omit count */
+#define UPDATE_FLAG_FRAGMENTED 0x20     /* omitted bytes come from fragments */
+
+/* Capabilities carried in the Hello sub-TLV. */
+#define CAP_NAME_COMPRESSION 0x0001
+
+/* Flag of the Hello TLV: the sender parses sub-TLVs after the first one,
+   so it may be sent a Capabilities sub-TLV after the timestamp. */
+#define HELLO_FLAG_CAPABILITIES 0x40
+#endif //----- ADD for NAME COMPRESSION -----
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+#define MESSAGE_MULTI_REQUEST 14
+#define MESSAGE_MULTI_MH_REQUEST 15
+
+#define CAP_MULTI_REQUEST 0x0002
+#endif //----- ADD for REQUEST AGGREGATION -----
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+#define MESSAGE_COMPRESSED 16
+
+#define CAP_PACKET_COMPRESSION 0x0004
+#endif //----- ADD for PACKET COMPRESSION -----
 
 /* Protocol extension through sub-TLVs. */
 #define SUBTLV_PAD1 0
@@ -69,6 +99,9 @@ THE SOFTWARE.
 #define SUBTLV_DIVERSITY 2       /* Also known as babelz. */
 #define SUBTLV_TIMESTAMP 3       /* Used to compute RTT. */
 #define SUBTLV_SOURCE_PREFIX 128 /* Source-specific routing. */
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+#define SUBTLV_CAPABILITIES 64   /* cefbabel extensions we understand. */
+#endif //----- ADD for NAME COMPRESSION -----
 
 extern unsigned short myseqno;
 extern struct timeval seqno_time;
@@ -82,6 +115,9 @@ void parse_packet(const unsigned char *from, struct interface *ifp,
                   const unsigned char *packet, int packetlen);
 void flushbuf(struct buffered *buf, struct interface *ifp);
 void flushupdates(struct interface *ifp);
+#ifndef BABELD_CODE //+++++ ADD for REQUEST AGGREGATION +++++
+void discard_requests(struct buffered *buf);
+#endif //----- ADD for REQUEST AGGREGATION -----
 void send_ack(struct neighbour *neigh, unsigned short nonce,
               unsigned short interval);
 void send_multicast_hello(struct interface *ifp, unsigned interval, int force);
@@ -104,6 +140,11 @@ void send_update_resend(struct interface *ifp,
                         const unsigned char *src_prefix,
                         unsigned char src_plen);
 void send_wildcard_retraction(struct interface *ifp);
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+int send_digest(struct interface *ifp);
+void send_digest_request(struct neighbour *neigh,
+                         const unsigned char *buckets, int nbuckets);
+#endif //----- ADD for DIGEST -----
 void update_myseqno(void);
 void send_self_update(struct interface *ifp);
 void send_ihu(struct neighbour *neigh, struct interface *ifp);
@@ -67,6 +67,16 @@ THE SOFTWARE.
 #include "message.h"
 #include "resend.h"
 #include "local.h"
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+#include "compress.h"
+#endif //----- ADD for PACKET COMPRESSION -----
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+#include "digest.h"
+#endif //----- ADD for DIGEST -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+#include "cefore.h"
+#include "trace.h"
+#endif //----- ADD for TRACE -----
 
 struct neighbour *neighs = NULL;
 
@@ -85,8 +95,15 @@ find_neighbour_nocreate(const unsigned char *address, struct interface *ifp)
 void
 flush_neighbour(struct neighbour *neigh)
 {
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_prefix(CefC_Trace_Neigh_Flush, NULL, 0, neigh->address,
+                 neigh->ifp->ifindex, 0, neighbour_cost(neigh), 0, 0);
+#endif //----- ADD for TRACE -----
     flush_neighbour_routes(neigh);
     flush_resends(neigh);
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+    digest_flush_neighbour(neigh);
+#endif //----- ADD for DIGEST -----
 
     if(neighs == neigh) {
         neighs = neigh->next;
@@ -101,6 +118,10 @@ flush_neighbour(struct neighbour *neigh)
     free(neigh->buf.buf);
     free(neigh);
 #else // CEFBABELD
+    local_notify_neighbour(neigh, LOCAL_FLUSH);
+    free(neigh->frag_name);
+    discard_requests(&neigh->buf);
+    compressor_free(neigh->buf.zc);
     free(neigh->buf.buf);
     free(neigh);
 #endif //----- REPLACE -----
@@ -120,7 +141,11 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
     debugf("Creating neighbour %s on %s.\n",
            format_address(address), ifp->name);
 
+#ifdef BABELD_CODE //+++++ REPLACE +++++
     buf = malloc(ifp->buf.size);
+#else // CEFBABELD
+    buf = malloc(ifp->buf.capacity);
+#endif //----- REPLACE -----
     if(buf == NULL) {
         perror("malloc(neighbour->buf)");
         return NULL;
@@ -143,6 +168,10 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
     neigh->ifp = ifp;
     neigh->buf.buf = buf;
     neigh->buf.size = ifp->buf.size;
+#ifndef BABELD_CODE //+++++ ADD for PACKET COMPRESSION +++++
+    neigh->buf.capacity = ifp->buf.capacity;
+    neigh->buf.compress = -1;
+#endif //----- ADD for PACKET COMPRESSION -----
     neigh->buf.hello = -1;
     neigh->buf.flush_interval = ifp->buf.flush_interval;
     neigh->buf.sin6.sin6_family = AF_INET6;
@@ -154,6 +183,7 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
 #ifdef BABELD_CODE //+++++ REPLACE +++++
     local_notify_neighbour(neigh, LOCAL_ADD);
 #else // CEFBABELD
+    local_notify_neighbour(neigh, LOCAL_ADD);
     send_hello(ifp);
 #endif //----- REPLACE -----
     return neigh;
@@ -274,6 +304,10 @@ check_neighbours()
            timeval_minus_msec(&now, &neigh->hello.time) > 300000) {
             struct neighbour *old = neigh;
             neigh = neigh->next;
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+            USDT_PROBE3(neighbour_flush, old->address, old->ifp->ifindex,
+                        old->hello.reach);
+#endif //----- ADD for USDT -----
             flush_neighbour(old);
             continue;
         }
@@ -46,6 +46,29 @@ struct neighbour {
     struct timeval rtt_time;
     struct interface *ifp;
     struct buffered buf;
+#ifndef BABELD_CODE //+++++ ADD for DIGEST +++++
+    /* We have received a digest or a digest request from this neighbour. */
+    unsigned char digest;
+    /* Buckets of its last digest that we asked for (DIGEST_MAX_BUCKETS / 8
+       bytes), out of digest_nbuckets. */
+    unsigned char digest_requested[32];
+    unsigned short digest_nbuckets;
+#endif //----- ADD for DIGEST -----
+#ifndef BABELD_CODE //+++++ ADD for NAME COMPRESSION +++++
+    /* Capabilities from the last Hello (CAP_*). */
+    unsigned short caps;
+    /* The last Hello had HELLO_FLAG_CAPABILITIES. */
+    unsigned char caps_flag;
+    /* Reassembly of a name sent in Name Fragment TLVs. */
+    unsigned char *frag_name;
+    uint16_t frag_plen;
+    uint16_t frag_len;
+    unsigned char frag_tag;
+#endif //----- ADD for NAME COMPRESSION -----
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+    /* Bumped whenever neighbour_cost may have changed. */
+    unsigned int cost_epoch;
+#endif //----- ADD for COST EPOCH -----
 };
 
 extern struct neighbour *neighs;
@@ -53,6 +53,9 @@ THE SOFTWARE.
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+#include <stdio.h>
+#endif //----- ADD for REQUEST LIMIT -----
 #include <sys/socket.h>
 #include <netinet/in.h>
 
@@ -67,6 +70,161 @@ THE SOFTWARE.
 struct timeval resend_time = {0, 0};
 struct resend *to_resend = NULL;
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+/* Seqno requests are rate-limited per (router-id, prefix, interface):
+   after a request has been sent, the same request is suppressed for
+   an interval that doubles every time it is sent again, and resets once
+   the request is satisfied or has been quiet for a whole interval.
+   On top of that, every interface has a budget of requests per second. */
+
+#define REQUEST_LIMIT_BUCKETS 1024
+
+struct request_limit {
+    unsigned char id[8];
+    unsigned char *prefix;
+    uint16_t plen;
+    unsigned short interval;
+    struct interface *ifp;
+    struct timeval until;
+    struct request_limit *next;
+};
+
+static struct request_limit *request_limits[REQUEST_LIMIT_BUCKETS];
+int request_budget = REQUEST_BUDGET_DEFAULT;
+
+static unsigned int
+request_limit_hash(const unsigned char *prefix, uint16_t plen)
+{
+    return hash_prefix(prefix, plen) % REQUEST_LIMIT_BUCKETS;
+}
+
+static int
+request_budget_take(struct interface *ifp)
+{
+    unsigned ms;
+    int add;
+
+    if(request_budget <= 0)
+        return 1;
+
+    ms = timeval_minus_msec(&now, &ifp->request_refill);
+    if(ifp->request_refill.tv_sec == 0 || ms >= 1000) {
+        ifp->request_tokens = request_budget;
+        ifp->request_refill = now;
+    } else {
+        add = ms * request_budget / 1000;
+        if(add > 0) {
+            ifp->request_tokens = MIN(ifp->request_tokens + add,
+                                      request_budget);
+            timeval_add_msec(&ifp->request_refill, &ifp->request_refill,
+                             add * 1000 / request_budget);
+        }
+    }
+
+    if(ifp->request_tokens <= 0)
+        return 0;
+    ifp->request_tokens--;
+    return 1;
+}
+
+/* Decide whether a request may be sent on ifp, and account for it.
+   id is NULL for a plain request, which is only subject to the budget. */
+int
+request_allowed(struct interface *ifp,
+                const unsigned char *prefix, uint16_t plen,
+                const unsigned char *id)
+{
+    struct request_limit *limit = NULL;
+
+    if(id) {
+        unsigned int h = request_limit_hash(prefix, plen);
+        for(limit = request_limits[h]; limit; limit = limit->next) {
+            if(limit->ifp == ifp && limit->plen == plen &&
+               memcmp(limit->id, id, 8) == 0 &&
+               memcmp(limit->prefix, prefix, plen) == 0)
+                break;
+        }
+        if(limit && timeval_compare(&now, &limit->until) < 0) {
+            cefstat_suppressed_request_num++;
+            return 0;
+        }
+        if(limit == NULL) {
+            limit = calloc(1, sizeof(struct request_limit));
+            if(limit)
+                limit->prefix = malloc(MAX(plen, 1));
+            if(limit == NULL || limit->prefix == NULL) {
+                perror("malloc(request_limit)");
+                free(limit);
+                limit = NULL;
+            } else {
+                memcpy(limit->id, id, 8);
+                memcpy(limit->prefix, prefix, plen);
+                limit->plen = plen;
+                limit->ifp = ifp;
+                limit->interval = REQUEST_BACKOFF_MIN;
+                limit->next = request_limits[h];
+                request_limits[h] = limit;
+            }
+        } else if(timeval_minus_msec(&now, &limit->until) >= limit->interval) {
+            limit->interval = REQUEST_BACKOFF_MIN;
+        }
+    }
+
+    if(!request_budget_take(ifp)) {
+        cefstat_overbudget_request_num++;
+        return 0;
+    }
+
+    if(limit) {
+        timeval_add_msec(&limit->until, &now, limit->interval);
+        limit->interval = MIN(limit->interval * 2, REQUEST_BACKOFF_MAX);
+    }
+    cefstat_sent_request_num++;
+    return 1;
+}
+
+static void
+free_request_limit(struct request_limit **p)
+{
+    struct request_limit *limit = *p;
+    *p = limit->next;
+    free(limit->prefix);
+    free(limit);
+}
+
+/* A request for this prefix has been satisfied. */
+void
+release_request_limits(const unsigned char *prefix, uint16_t plen)
+{
+    struct request_limit **p;
+
+    p = &request_limits[request_limit_hash(prefix, plen)];
+    while(*p) {
+        if((*p)->plen == plen && memcmp((*p)->prefix, prefix, plen) == 0)
+            free_request_limit(p);
+        else
+            p = &(*p)->next;
+    }
+}
+
+void
+expire_request_limits()
+{
+    struct request_limit **p;
+    int i;
+
+    for(i = 0; i < REQUEST_LIMIT_BUCKETS; i++) {
+        p = &request_limits[i];
+        while(*p) {
+            if(timeval_minus_msec(&now, &(*p)->until) >= REQUEST_BACKOFF_MAX)
+                free_request_limit(p);
+            else
+                p = &(*p)->next;
+        }
+    }
+}
+#endif //----- ADD for REQUEST LIMIT -----
+
 static int
 resend_match(struct resend *resend,
 #ifdef BABELD_CODE //+++++ REPLACE +++++
@@ -306,6 +464,9 @@ satisfy_request(const unsigned char *prefix, uint16_t plen,
         request->max = 0;
         request->time.tv_sec = 0;
         recompute_resend_time();
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+        release_request_limits(prefix, plen);
+#endif //----- ADD for REQUEST LIMIT -----
         return 1;
     }
 
@@ -339,6 +500,9 @@ expire_resend()
     }
     if(recompute)
         recompute_resend_time();
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+    expire_request_limits();
+#endif //----- ADD for REQUEST LIMIT -----
 }
 
 void
@@ -76,6 +76,9 @@ struct resend {
 };
 
 extern struct timeval resend_time;
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+extern struct resend *to_resend;
+#endif //----- ADD for SNAPSHOT -----
 
 #ifdef BABELD_CODE //+++++ REPLACE +++++
 struct resend *find_request(const unsigned char *prefix, unsigned char plen,
@@ -117,6 +120,24 @@ int satisfy_request(const unsigned char *prefix, uint16_t plen,
                     unsigned short seqno, const unsigned char *id,
                     struct interface *ifp);
 
+#ifndef BABELD_CODE //+++++ ADD for REQUEST LIMIT +++++
+/* Backoff applied to repeated seqno requests for the same source. */
+#define REQUEST_BACKOFF_MIN 500
+#define REQUEST_BACKOFF_MAX 16000
+/* Default number of requests per second allowed on an interface.  Off by
+   default: requests over budget are dropped, and plain requests are never
+   resent, so a budget too small for a big table loses some for good. */
+#define REQUEST_BUDGET_DEFAULT 0
+
+extern int request_budget;
+
+int request_allowed(struct interface *ifp,
+                    const unsigned char *prefix, uint16_t plen,
+                    const unsigned char *id);
+void release_request_limits(const unsigned char *prefix, uint16_t plen);
+void expire_request_limits(void);
+#endif //----- ADD for REQUEST LIMIT -----
+
 void expire_resend(void);
 void recompute_resend_time(void);
 void do_resend(void);
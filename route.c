@@ -72,6 +72,12 @@ THE SOFTWARE.
 #ifndef BABELD_CODE //+++++ ADD +++++
 #include "cefore.h"
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+#include "trace.h"
+#endif //----- ADD for TRACE -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+#include "damping.h"
+#endif //----- ADD for DAMPING -----
 
 struct babel_route **routes = NULL;
 static int route_slots = 0, max_route_slots = 0;
@@ -79,6 +85,13 @@ int kernel_metric = 0, reflect_kernel_metric = 0;
 int allow_duplicates = -1;
 int diversity_kind = DIVERSITY_NONE;
 int diversity_factor = 256;     /* in units of 1/256 */
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+int switch_hysteresis = 0;      /* metric improvement that switches at once */
+int switch_dwell = 0;           /* seconds a smaller improvement must last */
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for WEIGHTED MULTIPATH +++++
+int fib_weights = 0;
+#endif //----- ADD for WEIGHTED MULTIPATH -----
 
 static int smoothing_half_life = 0;
 static int two_to_the_one_over_hl = 0; /* 2^(1/hl) * 0x10000 */
@@ -88,6 +101,35 @@ static struct best_route **bestroutes = NULL;
 static int bestroute_slots = 0, max_bestroute_slots = 0;
 #endif //----- ADD for MPMS -----
 
+#ifndef BABELD_CODE //+++++ ADD for BATCH SELECTION +++++
+/* A prefix that received updates during the current batch, together with
+   what was installed for it when the batch started. */
+struct dirty_prefix {
+    struct source *src;         /* any source of the prefix */
+    struct source *oldsrc;      /* source of the installed route, or NULL */
+    unsigned short oldmetric;
+    int next;
+};
+
+#define DIRTY_BUCKETS 64
+
+static int route_batch = 0;
+static struct dirty_prefix *dirty = NULL;
+static int num_dirty = 0, max_dirty = 0;
+static int dirty_hash[DIRTY_BUCKETS];
+
+static void mark_prefix_dirty(struct source *src);
+#endif //----- ADD for BATCH SELECTION -----
+
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+static void update_alternate(struct source *src);
+static void forget_alternate(struct babel_route *route);
+static void switch_routes(struct babel_route *old, struct babel_route *new);
+#endif //----- ADD for LFA -----
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+static void refresh_route_cost(struct babel_route *route);
+#endif //----- ADD for COST EPOCH -----
+
 #ifndef BABELD_CODE //+++++ ADD for MP +++++
 static struct babel_route * create_route_entry_mp(
              struct source *src, 
@@ -95,13 +137,19 @@ static struct babel_route * create_route_entry_mp(
              unsigned short interval,
              struct neighbour *neigh, const unsigned char *nexthop, unsigned short port, 
              const unsigned char *channels, int channels_len); 
-static void clear_route_entry_mp(struct babel_route *route);
 static void removeNbFromRoute_mp(
             const unsigned char *prefix, uint16_t plen,
             const unsigned char *src_prefix, unsigned char src_plen,
             struct neighbour *neigh, const unsigned char *nexthop);
 static int find_any_route_mp(const unsigned char *prefix, uint16_t plen,
            const unsigned char *src_prefix, unsigned char src_plen);
+static int remove_routes_mp(
+            const unsigned char *prefix, uint16_t plen,
+            const unsigned char *src_prefix, unsigned char src_plen,
+            int (*pred)(struct babel_route *, void *), void *closure);
+static int program_nexthops_mp(
+            const unsigned char *prefix, uint16_t plen,
+            const unsigned char *src_prefix, unsigned char src_plen);
 #endif //----- ADD for MP -----
 #ifndef BABELD_CODE //+++++ ADD for MPSS +++++
 static void clear_all_routes_mpss (const unsigned char *prefix, uint16_t plen,
@@ -122,6 +170,13 @@ static int isFassible_mpms(
             const unsigned char *prefix, uint16_t plen,
             const unsigned char *src_prefix, unsigned char src_plen);
 #endif //----- ADD for MPMS -----
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+static void bestroute_route_added(struct babel_route *route);
+static void bestroute_route_removed(struct babel_route *route);
+#endif //----- ADD for FD HEAP -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+static void damp_source(struct source *src);
+#endif //----- ADD for DAMPING -----
 
 static int
 check_specific_first(void)
@@ -326,6 +381,47 @@ installed_routes_estimate(void)
     return route_slots;
 }
 
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+/* Returns the number of routes, or of installed routes only. */
+int
+route_count(int installed_only)
+{
+    struct babel_route *r;
+    int i, n = 0;
+
+    for(i = 0; i < route_slots; i++) {
+        for(r = routes[i]; r; r = r->next) {
+            if(!installed_only || r->installed)
+                n++;
+        }
+    }
+    return n;
+}
+
+int
+bestroute_count(void)
+{
+    return bestroute_slots;
+}
+#endif //----- ADD for COUNTERS -----
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+/* First route of the slot following the given prefix, or of the first
+   slot if prefix is NULL.  Used to resume a dump where it stopped. */
+struct babel_route *
+route_slot_after(const unsigned char *prefix, uint16_t plen,
+                 const unsigned char *src_prefix, unsigned char src_plen)
+{
+    int i, n = 0;
+
+    if(prefix) {
+        i = find_route_slot(prefix, plen, src_prefix, src_plen, &n);
+        if(i >= 0)
+            n = i + 1;
+    }
+    return n < route_slots ? routes[n] : NULL;
+}
+#endif //----- ADD for PAGED DUMP -----
+
 static int
 resize_route_table(int new_slots)
 {
@@ -384,10 +480,63 @@ insert_route(struct babel_route *route)
 static void
 destroy_route(struct babel_route *route)
 {
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+    bestroute_route_removed(route);
+#endif //----- ADD for FD HEAP -----
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+    forget_alternate(route);
+#endif //----- ADD for LFA -----
     free(route->channels);
     free(route);
 }
 
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+/* For the installed route of a prefix, we keep the best feasible route
+   through another neighbour, so that losing the successor does not need
+   a scan of the routes, let alone a request.  Only used in single-path
+   mode: cefnetd has no notion of a standby nexthop, so the alternate is
+   installed when the successor goes away. */
+static int
+alternate_usable(struct babel_route *route)
+{
+    struct babel_route *alternate = route->alternate;
+
+    return alternate && !alternate->installed &&
+        alternate->neigh != route->neigh &&
+        route_metric(alternate) < INFINITY && route_feasible(alternate);
+}
+
+static void
+update_alternate(struct source *src)
+{
+    struct babel_route *installed;
+
+    if(route_ctrl_type != ROUTE_CTRL_TYPE_S)
+        return;
+    installed = find_installed_route(src->prefix, src->plen,
+                                     src->src_prefix, src->src_plen);
+    if(installed)
+        installed->alternate =
+            find_best_route(src->prefix, src->plen,
+                            src->src_prefix, src->src_plen,
+                            1, installed->neigh);
+}
+
+static void
+forget_alternate(struct babel_route *route)
+{
+    struct babel_route *installed;
+
+    if(route_ctrl_type != ROUTE_CTRL_TYPE_S || route->installed)
+        return;
+    installed = find_installed_route(route->src->prefix, route->src->plen,
+                                     route->src->src_prefix,
+                                     route->src->src_plen);
+    if(installed && installed->alternate == route)
+        installed->alternate = NULL;
+}
+#endif //----- ADD for LFA -----
+
 void
 flush_route(struct babel_route *route)
 {
@@ -405,6 +554,29 @@ flush_route(struct babel_route *route)
     oldmetric = route_metric(route);
     src = route->src;
 
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_route(CefC_Trace_Flush, route, 0,
+                route->installed ? CefC_Trace_Installed : 0);
+#endif //----- ADD for TRACE -----
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+    /* Within a batch, the replacement is selected in end_route_batch. */
+    if(route_batch && route_ctrl_type == ROUTE_CTRL_TYPE_S)
+        mark_prefix_dirty(src);
+#endif //----- ADD for BULK FLUSH -----
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+    /* Fail over to the precomputed alternate in a single switch, rather
+       than uninstalling and then looking for a replacement. */
+    if(route->installed && route_ctrl_type == ROUTE_CTRL_TYPE_S &&
+       !route_batch && alternate_usable(route)) {
+        struct babel_route *alternate = route->alternate;
+        switch_routes(route, alternate);
+        if(alternate->installed) {
+            cefstat_lfa_failover_num++;
+            send_triggered_update(alternate, src, oldmetric);
+        }
+    }
+#endif //----- ADD for LFA -----
+
     if(route->installed) {
         uninstall_route(route);
         lost = 1;
@@ -413,15 +585,13 @@ flush_route(struct babel_route *route)
     i = find_route_slot(route->src->prefix, route->src->plen,
                         route->src->src_prefix, route->src->src_plen, NULL);
     assert(i >= 0 && i < route_slots);
-#ifdef BABELD_CODE //+++++ REPLACE +++++
     local_notify_route(route, LOCAL_FLUSH);
-#else // CEFBABELD
-//    local_notify_route(route, LOCAL_FLUSH);
-#endif //----- REPLACE -----
     if(route == routes[i]) {
         routes[i] = route->next;
         route->next = NULL;
+#ifdef BABELD_CODE //+++++ DEL for LFA +++++
         destroy_route(route);
+#endif //----- DEL for LFA -----
 
         if(routes[i] == NULL) {
             if(i < route_slots - 1)
@@ -436,6 +606,11 @@ flush_route(struct babel_route *route)
             resize_route_table(0);
         else if(max_route_slots > 8 && route_slots < max_route_slots / 4)
             resize_route_table(max_route_slots / 2);
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+        /* destroy_route looks up the installed route, so the table must
+           not have an empty slot by then. */
+        destroy_route(route);
+#endif //----- ADD for LFA -----
     } else {
         struct babel_route *r = routes[i];
         while(r->next != route)
@@ -444,6 +619,9 @@ flush_route(struct babel_route *route)
         route->next = NULL;
         destroy_route(route);
     }
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    damp_source(src);
+#endif //----- ADD for DAMPING -----
 
 #ifdef BABELD_CODE //+++++ REPLACE for MP +++++
     if(lost)
@@ -451,14 +629,14 @@ flush_route(struct babel_route *route)
 #else // CEFBABELD
     if (route_ctrl_type == ROUTE_CTRL_TYPE_MS) {
         /// (MPSS-linkDisconnected)
-        debugf("linkDisconnected (%s) process for %s\n", ifname, format_cefore_prefix(src->prefix, src->plen));
+        debugf("linkDisconnected (%s) process for %s\n", ifname, source_uri(src));
         if(lost){
             int rc;
             rc = find_any_route_mp(src->prefix, src->plen, src->src_prefix, src->src_plen);
             if(rc == 0){
                 /// Send retract update if I have no feasible routes
                 debugf("Send retract update if I have no feasible routes (%s, INFINITY)\n", 
-                       format_cefore_prefix(src->prefix, src->plen));
+                       source_uri(src));
                 really_send_update_mp(NULL, src->id, src->prefix, src->plen, src->src_prefix, src->src_plen, 
                                       src->seqno, INFINITY, port);
             }
@@ -466,29 +644,33 @@ flush_route(struct babel_route *route)
         release_source(src);
     } else if (route_ctrl_type == ROUTE_CTRL_TYPE_MM) {
         /// (MPMS-linkDisconnected)
-        debugf("linkDisconnected (%s) process for %s\n", ifname, format_cefore_prefix(src->prefix, src->plen));
+        debugf("linkDisconnected (%s) process for %s\n", ifname, source_uri(src));
         if(lost){
             struct best_route *broute;
-            struct best_route last_bestroute;
+            unsigned int last_version;
+            unsigned char last_id[8];
+            unsigned short last_seqno;
             broute = find_bestroute(src->prefix, src->plen, src->src_prefix, src->src_plen, 0);
             if(broute){
-                memcpy(&last_bestroute, broute, sizeof(struct best_route));
+                last_version = broute->version;
+                memcpy(last_id, broute->my_sourceId, 8);
+                last_seqno = broute->my_seqNo;
                 release_source(src); /*** updateFeasibleDistance refers to route_ount,  ***/
                                      /*** so this function should be CALL at this time. ***/
                 broute = updateFeasibleDistance_mpms(src->prefix, src->plen, src->src_prefix, src->src_plen);
                 if (broute) {
-                    if(memcmp(&last_bestroute, broute, sizeof(struct best_route)) != 0){
+                    if(broute->version != last_version){
                         debugf("Send UPDATE(BestRoute) frefix=%s my_FD=%u \n",
-                               format_cefore_prefix(src->prefix, src->plen), broute->my_FD);
+                               source_uri(src), broute->my_FD);
                         send_update(NULL, 1, src->prefix, src->plen, src->src_prefix, src->src_plen);
                     }
                 	
                 }
             	else {
-                    really_send_update_mp(NULL, last_bestroute.my_sourceId,
-                                          last_bestroute.prefix, last_bestroute.plen,
-                                          last_bestroute.src_prefix, last_bestroute.src_plen,
-                                          last_bestroute.my_seqNo, 
+                    really_send_update_mp(NULL, last_id,
+                                          src->prefix, src->plen,
+                                          src->src_prefix, src->src_plen,
+                                          last_seqno,
 		                                  INFINITY, port);
                 }
             } else {
@@ -499,9 +681,16 @@ flush_route(struct babel_route *route)
             release_source(src);
         }
     } else {
-        if(lost){
+        if(route_batch){
+            /* Selected in end_route_batch. */
+        } else if(lost){
             route_lost(src, oldmetric);
         }
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+        else {
+            update_alternate(src);
+        }
+#endif //----- ADD for LFA -----
         release_source(src);
     }
 #endif //----- REPLACE for MP -----
@@ -528,10 +717,39 @@ flush_all_routes()
     check_sources_released();
 }
 
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+/* Losing a neighbour or an interface can take out a large part of the
+   table at once.  Rather than selecting, programming and advertising a
+   replacement after each route, the routes are all flushed first; each
+   affected prefix then gets one selection, the FIB requests go out to
+   cefnetd together, and the triggered updates and requests are queued
+   into the same round of buffered packets. */
+static void
+begin_bulk_flush(void)
+{
+    cefore_fib_defer_begin();
+    begin_route_batch();
+}
+
+static void
+end_bulk_flush(int n)
+{
+    end_route_batch();
+    cefore_fib_defer_end();
+    if(n > 0)
+        debugf("Flushed %d routes in bulk.\n", n);
+    cefstat_bulk_flush_num += n;
+}
+#endif //----- ADD for BULK FLUSH -----
+
 void
 flush_neighbour_routes(struct neighbour *neigh)
 {
     int i;
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+    int n = 0;
+    begin_bulk_flush();
+#endif //----- ADD for BULK FLUSH -----
 
     i = 0;
     while(i < route_slots) {
@@ -540,6 +758,9 @@ flush_neighbour_routes(struct neighbour *neigh)
         while(r) {
             if(r->neigh == neigh) {
                 flush_route(r);
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+                n++;
+#endif //----- ADD for BULK FLUSH -----
                 goto again;
             }
             r = r->next;
@@ -548,12 +769,19 @@ flush_neighbour_routes(struct neighbour *neigh)
     again:
         ;
     }
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+    end_bulk_flush(n);
+#endif //----- ADD for BULK FLUSH -----
 }
 
 void
 flush_interface_routes(struct interface *ifp, int v4only)
 {
     int i;
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+    int n = 0;
+    begin_bulk_flush();
+#endif //----- ADD for BULK FLUSH -----
 
     i = 0;
     while(i < route_slots) {
@@ -563,6 +791,9 @@ flush_interface_routes(struct interface *ifp, int v4only)
             if(r->neigh->ifp == ifp &&
                (!v4only || v4mapped(r->nexthop))) {
                 flush_route(r);
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+                n++;
+#endif //----- ADD for BULK FLUSH -----
                 goto again;
             }
             r = r->next;
@@ -571,6 +802,9 @@ flush_interface_routes(struct interface *ifp, int v4only)
     again:
         ;
     }
+#ifndef BABELD_CODE //+++++ ADD for BULK FLUSH +++++
+    end_bulk_flush(n);
+#endif //----- ADD for BULK FLUSH -----
 }
 
 struct route_stream {
@@ -675,6 +909,10 @@ install_route(struct babel_route *route)
 
     if(route->installed)
         return;
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+    USDT_PROBE3(install_route, route->src->prefix, route->src->plen,
+                route_metric(route));
+#endif //----- ADD for USDT -----
 
     if(!route_feasible(route))
         fprintf(stderr, "WARNING: installing unfeasible route "
@@ -711,14 +949,16 @@ fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_add_req_send(%s, nh:%s %d) ==
     }
 #endif //----- REPLACE -----
 
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+    route->alternate = NULL;
+#endif //----- ADD for LFA -----
     route->installed = 1;
     move_installed_route(route, i);
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_route(CefC_Trace_Install, route, 0, 0);
+#endif //----- ADD for TRACE -----
 
-#ifdef BABELD_CODE //+++++ REPLACE +++++
     local_notify_route(route, LOCAL_CHANGE);
-#else // CEFBABELD
-//    local_notify_route(route, LOCAL_CHANGE);
-#endif //----- REPLACE -----
 }
 
 void
@@ -727,7 +967,14 @@ uninstall_route(struct babel_route *route)
     if(!route->installed)
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+    USDT_PROBE3(uninstall_route, route->src->prefix, route->src->plen,
+                route_metric(route));
+#endif //----- ADD for USDT -----
     route->installed = 0;
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_route(CefC_Trace_Uninstall, route, 0, 0);
+#endif //----- ADD for TRACE -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
     kuninstall_route(route);
 
@@ -742,6 +989,8 @@ fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_req_send(%s, nh:%s) =====
     cefore_fib_del_req_send (
         route->src->prefix, route->src->plen, route->nexthop, route->port,
         route->neigh->ifp->name);
+
+    local_notify_route(route, LOCAL_CHANGE);
 #endif //----- REPLACE -----
 }
 
@@ -762,6 +1011,10 @@ switch_routes(struct babel_route *old, struct babel_route *new)
     if(!old->installed)
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+    USDT_PROBE4(switch_routes, new->src->prefix, new->src->plen,
+                route_metric(old), route_metric(new));
+#endif //----- ADD for USDT -----
     if(!route_feasible(new))
         fprintf(stderr, "WARNING: switching to unfeasible route "
                 "(this shouldn't happen).");
@@ -791,19 +1044,27 @@ fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_add_req_send(%s, nh:%s) =====
     if(rc < 0)
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+    new->switches = old->switches + 1;
+    new->held_switches = old->held_switches;
+    new->better_since = 0;
+    cefstat_route_switch_num++;
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+    old->alternate = NULL;
+    new->alternate = NULL;
+#endif //----- ADD for LFA -----
     old->installed = 0;
     new->installed = 1;
+#ifndef BABELD_CODE //+++++ ADD for TRACE +++++
+    trace_route(CefC_Trace_Switch, new, route_metric(old), 0);
+#endif //----- ADD for TRACE -----
     move_installed_route(new, find_route_slot(new->src->prefix, new->src->plen,
                                               new->src->src_prefix,
                                               new->src->src_plen,
                                               NULL));
-#ifdef BABELD_CODE //+++++ REPLACE +++++
     local_notify_route(old, LOCAL_CHANGE);
     local_notify_route(new, LOCAL_CHANGE);
-#else // CEFBABELD
-//    local_notify_route(old, LOCAL_CHANGE);
-//    local_notify_route(new, LOCAL_CHANGE);
-#endif //----- REPLACE -----
 }
 
 static void
@@ -835,16 +1096,18 @@ change_route_metric(struct babel_route *route,
     route->refmetric = refmetric;
     route->cost = cost;
     route->add_metric = add;
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+    route->cost_epoch = route->neigh->cost_epoch;
+#endif //----- ADD for COST EPOCH -----
 
     if(smoothing_half_life == 0) {
         route->smoothed_metric = route_metric(route);
         route->smoothed_metric_time = now.tv_sec;
     }
-#ifdef BABELD_CODE //+++++ REPLACE +++++
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+    bestroute_metric_changed(route);
+#endif //----- ADD for FD HEAP -----
     local_notify_route(route, LOCAL_CHANGE);
-#else // CEFBABELD
-//    local_notify_route(route, LOCAL_CHANGE);
-#endif //----- REPLACE -----
 }
 
 static void
@@ -1023,6 +1286,10 @@ find_best_route(const unsigned char *prefix, uint16_t plen,
     if(i < 0)
         return NULL;
 
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+    for(r = routes[i]; r; r = r->next)
+        refresh_route_cost(r);
+#endif //----- ADD for COST EPOCH -----
     route = routes[i];
     while(route && !route_acceptable(route, feasible, exclude))
         route = route->next;
@@ -1077,6 +1344,20 @@ update_route_metric(struct babel_route *route)
     }
 }
 
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+/* Bring up to date the cost of a route that update_neighbour_metric
+   skipped.  Nothing is announced: whoever looks at the route next
+   (find_best_route, expire_routes) acts on its new metric. */
+static void
+refresh_route_cost(struct babel_route *route)
+{
+    if(route->cost_epoch == route->neigh->cost_epoch)
+        return;
+    change_route_metric(route, route->refmetric,
+                        neighbour_cost(route->neigh), 0);
+}
+#endif //----- ADD for COST EPOCH -----
+
 /* Called whenever a neighbour's cost changes, to update the metric of
    all routes through that neighbour.  Calls local_notify_neighbour. */
 void
@@ -1086,20 +1367,33 @@ update_neighbour_metric(struct neighbour *neigh, int changed)
     if(changed) {
         int i;
 
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+        neigh->cost_epoch++;
+#endif //----- ADD for COST EPOCH -----
         for(i = 0; i < route_slots; i++) {
             struct babel_route *r = routes[i];
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+            /* The installed route, if any, is the first of its slot. */
+            struct babel_route *installed = r->installed ? r : NULL;
+#endif //----- ADD for COST EPOCH -----
             while(r) {
+#ifdef BABELD_CODE //+++++ REPLACE +++++
                 if(r->neigh == neigh)
                     update_route_metric(r);
+#else // CEFBABELD
+                /* In single-path mode, only the installed route and its
+                   alternate are read before the next selection; the
+                   others are refreshed lazily by find_best_route. */
+                if(r->neigh == neigh &&
+                   (route_ctrl_type != ROUTE_CTRL_TYPE_S || r == installed ||
+                    (installed && installed->alternate == r)))
+                    update_route_metric(r);
+#endif //----- REPLACE -----
                 r = r->next;
             }
         }
     }
-#ifdef BABELD_CODE //+++++ REPLACE +++++
     local_notify_neighbour(neigh, LOCAL_CHANGE);
-#else // CEFBABELD
-//    local_notify_neighbour(neigh, LOCAL_CHANGE);
-#endif //----- REPLACE -----
 }
 
 void
@@ -1147,6 +1441,7 @@ update_route(const unsigned char *id,
     if(memcmp(id, myid, 8) == 0)
         return NULL;
 #else // CEFBABELD
+    USDT_PROBE5(update_route, prefix, plen, seqno, refmetric, nexthop);
     if(memcmp(id, myid, 8) == 0) {
         debugf("Received Router-id is my ID.\n");
         return NULL;
@@ -1181,7 +1476,18 @@ update_route(const unsigned char *id,
     if(src == NULL)
         return NULL;
 
+#ifndef BABELD_CODE //+++++ ADD for BATCH SELECTION +++++
+    if(route_batch)
+        mark_prefix_dirty(src);
+#endif //----- ADD for BATCH SELECTION -----
+
     feasible = update_feasible(src, seqno, refmetric);
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+    if(feasible)
+        cefstat.update_accepted++;
+    else
+        cefstat.update_unfeasible++;
+#endif //----- ADD for COUNTERS -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
     metric = MIN((int)refmetric + neighbour_cost(neigh) + add_metric, INFINITY);
 #else // CEFBABELD
@@ -1206,7 +1512,7 @@ update_route(const unsigned char *id,
 #ifdef BABELD_CODE //+++++ REPLACE +++++
                    format_prefix(src->prefix, src->plen),
 #else // CEFBABELD
-                   format_cefore_prefix(src->prefix, src->plen),
+                   source_uri(src),
 #endif //----- REPLACE -----
                    format_eui64(route->src->id),
                    route->seqno, route->refmetric,
@@ -1251,6 +1557,7 @@ update_route(const unsigned char *id,
 #endif //----- REPLACE -----
         route->hold_time = hold_time;
 
+#ifdef BABELD_CODE //+++++ REPLACE +++++
         route_changed(route, oldsrc, oldmetric);
         if(!lost) {
             lost = oldinstalled &&
@@ -1260,6 +1567,19 @@ update_route(const unsigned char *id,
             route_lost(oldsrc, oldmetric);
         else if(!feasible)
             send_unfeasible_request(neigh, route_old(route), seqno, metric, src);
+#else // CEFBABELD
+        /* Within a batch, selection happens once in end_route_batch. */
+        if(!route_batch)
+            route_changed(route, oldsrc, oldmetric);
+        if(!lost) {
+            lost = oldinstalled &&
+                find_installed_route(prefix, plen, src_prefix, src_plen) == NULL;
+        }
+        if(lost && !route_batch)
+            route_lost(oldsrc, oldmetric);
+        else if(!lost && !feasible)
+            send_unfeasible_request(neigh, route_old(route), seqno, metric, src);
+#endif //----- REPLACE -----
         release_source(oldsrc);
     } else {
         struct babel_route *new_route;
@@ -1280,6 +1600,9 @@ update_route(const unsigned char *id,
         route->src = retain_source(src);
         route->refmetric = refmetric;
         route->cost = neighbour_cost(neigh);
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+        route->cost_epoch = neigh->cost_epoch;
+#endif //----- ADD for COST EPOCH -----
 #ifdef BABELD_CODE //+++++ REPLACE +++++
         route->add_metric = add_metric;
 #else // CEFBABELD
@@ -1310,13 +1633,15 @@ update_route(const unsigned char *id,
             destroy_route(route);
             return NULL;
         }
-#ifdef BABELD_CODE //+++++ REPLACE +++++
         local_notify_route(route, LOCAL_ADD);
+#ifdef BABELD_CODE //+++++ REPLACE +++++
+        consider_route(route);
 #else // CEFBABELD
-//        local_notify_route(route, LOCAL_ADD);
-
+        if(!route_batch) {
+            consider_route(route);
+            update_alternate(src);
+        }
 #endif //----- REPLACE -----
-        consider_route(route);
     }
     return route;
 }
@@ -1347,6 +1672,50 @@ send_unfeasible_request(struct neighbour *neigh, int force,
     }
 }
 
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+/* Switching successors costs a FIB delete and add, so a route that is
+   only slightly better than the installed one must stay better for
+   switch_dwell seconds before we switch to it.  With a zero dwell time,
+   it never is.  A challenger is counted as held once, when its hold
+   starts, however many updates arrive while it lasts. */
+static int
+switch_allowed(struct babel_route *installed, struct babel_route *route)
+{
+    if(route_metric(route) + switch_hysteresis <= route_metric(installed))
+        return 1;
+    if(route->better_since == 0) {
+        route->better_since = now.tv_sec;
+        installed->held_switches++;
+        cefstat_held_switch_num++;
+        return 0;
+    }
+    return switch_dwell > 0 &&
+        now.tv_sec - route->better_since >= switch_dwell;
+}
+
+/* One NUL-terminated line per installed route that has switched,
+   for the status socket.  Returns the number of bytes written. */
+int
+route_switch_status(char *buf, int len)
+{
+    int i, n, index = 0;
+
+    for(i = 0; i < route_slots; i++) {
+        struct babel_route *r = routes[i];
+        if(!r->installed || (r->switches == 0 && r->held_switches == 0))
+            continue;
+        n = snprintf(buf + index, len - index,
+                     "Switches %s : %u (held %u)",
+                     source_uri(r->src),
+                     r->switches, r->held_switches);
+        if(n < 0 || n + 1 > len - index)
+            return index;
+        index += n + 1;
+    }
+    return index;
+}
+#endif //----- ADD for HYSTERESIS -----
+
 /* This takes a feasible route and decides whether to install it.
    This uses the strong ordering, which is defined by sm <= sm' AND
    m <= m'.  This ordering is not total, which is what causes
@@ -1364,6 +1733,12 @@ consider_route(struct babel_route *route)
     if(!route_feasible(route))
         return;
 
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    /* A suppressed source is kept out of the FIB until it is reused. */
+    damp_source(route->src);
+    if(damping_suppressed(route->src))
+        return;
+#endif //----- ADD for DAMPING -----
     xroute = find_xroute(route->src->prefix, route->src->plen,
                          route->src->src_prefix, route->src->src_plen);
     if(xroute && (allow_duplicates < 0 || xroute->metric >= allow_duplicates))
@@ -1382,9 +1757,19 @@ consider_route(struct babel_route *route)
     if(route_metric(installed) >= INFINITY)
         goto install;
 
+#ifdef BABELD_CODE //+++++ REPLACE +++++
     if(route_metric(installed) >= route_metric(route) &&
        route_smoothed_metric(installed) > route_smoothed_metric(route))
         goto install;
+#else // CEFBABELD
+    if(route_metric(installed) >= route_metric(route) &&
+       route_smoothed_metric(installed) > route_smoothed_metric(route)) {
+        if(switch_allowed(installed, route))
+            goto install;
+        return;
+    }
+    route->better_since = 0;
+#endif //----- REPLACE -----
 
     return;
 
@@ -1480,6 +1865,11 @@ void
 route_changed(struct babel_route *route,
               struct source *oldsrc, unsigned short oldmetric)
 {
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    damp_source(route->src);
+    if(oldsrc != route->src)
+        damp_source(oldsrc);
+#endif //----- ADD for DAMPING -----
     if(route->installed) {
         struct babel_route *better_route;
         /* Do this unconditionally -- microoptimisation is not worth it. */
@@ -1499,6 +1889,9 @@ route_changed(struct babel_route *route,
            they may not have been feasible before. */
         consider_route(route);
     }
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+    update_alternate(route->src);
+#endif //----- ADD for LFA -----
 }
 
 /* We just lost the installed route to a given destination. */
@@ -1506,6 +1899,9 @@ void
 route_lost(struct source *src, unsigned oldmetric)
 {
     struct babel_route *new_route;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    damp_source(src);
+#endif //----- ADD for DAMPING -----
     new_route = find_best_route(src->prefix, src->plen,
                                 src->src_prefix, src->src_plen, 1, NULL);
     if(new_route) {
@@ -1524,7 +1920,173 @@ route_lost(struct source *src, unsigned oldmetric)
                                 src->seqno : seqno_plus(src->seqno, 1),
                                 src->id);
     }
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+    update_alternate(src);
+#endif //----- ADD for LFA -----
+}
+
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+/* Whether any of our routes from src still has a finite metric. */
+static int
+source_reachable(struct source *src)
+{
+    struct babel_route *route;
+    int i;
+
+    i = find_route_slot(src->prefix, src->plen,
+                        src->src_prefix, src->src_plen, NULL);
+    if(i < 0)
+        return 0;
+    for(route = routes[i]; route; route = route->next) {
+        if(route->src == src && route_metric(route) < INFINITY)
+            return 1;
+    }
+    return 0;
+}
+
+/* Called wherever the routes of src change; damping_update only charges
+   the source when it is withdrawn or comes back. */
+static void
+damp_source(struct source *src)
+{
+    if(flap_damping)
+        damping_update(src, source_reachable(src));
+}
+
+/* src is no longer suppressed: install or program its routes, which
+   consider_route and program_nexthops_mp skipped meanwhile, and
+   announce them again. */
+void
+route_reused(struct source *src)
+{
+    struct babel_route *route;
+
+    if(route_ctrl_type == ROUTE_CTRL_TYPE_S) {
+        route = find_best_route(src->prefix, src->plen,
+                                src->src_prefix, src->src_plen, 1, NULL);
+        if(route)
+            consider_route(route);
+    } else {
+        program_nexthops_mp(src->prefix, src->plen,
+                             src->src_prefix, src->src_plen);
+    }
+    send_update(NULL, 0, src->prefix, src->plen,
+                src->src_prefix, src->src_plen);
+}
+#endif //----- ADD for DAMPING -----
+
+#ifndef BABELD_CODE //+++++ ADD for BATCH SELECTION +++++
+/* Route selection is deferred while a batch is open: update_route only
+   records which prefixes changed, and end_route_batch then selects,
+   installs and advertises each of them once, however many updates the
+   batch carried for it.  Batches nest; only the outermost one selects. */
+void
+begin_route_batch(void)
+{
+    route_batch++;
+}
+
+static unsigned int
+dirty_hash_prefix(const unsigned char *prefix, uint16_t plen)
+{
+    return hash_prefix(prefix, plen) & (DIRTY_BUCKETS - 1);
+}
+
+/* Called before the first change to a prefix in this batch. */
+static void
+mark_prefix_dirty(struct source *src)
+{
+    struct babel_route *installed;
+    struct dirty_prefix *d;
+    unsigned int h;
+    int i;
+
+    if(num_dirty == 0)
+        memset(dirty_hash, -1, sizeof(dirty_hash));
+
+    h = dirty_hash_prefix(src->prefix, src->plen);
+    for(i = dirty_hash[h]; i >= 0; i = dirty[i].next) {
+        struct source *s = dirty[i].src;
+        if(s->plen == src->plen && s->src_plen == src->src_plen &&
+           memcmp(s->prefix, src->prefix, src->plen) == 0 &&
+           memcmp(s->src_prefix, src->src_prefix, 16) == 0)
+            return;
+    }
+
+    if(num_dirty >= max_dirty) {
+        struct dirty_prefix *new_dirty;
+        int n = max_dirty < 1 ? 16 : 2 * max_dirty;
+        new_dirty = realloc(dirty, n * sizeof(struct dirty_prefix));
+        if(new_dirty == NULL) {
+            perror("realloc(dirty)");
+            return;
+        }
+        dirty = new_dirty;
+        max_dirty = n;
+    }
+
+    installed = find_installed_route(src->prefix, src->plen,
+                                     src->src_prefix, src->src_plen);
+    d = &dirty[num_dirty];
+    d->src = retain_source(src);
+    d->oldsrc = installed ? retain_source(installed->src) : NULL;
+    d->oldmetric = installed ? route_metric(installed) : INFINITY;
+    d->next = dirty_hash[h];
+    dirty_hash[h] = num_dirty;
+    num_dirty++;
+}
+
+static void
+select_dirty_prefix(struct dirty_prefix *d)
+{
+    struct source *src = d->src;
+    struct babel_route *installed, *best;
+
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    if(flap_damping) {
+        struct source *s;
+        for(s = first_source_mp(src->prefix, src->plen,
+                                src->src_prefix, src->src_plen);
+            s; s = next_source_mp(s))
+            damp_source(s);
+    }
+#endif //----- ADD for DAMPING -----
+    installed = find_installed_route(src->prefix, src->plen,
+                                     src->src_prefix, src->src_plen);
+    best = find_best_route(src->prefix, src->plen,
+                           src->src_prefix, src->src_plen, 1, NULL);
+    if(best && best != installed &&
+       (installed == NULL || route_metric(best) < route_metric(installed)))
+        consider_route(best);
+
+    best = find_installed_route(src->prefix, src->plen,
+                                src->src_prefix, src->src_plen);
+    if(best) {
+        /* consider_route already advertised a switch. */
+        if(best == installed && d->oldsrc)
+            send_triggered_update(best, d->oldsrc, d->oldmetric);
+    } else if(d->oldsrc) {
+        route_lost(d->oldsrc, d->oldmetric);
+    }
+    update_alternate(src);
+}
+
+void
+end_route_batch(void)
+{
+    int i;
+
+    if(route_batch == 0 || --route_batch > 0)
+        return;
+    for(i = 0; i < num_dirty; i++) {
+        select_dirty_prefix(&dirty[i]);
+        release_source(dirty[i].src);
+        if(dirty[i].oldsrc)
+            release_source(dirty[i].oldsrc);
+    }
+    num_dirty = 0;
 }
+#endif //----- ADD for BATCH SELECTION -----
 
 /* This is called periodically to flush old routes.  It will also send
    requests for routes that are about to expire. */
@@ -1578,7 +2140,7 @@ void DEB_RPTIN_ROUTE_TABLE()
                     NULL : route->nexthop;
                 fprintf(stderr, "%s%s%s metric %d (%d) refmetric %d id %s "
                         "seqno %d age %d via %s neigh %s%s%s%s\n",
-                        format_cefore_prefix(route->src->prefix, route->src->plen),
+                        source_uri(route->src),
                         route->src->src_plen > 0 ? " from " : "",
                         route->src->src_plen > 0 ?
                         format_prefix(route->src->src_prefix, route->src->src_plen) : "",
@@ -1632,44 +2194,6 @@ exist_installed_route()
 /**************************************************************************************************/    
 /***** Multi Path Common Functions                                                            *****/
 /**************************************************************************************************/    
-static void
-clear_route_entry_mp(struct babel_route *route)
-{
-    int i;
-
-    i = find_route_slot(route->src->prefix, route->src->plen,
-                        route->src->src_prefix, route->src->src_plen, NULL);
-    assert(i >= 0 && i < route_slots);
-    if(route == routes[i]) {
-        routes[i] = route->next;
-        route->next = NULL;
-        release_source(route->src);
-        destroy_route(route);
-
-        if(routes[i] == NULL) {
-            if(i < route_slots - 1)
-                memmove(routes + i, routes + i + 1,
-                        (route_slots - i - 1) * sizeof(struct babel_route*));
-            routes[route_slots - 1] = NULL;
-            route_slots--;
-            VALGRIND_MAKE_MEM_UNDEFINED(routes + route_slots, sizeof(struct route *));
-        }
-
-        if(route_slots == 0)
-            resize_route_table(0);
-        else if(max_route_slots > 8 && route_slots < max_route_slots / 4)
-            resize_route_table(max_route_slots / 2);
-    } else {
-        struct babel_route *r = routes[i];
-        while(r->next != route)
-            r = r->next;
-        r->next = route->next;
-        route->next = NULL;
-        release_source(route->src);
-        destroy_route(route);
-    }
-}
-
 static struct babel_route *
 create_route_entry_mp(
              struct source *src, 
@@ -1687,10 +2211,16 @@ create_route_entry_mp(
             perror("malloc(route)");
             return NULL;
         }
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+        cefstat.update_accepted++;
+#endif //----- ADD for COUNTERS -----
 
         route->src = retain_source(src);
         route->refmetric = refmetric;
         route->cost = neighbour_cost(neigh);
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+        route->cost_epoch = neigh->cost_epoch;
+#endif //----- ADD for COST EPOCH -----
         route->add_metric = 0;
         route->seqno = seqno;
         route->neigh = neigh;
@@ -1709,6 +2239,9 @@ create_route_entry_mp(
             }
         }
         route->next = NULL;
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+        route->fd_index = -1;
+#endif //----- ADD for FD HEAP -----
         new_route = insert_route(route);
         if(new_route == NULL) {
             fprintf(stderr, "Couldn't insert route.\n");
@@ -1722,73 +2255,162 @@ create_route_entry_mp(
                                              new_route->src->src_prefix,
                                              new_route->src->src_plen,
                                              NULL));
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+        bestroute_route_added(new_route);
+#endif //----- ADD for FD HEAP -----
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+        local_notify_route(new_route, LOCAL_ADD);
+#endif //----- ADD for WATCH -----
 
     return route;
 }
-static void 
-removeNbFromRoute_mp(
+/* Bring cefnetd's nexthops for a prefix in line with our routes, in the
+   same batch as any FIB deletions already queued.  Each nexthop weighs
+   the inverse of its metric, so that the weights of a prefix add up to
+   about FIB_WEIGHT_TOTAL; a programmed nexthop is only updated when its
+   weight moves by more than an eighth.  Weights are only sent to cefnetd
+   with fib-weights, since the stock cefnetd does not understand them.
+   Returns -1 if cefnetd could not be reached. */
+static int
+program_nexthops_mp(
              const unsigned char *prefix, uint16_t plen,
-             const unsigned char *src_prefix, unsigned char src_plen,
-             struct neighbour *neigh, const unsigned char *nexthop)
+             const unsigned char *src_prefix, unsigned char src_plen)
 {
-    int i;
     struct babel_route *route;
+    unsigned long long sum = 0;
+    int i;
 
     i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
-    assert(i >= 0 && i < route_slots);
-    route = routes[i];
-    while(route) {
-        if(route->neigh == neigh && memcmp(route->nexthop, nexthop, 16) == 0) {
-            if(route == routes[i]) {
+    if(i >= 0) {
+        for(route = routes[i]; route; route = route->next) {
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            if(damping_suppressed(route->src))
+                continue;
+#endif //----- ADD for DAMPING -----
+            if(route_metric(route) < INFINITY)
+                sum += (1 << 20) / MAX(route_metric(route), 1);
+        }
+        for(route = routes[i]; route; route = route->next) {
+            int w, diff;
+            if(route_metric(route) >= INFINITY)
+                continue;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            /* Programmed by route_reused once the source is reused. */
+            if(damping_suppressed(route->src))
+                continue;
+#endif //----- ADD for DAMPING -----
+            w = (1 << 20) / MAX(route_metric(route), 1) *
+                (unsigned long long)FIB_WEIGHT_TOTAL / sum;
+            w = MAX(w, 1);
+            diff = w > route->fib_weight ?
+                w - route->fib_weight : route->fib_weight - w;
+            if(route->fib_weight != 0 &&
+               (!fib_weights || diff * 8 <= route->fib_weight))
+                continue;
 #ifdef CEFNETD_IF   //+++++ DEB for ROUTING +++++
-fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_req_send(%s, nh:%s) =====\n"
+fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_add_batch_add(%s, nh:%s w:%d) =====\n"
     , __FUNCTION__, __LINE__, format_cefore_prefix(route->src->prefix, route->src->plen)
-    , format_address(route->nexthop)
+    , format_address(route->nexthop), w
 );
 #endif              //----- DEB for ROUTING -----
-                /* Delete FIB */
-                cefore_fib_del_req_send (route->src->prefix, route->src->plen, route->nexthop, route->port,
-                                          route->neigh->ifp->name);
-                routes[i] = route->next;
-                route->next = NULL;
-                release_source(route->src);
-                destroy_route(route);
-
-                if(routes[i] == NULL) {
-                    if(i < route_slots - 1)
-                        memmove(routes + i, routes + i + 1,
-                                (route_slots - i - 1) * sizeof(struct babel_route*));
-                    routes[route_slots - 1] = NULL;
-                    route_slots--;
-                    VALGRIND_MAKE_MEM_UNDEFINED(routes + route_slots, sizeof(struct route *));
-                }
+            /* Add FIB */
+            cefore_fib_add_batch_add(route->src->prefix, route->src->plen,
+                                     route->nexthop, route->port,
+                                     route->neigh->ifp->name,
+                                     fib_weights ? w : -1);
+            route->fib_weight = w;
+        }
+    }
+    return cefore_fib_batch_send();
+}
 
-                if(route_slots == 0)
-                    resize_route_table(0);
-                else if(max_route_slots > 8 && route_slots < max_route_slots / 4)
-                    resize_route_table(max_route_slots / 2);
-            } else {
-                struct babel_route *r = routes[i];
-                while(r->next != route){
-                    r = r->next;
-                }
+/* Remove in a single pass every route of the slot for which pred holds
+   (every route if pred is NULL), and delete their FIB entries in the same
+   batch as the reweighting of the remaining nexthops.
+   Returns the number of routes removed. */
+static int
+remove_routes_mp(
+             const unsigned char *prefix, uint16_t plen,
+             const unsigned char *src_prefix, unsigned char src_plen,
+             int (*pred)(struct babel_route *, void *), void *closure)
+{
+    int i, n = 0;
+    struct babel_route **rp, *route;
+
+    i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
+    if(i < 0)
+        return 0;
+
+    rp = &routes[i];
+    while(*rp) {
+        route = *rp;
+        if(pred && !pred(route, closure)) {
+            rp = &route->next;
+            continue;
+        }
 #ifdef CEFNETD_IF   //+++++ DEB for ROUTING +++++
-fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_req_send(%s, nh:%s) =====\n"
+fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_batch_add(%s, nh:%s) =====\n"
     , __FUNCTION__, __LINE__, format_cefore_prefix(route->src->prefix, route->src->plen)
     , format_address(route->nexthop)
 );
 #endif              //----- DEB for ROUTING -----
-                /* Delete FIB */
-                cefore_fib_del_req_send (route->src->prefix, route->src->plen, route->nexthop, route->port,
-                                          route->neigh->ifp->name);
-                r->next = route->next;
-                route->next = NULL;
-                release_source(route->src);
-                destroy_route(route);
-            }
-        }
-        route = route->next;
+        /* Delete FIB (a nexthop kept out by damping was never added) */
+        if(route->fib_weight != 0)
+            cefore_fib_del_batch_add(route->src->prefix, route->src->plen,
+                                     route->nexthop, route->port,
+                                     route->neigh->ifp->name);
+#ifndef BABELD_CODE //+++++ ADD for WATCH +++++
+        local_notify_route(route, LOCAL_FLUSH);
+#endif //----- ADD for WATCH -----
+        *rp = route->next;
+        route->next = NULL;
+        release_source(route->src);
+        destroy_route(route);
+        n++;
+    }
+
+    if(routes[i] == NULL) {
+        if(i < route_slots - 1)
+            memmove(routes + i, routes + i + 1,
+                    (route_slots - i - 1) * sizeof(struct babel_route*));
+        routes[route_slots - 1] = NULL;
+        route_slots--;
+        VALGRIND_MAKE_MEM_UNDEFINED(routes + route_slots, sizeof(struct route *));
+
+        if(route_slots == 0)
+            resize_route_table(0);
+        else if(max_route_slots > 8 && route_slots < max_route_slots / 4)
+            resize_route_table(max_route_slots / 2);
     }
+
+    program_nexthops_mp(prefix, plen, src_prefix, src_plen);
+    return n;
+}
+struct nexthop_match {
+    struct neighbour *neigh;
+    const unsigned char *nexthop;
+};
+
+static int
+route_via_nexthop(struct babel_route *route, void *closure)
+{
+    struct nexthop_match *match = closure;
+    return route->neigh == match->neigh &&
+        memcmp(route->nexthop, match->nexthop, 16) == 0;
+}
+
+static void 
+removeNbFromRoute_mp(
+             const unsigned char *prefix, uint16_t plen,
+             const unsigned char *src_prefix, unsigned char src_plen,
+             struct neighbour *neigh, const unsigned char *nexthop)
+{
+    struct nexthop_match match;
+
+    match.neigh = neigh;
+    match.nexthop = nexthop;
+    remove_routes_mp(prefix, plen, src_prefix, src_plen,
+                     route_via_nexthop, &match);
 }
     
 static int 
@@ -1815,6 +2437,9 @@ send_unfeasible_request_mp(struct neighbour *neigh,
     struct babel_route *route = find_installed_route(src->prefix, src->plen,
                                                      src->src_prefix,
                                                      src->src_plen);
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+    cefstat.update_unfeasible++;
+#endif //----- ADD for COUNTERS -----
     if(!route) {
         send_unicast_multihop_request(neigh, src->prefix, src->plen,
                                       src->src_prefix, src->src_plen,
@@ -1874,7 +2499,13 @@ update_route_mpss(const unsigned char *id,
     int rc;
     unsigned short my_FD;
     struct xroute *xroute;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    struct damping *damping = NULL;
+#endif //----- ADD for DAMPING -----
     
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+    USDT_PROBE5(update_route_mpss, prefix, plen, seqno, refmetric, nexthop);
+#endif //----- ADD for USDT -----
     if(memcmp(id, myid, 8) == 0) {
         debugf("Received Router-id is my ID.\n");
         return;
@@ -1918,6 +2549,9 @@ BEGIN:;
 fprintf(stderr, "MPSS-[%s]: ----- Create Source entry -----\n", __FUNCTION__);
 #endif
             src = find_source(id, prefix, plen, src_prefix, src_plen, 1, seqno);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            damping_attach(src, damping);
+#endif //----- ADD for DAMPING -----
             if(src == NULL) {
                 return;
             }
@@ -1928,10 +2562,13 @@ fprintf(stderr, "MPSS-[%s]: ----- Create Source entry -----\n", __FUNCTION__);
             new_route = create_route_entry_mp(src, seqno, refmetric,
                                            interval, neigh, nexthop, port, 
                                            channels, channels_len);
+            if(new_route == NULL)
+                return;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            damp_source(src);
+#endif //----- ADD for DAMPING -----
             /* Add FIB */
-            rc = cefore_fib_add_req_send (
-                        new_route->src->prefix, new_route->src->plen, new_route->nexthop, new_route->port,
-                        new_route->neigh->ifp->name);
+            rc = program_nexthops_mp(prefix, plen, src_prefix, src_plen);
             if(rc < 0) {
                 return;
             }
@@ -1950,6 +2587,9 @@ fprintf(stderr, "MPSS-[%s]: ----- Create Source entry -----\n", __FUNCTION__);
         if(refmetric == INFINITY) {
             return;
         }
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+        damping = damping_detach(src);
+#endif //----- ADD for DAMPING -----
         delete_source_mp(src);
         goto BEGIN;
     }
@@ -1963,6 +2603,9 @@ fprintf(stderr, "MPSS-[%s]: ----- Create Source entry -----\n", __FUNCTION__);
                format_address(nexthop), port);
         if(route) {
             removeNbFromRoute_mp(prefix, plen, src_prefix, src_plen, neigh, nexthop);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            damp_source(src);
+#endif //----- ADD for DAMPING -----
             rc = find_any_route_mp(prefix, plen, src_prefix, src_plen);
             if(rc == 0){
                 /// Send retract update if I have no feasible routes
@@ -1987,15 +2630,23 @@ fprintf(stderr, "MPSS--[%s]: ----- my_FD=%u, rcvd_metric+lc=%u -----\n"
         if(route) {
             change_route_metric(route, refmetric, neighbour_cost(neigh), 0);
             route->time = now.tv_sec;
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+            cefstat.update_accepted++;
+#endif //----- ADD for COUNTERS -----
+            if(fib_weights)
+                program_nexthops_mp(prefix, plen, src_prefix, src_plen);
         } else {
             /* Create Route Entry */
             new_route = create_route_entry_mp(src, seqno, refmetric,
                                            interval, neigh, nexthop, port, 
                                            channels, channels_len);
+            if(new_route == NULL)
+                return;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            damp_source(src);
+#endif //----- ADD for DAMPING -----
             /* Add FIB */
-            rc = cefore_fib_add_req_send (
-                        new_route->src->prefix, new_route->src->plen, new_route->nexthop, new_route->port,
-                        new_route->neigh->ifp->name);
+            rc = program_nexthops_mp(prefix, plen, src_prefix, src_plen);
             if(rc < 0) {
                 return;
             } 
@@ -2052,30 +2703,15 @@ clear_all_routes_mpss (const unsigned char *prefix, uint16_t plen,
                    const unsigned char *src_prefix, unsigned char src_plen)
 {
     struct babel_route *route;
-    while(1) {
-        int i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
-        if(i < 0)
-            break;
-        route = routes[i];
-        /// Send retract update if I have no feasible route
-        really_send_update_mp(NULL, route->src->id, 
-                        route->src->prefix, route->src->plen, route->src->src_prefix, route->src->src_plen,
-                        route->src->seqno, INFINITY, cefore_portnum);
-        while(route) {
-#ifdef CEFNETD_IF   //+++++ DEB for ROUTING +++++
-fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_req_send(%s, nh:%s) =====\n"
-    , __FUNCTION__, __LINE__, format_cefore_prefix(route->src->prefix, route->src->plen)
-    , format_address(route->nexthop)
-);
-#endif              //----- DEB for ROUTING -----
-            /* Delete FIB */
-             cefore_fib_del_req_send (
-                        route->src->prefix, route->src->plen, route->nexthop, route->port,
-                        route->neigh->ifp->name);
-            clear_route_entry_mp(route);
-        	break;
-        }
-    }
+    int i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
+    if(i < 0)
+        return;
+    route = routes[i];
+    /// Send retract update if I have no feasible route
+    really_send_update_mp(NULL, route->src->id, 
+                    route->src->prefix, route->src->plen, route->src->src_prefix, route->src->src_plen,
+                    route->src->seqno, INFINITY, cefore_portnum);
+    remove_routes_mp(prefix, plen, src_prefix, src_plen, NULL, NULL);
 }   
     
 #endif //----- ADD for MPSS -----
@@ -2100,6 +2736,12 @@ update_route_mpms(const unsigned char *id,
     struct best_route *broute;
     int rc;
     struct xroute *xroute;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    struct damping *damping = NULL;
+#endif //----- ADD for DAMPING -----
+#ifndef BABELD_CODE //+++++ ADD for USDT +++++
+    USDT_PROBE5(update_route_mpms, prefix, plen, seqno, refmetric, nexthop);
+#endif //----- ADD for USDT -----
     if(memcmp(id, myid, 8) == 0) {
         debugf("Received Router-id is my ID.\n");
         return;
@@ -2139,6 +2781,10 @@ BEGIN:;
             if(!src) {
                 /* Create Source Entry (If entry does not exist, entry is created) */
                 src = find_source(id, prefix, plen, src_prefix, src_plen, 1, seqno);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+                damping_attach(src, damping);
+                damping = NULL;
+#endif //----- ADD for DAMPING -----
                 if(!src) {
                     return;
                 }
@@ -2147,10 +2793,13 @@ BEGIN:;
             new_route = create_route_entry_mp(src, seqno, refmetric,
                                            interval, neigh, nexthop, port, 
                                            channels, channels_len);
+            if(new_route == NULL)
+                return;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            damp_source(src);
+#endif //----- ADD for DAMPING -----
             /* Add FIB */
-            rc = cefore_fib_add_req_send (
-                        new_route->src->prefix, new_route->src->plen, new_route->nexthop, new_route->port,
-                        new_route->neigh->ifp->name);
+            rc = program_nexthops_mp(prefix, plen, src_prefix, src_plen);
             if(rc < 0) {
                 return;
             } 
@@ -2170,27 +2819,37 @@ fprintf(stderr, "MPMS-[%s]: ----- Create Best Route entry -----\n", __FUNCTION__
     }
     
     if (refmetric == INFINITY) {  /// Remove retracted route (same as Babel)
-        struct best_route last_bestroute;
+        unsigned int last_version;
+        unsigned char last_id[8];
+        unsigned short last_seqno;
         route = find_route(prefix, plen, src_prefix, src_plen, neigh, nexthop);
         if(route) {
             broute = find_bestroute(prefix, plen, src_prefix, src_plen, 0);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            src = route->src;
+#endif //----- ADD for DAMPING -----
             removeNbFromRoute_mp(prefix, plen, src_prefix, src_plen, neigh, nexthop);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+            damp_source(src);
+#endif //----- ADD for DAMPING -----
             if(broute){
-                memcpy(&last_bestroute, broute, sizeof(struct best_route));
+                last_version = broute->version;
+                memcpy(last_id, broute->my_sourceId, 8);
+                last_seqno = broute->my_seqNo;
             } else {
                 return;
             }
             broute = updateFeasibleDistance_mpms(prefix, plen, src_prefix, src_plen);
             if (broute){
-                if(memcmp(&last_bestroute, broute, sizeof(struct best_route)) != 0){
+                if(broute->version != last_version){
                     send_update(NULL, 1, prefix, plen, src_prefix, src_plen);
                 }
             }
         	else {
-                really_send_update_mp(NULL, last_bestroute.my_sourceId,
-                                      last_bestroute.prefix, last_bestroute.plen,
-                                      last_bestroute.src_prefix, last_bestroute.src_plen,
-                                      last_bestroute.my_seqNo, 
+                really_send_update_mp(NULL, last_id,
+                                      prefix, plen,
+                                      src_prefix, src_plen,
+                                      last_seqno,
 		                              INFINITY, port);
             }
         }
@@ -2205,9 +2864,16 @@ fprintf(stderr, "MPMS-[%s]: ----- Create Best Route entry -----\n", __FUNCTION__
     if(!src) {
         /* Create Source Entry (If entry does not exist, entry is created) */
         src = find_source(id, prefix, plen, src_prefix, src_plen, 1, seqno);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+        damping_attach(src, damping);
+        damping = NULL;
+#endif //----- ADD for DAMPING -----
     } else if (seqno_compare(seqno, src->seqno) > 0) {
         removeOldRoutes_mpms(prefix, plen, src_prefix, src_plen, id);
         delete_bestroute_entry(prefix, plen, src_prefix, src_plen);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+        damping = damping_detach(src);
+#endif //----- ADD for DAMPING -----
         delete_source_mp(src);
         goto BEGIN;
     }
@@ -2224,6 +2890,11 @@ fprintf(stderr, "MPMS-[%s]: ----- Create Best Route entry -----\n", __FUNCTION__
     if(route && route->src == src) {
         change_route_metric(route, refmetric, neighbour_cost(neigh), 0);
         route->time = now.tv_sec;
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+        cefstat.update_accepted++;
+#endif //----- ADD for COUNTERS -----
+        if(fib_weights)
+            program_nexthops_mp(prefix, plen, src_prefix, src_plen);
     } else {
         if(route){
             removeNbFromRoute_mp(prefix, plen, src_prefix, src_plen, neigh, nexthop);
@@ -2232,35 +2903,41 @@ fprintf(stderr, "MPMS-[%s]: ----- Create Best Route entry -----\n", __FUNCTION__
         new_route = create_route_entry_mp(src, seqno, refmetric,
                                        interval, neigh, nexthop, port, 
                                        channels, channels_len);
+        if(new_route == NULL)
+            return;
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+        damp_source(src);
+#endif //----- ADD for DAMPING -----
         /* Add FIB */
-        rc = cefore_fib_add_req_send (
-                        new_route->src->prefix, new_route->src->plen, 
-                        new_route->nexthop, new_route->port,
-                        new_route->neigh->ifp->name);
+        rc = program_nexthops_mp(prefix, plen, src_prefix, src_plen);
         if(rc < 0) {
             return;
         } 
     }
     
     {
-        struct best_route last_bestroute;
+        unsigned int last_version;
+        unsigned char last_id[8];
+        unsigned short last_seqno;
         broute = find_bestroute(prefix, plen, src_prefix, src_plen, 0);
         if(!broute) {
             return;
         }
-        memcpy(&last_bestroute, broute, sizeof(struct best_route));
+        last_version = broute->version;
+        memcpy(last_id, broute->my_sourceId, 8);
+        last_seqno = broute->my_seqNo;
         broute = updateFeasibleDistance_mpms(prefix, plen, src_prefix, src_plen);
         if(broute){
             removeInfeasble_mpms(prefix, plen, src_prefix, src_plen, broute->my_FD);
-            if (memcmp(&last_bestroute, broute, sizeof(struct best_route)) != 0) {
+            if (broute->version != last_version) {
                 send_update(NULL, 1, prefix, plen, src_prefix, src_plen);
             }
         }
        	else {
-            really_send_update_mp(NULL, last_bestroute.my_sourceId,
-                                  last_bestroute.prefix, last_bestroute.plen,
-                                  last_bestroute.src_prefix, last_bestroute.src_plen,
-                                  last_bestroute.my_seqNo, 
+            really_send_update_mp(NULL, last_id,
+                                  prefix, plen,
+                                  src_prefix, src_plen,
+                                  last_seqno,
 	                              INFINITY, port);
         }
     	
@@ -2291,6 +2968,131 @@ find_route_assoc_broute(struct best_route* broute,
     }
     return NULL;
 }
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+/* Each best route keeps the routes of its prefix in a binary min-heap
+   ordered like updateFeasibleDistance_mpms picks the feasible distance,
+   and every route knows its position in the heap.  Inserting, removing
+   or changing the metric of a route then costs O(log n) in the number of
+   nexthops, and reading the feasible distance costs nothing. */
+static int
+fd_compare(const struct babel_route *a, const struct babel_route *b)
+{
+    int fa = MIN((int)a->refmetric + a->cost, INFINITY);
+    int fb = MIN((int)b->refmetric + b->cost, INFINITY);
+
+    if(fa != fb)
+        return fa < fb ? -1 : 1;
+    return memcmp(a->src->id, b->src->id, 8);
+}
+
+static void
+fd_heap_set(struct best_route *broute, int i, struct babel_route *route)
+{
+    broute->fd_heap[i] = route;
+    route->fd_index = i;
+}
+
+/* Move the route at position i up or down to where it belongs. */
+static void
+fd_heap_sift(struct best_route *broute, int i)
+{
+    struct babel_route *route = broute->fd_heap[i];
+    int c;
+
+    while(i > 0 && fd_compare(route, broute->fd_heap[(i - 1) / 2]) < 0) {
+        fd_heap_set(broute, i, broute->fd_heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    while(1) {
+        c = 2 * i + 1;
+        if(c >= broute->fd_heap_len)
+            break;
+        if(c + 1 < broute->fd_heap_len &&
+           fd_compare(broute->fd_heap[c + 1], broute->fd_heap[c]) < 0)
+            c++;
+        if(fd_compare(broute->fd_heap[c], route) >= 0)
+            break;
+        fd_heap_set(broute, i, broute->fd_heap[c]);
+        i = c;
+    }
+    fd_heap_set(broute, i, route);
+}
+
+static int
+fd_heap_member(const struct best_route *broute,
+               const struct babel_route *route)
+{
+    return route->fd_index >= 0 && route->fd_index < broute->fd_heap_len &&
+        broute->fd_heap[route->fd_index] == route;
+}
+
+static void
+fd_heap_insert(struct best_route *broute, struct babel_route *route)
+{
+    if(broute->fd_heap_len >= broute->fd_heap_size) {
+        struct babel_route **new_heap;
+        int n = broute->fd_heap_size < 1 ? 4 : 2 * broute->fd_heap_size;
+        new_heap = realloc(broute->fd_heap, n * sizeof(struct babel_route*));
+        if(new_heap == NULL) {
+            perror("realloc(fd_heap)");
+            return;
+        }
+        broute->fd_heap = new_heap;
+        broute->fd_heap_size = n;
+    }
+    fd_heap_set(broute, broute->fd_heap_len, route);
+    broute->fd_heap_len++;
+    fd_heap_sift(broute, broute->fd_heap_len - 1);
+}
+
+static void
+fd_heap_remove(struct best_route *broute, struct babel_route *route)
+{
+    int i = route->fd_index;
+
+    broute->fd_heap_len--;
+    if(i < broute->fd_heap_len) {
+        fd_heap_set(broute, i, broute->fd_heap[broute->fd_heap_len]);
+        fd_heap_sift(broute, i);
+    }
+    route->fd_index = -1;
+}
+
+static struct best_route *
+route_bestroute(const struct babel_route *route)
+{
+    if(route_ctrl_type != ROUTE_CTRL_TYPE_MM)
+        return NULL;
+    return find_bestroute(route->src->prefix, route->src->plen,
+                          route->src->src_prefix, route->src->src_plen, 0);
+}
+
+static void
+bestroute_route_added(struct babel_route *route)
+{
+    struct best_route *broute = route_bestroute(route);
+    if(broute && !fd_heap_member(broute, route))
+        fd_heap_insert(broute, route);
+}
+
+static void
+bestroute_route_removed(struct babel_route *route)
+{
+    struct best_route *broute = route_bestroute(route);
+    if(broute && fd_heap_member(broute, route))
+        fd_heap_remove(broute, route);
+}
+
+/* Must be called whenever refmetric or cost of a route changes. */
+void
+bestroute_metric_changed(struct babel_route *route)
+{
+    struct best_route *broute = route_bestroute(route);
+    if(broute && fd_heap_member(broute, route))
+        fd_heap_sift(broute, route->fd_index);
+}
+#endif //----- ADD for FD HEAP -----
+
 struct best_route*
 find_bestroute(const unsigned char *prefix, uint16_t plen,
                const unsigned char *src_prefix, unsigned char src_plen,
@@ -2328,6 +3130,16 @@ find_bestroute(const unsigned char *prefix, uint16_t plen,
     bestroute_slots++;
     bestroutes[n] = broute;
 
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+    /* Routes may already be there, e.g. the one we are creating this for. */
+    n = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
+    if(n >= 0) {
+        struct babel_route *route;
+        for(route = routes[n]; route; route = route->next)
+            fd_heap_insert(broute, route);
+    }
+#endif //----- ADD for FD HEAP -----
+
     return broute;
 }
 struct best_route *
@@ -2336,37 +3148,16 @@ updateFeasibleDistance_mpms(
              const unsigned char *src_prefix, unsigned char src_plen)
 {
     unsigned short my_FD = INFINITY;
-    unsigned char my_sourceId[8];
-    unsigned short my_seqNo=0;
-    int i;
-    unsigned short fd;
-    struct babel_route *route;
-    struct best_route *broute=NULL;
+    struct babel_route *route = NULL;
+    struct best_route *broute;
     int rc;
-	memset(my_sourceId, 0xFF, 8);
-
-    i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
-
-    if(i < 0){
-        rc = exist_source_mp(prefix, plen, src_prefix, src_plen);
-        if(!rc){
-            delete_bestroute_entry(prefix, plen, src_prefix, src_plen);
-        }
-        return NULL;
-    } 
 
-    route = routes[i];
-
-    while(route) {
-        fd = MIN((int)route->refmetric + route->cost, INFINITY);
-        if ((fd < my_FD) /// my_FD = minimum (metric+linkcost) & smallest sourceId
-              ||
-            ((fd == my_FD) && (memcmp(my_sourceId, route->src->id, 8) > 0))){
-            my_FD = fd;
-            memcpy(my_sourceId, route->src->id, 8);
-            my_seqNo = route->src->seqno;
-        }
-        route = route->next;
+    /* my_FD = minimum (metric+linkcost) & smallest sourceId,
+       which is the top of the FD heap. */
+    broute = find_bestroute(prefix, plen, src_prefix, src_plen, 0);
+    if(broute && broute->fd_heap_len > 0) {
+        route = broute->fd_heap[0];
+        my_FD = MIN((int)route->refmetric + route->cost, INFINITY);
     }
     if(my_FD == INFINITY) {
         rc = exist_source_mp(prefix, plen, src_prefix, src_plen);
@@ -2375,33 +3166,43 @@ updateFeasibleDistance_mpms(
         }
         return NULL;
     }
-    if(my_FD < INFINITY){
-        broute = find_bestroute(prefix, plen, src_prefix, src_plen, 0);
-        if(broute){
-            broute->my_FD = my_FD;
-            memcpy(broute->my_sourceId, my_sourceId, 8);
-            broute->my_seqNo = my_seqNo;
-        }
+    if(broute->my_FD != my_FD ||
+       memcmp(broute->my_sourceId, route->src->id, 8) != 0 ||
+       broute->my_seqNo != route->src->seqno) {
+        broute->my_FD = my_FD;
+        memcpy(broute->my_sourceId, route->src->id, 8);
+        broute->my_seqNo = route->src->seqno;
+        broute->version++;
     }
     return broute;
 }
+void dump_bestroute_entry(FILE *out, const struct best_route *broute)
+{
+    fprintf(out, "%s%s%s my_sourceId=%s my_seqNo=%u my_FD=%u\n",
+            format_cefore_prefix(broute->prefix, broute->plen),
+            broute->src_plen > 0 ? " from " : "",
+            broute->src_plen > 0 ?
+            format_prefix(broute->src_prefix, broute->src_plen) : "",
+            format_eui64(broute->my_sourceId),
+            broute->my_seqNo, broute->my_FD);
+}
+
 void dump_best_route(FILE *out)
 {
     int i;
-    struct best_route *broute;
 
     fprintf(out, "----- bestroutes -----\n");
     
-    for(i=0; i < bestroute_slots; i++) {
-        broute = bestroutes[i];
-        fprintf(out, "%s%s%s my_sourceId=%s my_seqNo=%u my_FD=%u\n",
-                format_cefore_prefix(broute->prefix, broute->plen),
-                broute->src_plen > 0 ? " from " : "",
-                broute->src_plen > 0 ?
-                format_prefix(broute->src_prefix, broute->src_plen) : "",
-                format_eui64(broute->my_sourceId),
-                broute->my_seqNo, broute->my_FD);
-    }
+    for(i=0; i < bestroute_slots; i++)
+        dump_bestroute_entry(out, bestroutes[i]);
+}
+
+static int
+route_infeasible_mpms(struct babel_route *route, void *closure)
+{
+    return !isFassible_mpms(route->refmetric, route->neigh,
+                            route->src->prefix, route->src->plen,
+                            route->src->src_prefix, route->src->src_plen);
 }
 
 static void
@@ -2410,44 +3211,8 @@ removeInfeasble_mpms(
             const unsigned char *src_prefix, unsigned char src_plen,
             unsigned short my_fd)
 {
-                
-    struct babel_route *route;
-	int rcdnum;
-    while(1) {
-        int i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
-        if(i < 0){
-            break;
-        }
-        route = routes[i];
-	    rcdnum = 0;
-        do {
-    	    rcdnum++;
-    	    route = route->next;
-	    } while (route != NULL);
-        route = routes[i];
-        while(route) {
-    	    rcdnum--;
-            if(!isFassible_mpms(route->refmetric, route->neigh, prefix, plen, src_prefix, src_plen)){
-#ifdef CEFNETD_IF   //+++++ DEB for ROUTING +++++
-fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_req_send(%s, nh:%s) =====\n"
-    , __FUNCTION__, __LINE__, format_cefore_prefix(route->src->prefix, route->src->plen)
-    , format_address(route->nexthop)
-);
-#endif              //----- DEB for ROUTING -----
-                /* Delete FIB */
-                cefore_fib_del_req_send (
-                            route->src->prefix, route->src->plen, route->nexthop, route->port,
-                            route->neigh->ifp->name);
-                clear_route_entry_mp(route);
-                break;
-            } else {
-                route = route->next;
-            }
-        }
-	    if (rcdnum==0){
-		    break;
-	    }
-    }
+    remove_routes_mp(prefix, plen, src_prefix, src_plen,
+                     route_infeasible_mpms, NULL);
 }
 static int
 bestroute_compare(
@@ -2512,6 +3277,32 @@ find_bestroute_slot(
     return -1;
 }
 
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+/* Best route following the given prefix, or the first one if prefix
+   is NULL. */
+struct best_route *
+bestroute_after(const unsigned char *prefix, uint16_t plen,
+                const unsigned char *src_prefix, unsigned char src_plen)
+{
+    int i, n = 0;
+
+    if(prefix) {
+        i = find_bestroute_slot(prefix, plen, src_prefix, src_plen, &n);
+        if(i >= 0)
+            n = i + 1;
+    }
+    return n < bestroute_slots ? bestroutes[n] : NULL;
+}
+#endif //----- ADD for PAGED DUMP -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+/* Best route in the given slot of the table, for walking it in order. */
+struct best_route *
+bestroute_slot(int i)
+{
+    return i >= 0 && i < bestroute_slots ? bestroutes[i] : NULL;
+}
+#endif //----- ADD for SNAPSHOT -----
+
 static int
 resize_bestroute_table(int new_slots)
 {
@@ -2544,6 +3335,12 @@ delete_bestroute_entry(
         struct best_route *broute = bestroutes[i];
         c = bestroute_compare(prefix, plen, src_prefix, src_plen, broute);
         if(c == 0) {
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+            int k;
+            for(k = 0; k < broute->fd_heap_len; k++)
+                broute->fd_heap[k]->fd_index = -1;
+            free(broute->fd_heap);
+#endif //----- ADD for FD HEAP -----
             free(broute);
             bestroutes[i] = NULL;
             i++;
@@ -2582,74 +3379,26 @@ isFassible_mpms(
     
     return 0;
 }
+static int
+route_from_source_id(struct babel_route *route, void *closure)
+{
+    return memcmp(route->src->id, closure, 8) == 0;
+}
+
 void
 removeOldRoutes_mpms(
                 const unsigned char *prefix, uint16_t plen,
                 const unsigned char *src_prefix, unsigned char src_plen,
                 const unsigned char *id)
 {
-    struct babel_route *route;
-	int rcdnum;
-    while(1) {
-        int i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
-        if(i < 0)
-            break;
-        route = routes[i];
-	    rcdnum = 0;
-        do {
-    	    rcdnum++;
-    	    route = route->next;
-	    } while (route != NULL);
-        route = routes[i];
-        while(route) {
-        	rcdnum--;
-            if(memcmp(route->src->id, id, 8) == 0){
-#ifdef CEFNETD_IF   //+++++ DEB for ROUTING +++++
-fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_req_send(%s, nh:%s) =====\n"
-    , __FUNCTION__, __LINE__, format_cefore_prefix(route->src->prefix, route->src->plen)
-    , format_address(route->nexthop)
-);
-#endif              //----- DEB for ROUTING -----
-                /* Delete FIB */
-                cefore_fib_del_req_send (
-                        route->src->prefix, route->src->plen, route->nexthop, route->port,
-                        route->neigh->ifp->name);
-                clear_route_entry_mp(route);
-            	break;
-            } else {
-                route = route->next;
-            }
-        }
-    	if (rcdnum==0){
-	    	break;
-	    }
-    }
+    remove_routes_mp(prefix, plen, src_prefix, src_plen,
+                     route_from_source_id, (void*)id);
 }
 void
 clear_all_routes_mpms (const unsigned char *prefix, uint16_t plen,
                    const unsigned char *src_prefix, unsigned char src_plen)
 {
-    struct babel_route *route;
-    while(1) {
-        int i = find_route_slot(prefix, plen, src_prefix, src_plen, NULL);
-        if(i < 0)
-            break;
-        route = routes[i];
-        while(route) {
-#ifdef CEFNETD_IF   //+++++ DEB for ROUTING +++++
-fprintf(stderr, "IF-[%s(%d)] ===== CALL cefore_fib_del_req_send(%s, nh:%s) =====\n"
-    , __FUNCTION__, __LINE__, format_cefore_prefix(route->src->prefix, route->src->plen)
-    , format_address(route->nexthop)
-);
-#endif              //----- DEB for ROUTING -----
-            /* Delete FIB */
-             cefore_fib_del_req_send (
-                        route->src->prefix, route->src->plen, route->nexthop, route->port,
-                        route->neigh->ifp->name);
-            clear_route_entry_mp(route);
-        	break;
-        }
-    }
+    remove_routes_mp(prefix, plen, src_prefix, src_plen, NULL, NULL);
 }   
     
 #endif //----- ADD for MPMS -----
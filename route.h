@@ -72,6 +72,23 @@ struct babel_route {
     short installed;
     short channels_len;
     unsigned char *channels;
+#ifndef BABELD_CODE //+++++ ADD for MPMS +++++
+    int fd_index;               /* position in the best route's FD heap */
+#endif //----- ADD for MPMS -----
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+    time_t better_since;        /* better than the installed route since */
+    unsigned int switches;      /* switches to this prefix's installed route */
+    unsigned int held_switches; /* challengers held back by the hysteresis */
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for LFA +++++
+    struct babel_route *alternate; /* loop-free alternate, if installed */
+#endif //----- ADD for LFA -----
+#ifndef BABELD_CODE //+++++ ADD for WEIGHTED MULTIPATH +++++
+    unsigned short fib_weight;  /* weight given to cefnetd, 0 if none yet */
+#endif //----- ADD for WEIGHTED MULTIPATH -----
+#ifndef BABELD_CODE //+++++ ADD for COST EPOCH +++++
+    unsigned int cost_epoch;    /* neigh->cost_epoch that cost was taken at */
+#endif //----- ADD for COST EPOCH -----
     struct babel_route *next;
 };
 
@@ -84,6 +101,13 @@ struct best_route {
     unsigned char my_sourceId[8];
     unsigned short my_seqNo;
     unsigned short my_FD;
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+    /* Routes of this prefix as a min-heap on (refmetric + cost, source id),
+       so that the feasible distance is always fd_heap[0]. */
+    struct babel_route **fd_heap;
+    int fd_heap_len, fd_heap_size;
+    unsigned int version;       /* bumped whenever my_* change */
+#endif //----- ADD for FD HEAP -----
 };
 #endif //----- ADD for MPMS -----
 
@@ -95,6 +119,14 @@ struct route_stream;
 extern struct babel_route **routes;
 extern int kernel_metric, allow_duplicates, reflect_kernel_metric;
 extern int diversity_kind, diversity_factor;
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+extern int switch_hysteresis, switch_dwell;
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for WEIGHTED MULTIPATH +++++
+/* The weights of the nexthops of a prefix add up to about this much. */
+#define FIB_WEIGHT_TOTAL 1000
+extern int fib_weights;
+#endif //----- ADD for WEIGHTED MULTIPATH -----
 
 static inline int
 route_metric(const struct babel_route *route)
@@ -131,6 +163,16 @@ struct babel_route *find_installed_route(const unsigned char *prefix,
 
 
 int installed_routes_estimate(void);
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+int route_count(int installed_only);
+int bestroute_count(void);
+#endif //----- ADD for COUNTERS -----
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+struct babel_route *route_slot_after(const unsigned char *prefix,
+                                     uint16_t plen,
+                                     const unsigned char *src_prefix,
+                                     unsigned char src_plen);
+#endif //----- ADD for PAGED DUMP -----
 void flush_route(struct babel_route *route);
 void flush_all_routes(void);
 void flush_neighbour_routes(struct neighbour *neigh);
@@ -194,6 +236,9 @@ void send_triggered_update(struct babel_route *route,
 void route_changed(struct babel_route *route,
                    struct source *oldsrc, unsigned short oldmetric);
 void route_lost(struct source *src, unsigned oldmetric);
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+void route_reused(struct source *src);
+#endif //----- ADD for DAMPING -----
 void expire_routes(void);
 
 #ifndef BABELD_CODE //+++++ ADD for STAT +++++
@@ -248,5 +293,25 @@ struct best_route* find_bestroute(
 struct best_route * updateFeasibleDistance_mpms(
                             const unsigned char *prefix, uint16_t plen,
                             const unsigned char *src_prefix, unsigned char src_plen);
+void dump_bestroute_entry(FILE *out, const struct best_route *broute);
 void dump_best_route(FILE *out);
 #endif //----- ADD for MPMS -----
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+struct best_route *bestroute_after(const unsigned char *prefix,
+                                   uint16_t plen,
+                                   const unsigned char *src_prefix,
+                                   unsigned char src_plen);
+#endif //----- ADD for PAGED DUMP -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+struct best_route *bestroute_slot(int i);
+#endif //----- ADD for SNAPSHOT -----
+#ifndef BABELD_CODE //+++++ ADD for FD HEAP +++++
+void bestroute_metric_changed(struct babel_route *route);
+#endif //----- ADD for FD HEAP -----
+#ifndef BABELD_CODE //+++++ ADD for HYSTERESIS +++++
+int route_switch_status(char *buf, int len);
+#endif //----- ADD for HYSTERESIS -----
+#ifndef BABELD_CODE //+++++ ADD for BATCH SELECTION +++++
+void begin_route_batch(void);
+void end_route_batch(void);
+#endif //----- ADD for BATCH SELECTION -----
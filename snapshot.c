@@ -0,0 +1,484 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * snapshot.c
+ *
+ * Binary snapshots of the tables, for offline analysis.  A snapshot is
+ * written in one go at a single point of the main loop, so that it is
+ * consistent, either to snapshot_file or in answer to cefbabelstatus.
+ * The format is in cefore.h.  Entries are fixed fields in network byte
+ * order followed by the raw prefix, so writing one is a few copies and no
+ * formatting; cefbabelstatus turns them into text or JSON.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "babeld.h"
+#include "util.h"
+#include "interface.h"
+#include "source.h"
+#include "neighbour.h"
+#include "route.h"
+#include "kernel.h"
+#include "xroute.h"
+#include "resend.h"
+#include "message.h"
+#include "cefore.h"
+#include "snapshot.h"
+
+char *snapshot_file = NULL;
+int snapshot_interval = 0;
+time_t snapshot_time = 0;
+
+/* Plen(2) SrcPlen(1) SrcPrefix(16), before the prefix itself */
+#define SNAP_KEY_LEN 19
+#define SNAP_NAME_LEN CefC_Cbabel_Counters_NameLen
+
+struct snapshot {
+    unsigned char *buf;
+    int len, size;
+    int error;
+    /* Neighbours sorted by address in memory, with their index in the
+       neighbours table, for the routes to refer to them. */
+    struct snapshot_neigh *neighs;
+    int num_neighs;
+};
+
+struct snapshot_neigh {
+    const struct neighbour *neigh;
+    int index;
+};
+
+/* Make room for len more bytes. */
+static unsigned char *
+snap_reserve(struct snapshot *s, int len)
+{
+    if(s->len + len > s->size) {
+        int size = MAX(2 * s->size, s->len + len);
+        unsigned char *new = realloc(s->buf, size);
+        if(new == NULL) {
+            s->error = 1;
+            return NULL;
+        }
+        s->buf = new;
+        s->size = size;
+    }
+    return s->buf + s->len;
+}
+
+static unsigned char *
+put_u16(unsigned char *p, unsigned short v)
+{
+    DO_HTONS(p, v);
+    return p + 2;
+}
+
+static unsigned char *
+put_u32(unsigned char *p, unsigned int v)
+{
+    DO_HTONL(p, v);
+    return p + 4;
+}
+
+static unsigned char *
+put_u64(unsigned char *p, unsigned long long v)
+{
+    p = put_u32(p, v >> 32);
+    return put_u32(p, v & 0xFFFFFFFF);
+}
+
+static unsigned char *
+put_bytes(unsigned char *p, const void *data, int len)
+{
+    memcpy(p, data, len);
+    return p + len;
+}
+
+static unsigned char *
+put_name(unsigned char *p, const char *name)
+{
+    memset(p, 0, SNAP_NAME_LEN);
+    if(name)
+        strncpy((char*)p, name, SNAP_NAME_LEN - 1);
+    return p + SNAP_NAME_LEN;
+}
+
+static unsigned char *
+put_key(unsigned char *p, const unsigned char *prefix, uint16_t plen,
+        const unsigned char *src_prefix, unsigned char src_plen)
+{
+    p = put_u16(p, plen);
+    *p++ = src_plen;
+    p = put_bytes(p, src_prefix, 16);
+    return put_bytes(p, prefix, plen);
+}
+
+/* Seconds since t, as the tables keep their ages. */
+static unsigned int
+snap_age(time_t t)
+{
+    return t > now.tv_sec ? 0 : now.tv_sec - t;
+}
+
+/* Table(1) NumEntries(4) Length(4), filled in by snap_section_end. */
+static int
+snap_section_begin(struct snapshot *s, int table)
+{
+    unsigned char *p = snap_reserve(s, 9);
+    if(p == NULL)
+        return -1;
+    p[0] = table;
+    s->len += 9;
+    return s->len;
+}
+
+static void
+snap_section_end(struct snapshot *s, int start, unsigned int n)
+{
+    if(start < 0)
+        return;
+    DO_HTONL(s->buf + start - 8, n);
+    DO_HTONL(s->buf + start - 4, s->len - start);
+}
+
+static int
+snap_neigh_compare(const void *a, const void *b)
+{
+    uintptr_t na = (uintptr_t)((const struct snapshot_neigh*)a)->neigh;
+    uintptr_t nb = (uintptr_t)((const struct snapshot_neigh*)b)->neigh;
+    return na < nb ? -1 : na > nb ? 1 : 0;
+}
+
+static int
+snap_neigh_index(struct snapshot *s, const struct neighbour *neigh)
+{
+    struct snapshot_neigh key, *found;
+
+    key.neigh = neigh;
+    found = bsearch(&key, s->neighs, s->num_neighs,
+                    sizeof(struct snapshot_neigh), snap_neigh_compare);
+    return found ? found->index : 0xFFFF;
+}
+
+static void
+snap_neighbours(struct snapshot *s)
+{
+    struct neighbour *neigh;
+    unsigned char *p;
+    int start, n = 0;
+
+    FOR_ALL_NEIGHBOURS(neigh)
+        n++;
+    s->neighs = calloc(MAX(n, 1), sizeof(struct snapshot_neigh));
+    if(s->neighs == NULL) {
+        s->error = 1;
+        return;
+    }
+
+    start = snap_section_begin(s, CefC_Snap_Neighbours);
+    n = 0;
+    FOR_ALL_NEIGHBOURS(neigh) {
+        p = snap_reserve(s, 16 + SNAP_NAME_LEN + 16);
+        if(p == NULL)
+            return;
+        p = put_bytes(p, neigh->address, 16);
+        p = put_name(p, neigh->ifp->name);
+        p = put_u16(p, neigh->hello.reach);
+        p = put_u16(p, neigh->uhello.reach);
+        p = put_u16(p, neighbour_rxcost(neigh));
+        p = put_u16(p, neigh->txcost);
+        p = put_u32(p, neigh->rtt);
+        p = put_u16(p, neighbour_rttcost(neigh));
+        p = put_u16(p, neighbour_cost(neigh));
+        s->len = p - s->buf;
+        s->neighs[n].neigh = neigh;
+        s->neighs[n].index = n;
+        n++;
+    }
+    snap_section_end(s, start, n);
+
+    s->num_neighs = n;
+    qsort(s->neighs, n, sizeof(struct snapshot_neigh), snap_neigh_compare);
+}
+
+static void
+snap_xroutes(struct snapshot *s)
+{
+    struct xroute_stream *xroutes;
+    struct xroute *xroute;
+    unsigned char *p;
+    int start, n = 0;
+
+    xroutes = xroute_stream();
+    if(xroutes == NULL) {
+        s->error = 1;
+        return;
+    }
+    start = snap_section_begin(s, CefC_Snap_Xroutes);
+    while((xroute = xroute_stream_next(xroutes)) != NULL) {
+        p = snap_reserve(s, 10 + SNAP_KEY_LEN + xroute->plen);
+        if(p == NULL)
+            break;
+        p = put_u16(p, xroute->metric);
+        p = put_u32(p, xroute->ifindex);
+        p = put_u32(p, xroute->proto);
+        p = put_key(p, xroute->prefix, xroute->plen,
+                    xroute->src_prefix, xroute->src_plen);
+        s->len = p - s->buf;
+        n++;
+    }
+    xroute_stream_done(xroutes);
+    snap_section_end(s, start, n);
+}
+
+static void
+snap_routes(struct snapshot *s)
+{
+    struct route_stream *routes;
+    struct babel_route *route;
+    unsigned char *p;
+    int start, n = 0;
+
+    routes = route_stream(ROUTE_ALL);
+    if(routes == NULL) {
+        s->error = 1;
+        return;
+    }
+    start = snap_section_begin(s, CefC_Snap_Routes);
+    while((route = route_stream_next(routes)) != NULL) {
+        struct source *src = route->src;
+        p = snap_reserve(s, 45 + SNAP_KEY_LEN + src->plen);
+        if(p == NULL)
+            break;
+        p = put_bytes(p, src->id, 8);
+        p = put_u16(p, route->seqno);
+        p = put_u16(p, route_metric(route));
+        p = put_u16(p, route->refmetric);
+        p = put_u16(p, route->cost);
+        p = put_u16(p, route->add_metric);
+        p = put_u16(p, route->smoothed_metric);
+        p = put_u16(p, snap_neigh_index(s, route->neigh));
+        p = put_bytes(p, route->nexthop, 16);
+        p = put_u16(p, route->port);
+        p = put_u32(p, snap_age(route->time));
+        *p++ = (route->installed ? CefC_Snap_Installed : 0) |
+            (route_feasible(route) ? CefC_Snap_Feasible : 0);
+        p = put_key(p, src->prefix, src->plen, src->src_prefix, src->src_plen);
+        s->len = p - s->buf;
+        n++;
+    }
+    route_stream_done(routes);
+    snap_section_end(s, start, n);
+}
+
+static void
+snap_sources(struct snapshot *s)
+{
+    struct source *src;
+    unsigned char *p;
+    int start, i;
+
+    start = snap_section_begin(s, CefC_Snap_Sources);
+    for(i = 0; (src = source_slot(i)) != NULL; i++) {
+        p = snap_reserve(s, 18 + SNAP_KEY_LEN + src->plen);
+        if(p == NULL)
+            return;
+        p = put_bytes(p, src->id, 8);
+        p = put_u16(p, src->seqno);
+        p = put_u16(p, src->metric);
+        p = put_u16(p, src->route_count);
+        p = put_u32(p, snap_age(src->time));
+        p = put_key(p, src->prefix, src->plen, src->src_prefix, src->src_plen);
+        s->len = p - s->buf;
+    }
+    snap_section_end(s, start, i);
+}
+
+static void
+snap_bestroutes(struct snapshot *s)
+{
+    struct best_route *broute;
+    unsigned char *p;
+    int start, i;
+
+    start = snap_section_begin(s, CefC_Snap_Bestroutes);
+    for(i = 0; (broute = bestroute_slot(i)) != NULL; i++) {
+        p = snap_reserve(s, 14 + SNAP_KEY_LEN + broute->plen);
+        if(p == NULL)
+            return;
+        p = put_bytes(p, broute->my_sourceId, 8);
+        p = put_u16(p, broute->my_seqNo);
+        p = put_u16(p, broute->my_FD);
+        p = put_u16(p, broute->fd_heap_len);
+        p = put_key(p, broute->prefix, broute->plen,
+                    broute->src_prefix, broute->src_plen);
+        s->len = p - s->buf;
+    }
+    snap_section_end(s, start, i);
+}
+
+static void
+snap_resends(struct snapshot *s)
+{
+    struct resend *resend;
+    unsigned char *p;
+    int start, n = 0;
+
+    start = snap_section_begin(s, CefC_Snap_Resends);
+    for(resend = to_resend; resend; resend = resend->next) {
+        p = snap_reserve(s, 18 + SNAP_NAME_LEN + SNAP_KEY_LEN + resend->plen);
+        if(p == NULL)
+            return;
+        *p++ = resend->kind;
+        *p++ = resend->max;
+        p = put_u16(p, resend->delay);
+        p = put_u32(p, resend->time.tv_sec == 0 ? 0xFFFFFFFF :
+                    timeval_minus_msec(&now, &resend->time));
+        p = put_u16(p, resend->seqno);
+        p = put_bytes(p, resend->id, 8);
+        p = put_name(p, resend->ifp ? resend->ifp->name : NULL);
+        p = put_key(p, resend->prefix, resend->plen,
+                    resend->src_prefix, resend->src_plen);
+        s->len = p - s->buf;
+        n++;
+    }
+    snap_section_end(s, start, n);
+}
+
+/* Build a snapshot of all the tables, after reserve bytes left for the
+   caller.  Returns the whole length, or -1; the buffer is the caller's. */
+int
+snapshot_create(unsigned char **buf_r, int reserve)
+{
+    struct snapshot s;
+    unsigned char *p;
+
+    memset(&s, 0, sizeof(s));
+    p = snap_reserve(&s, reserve + 64 * 1024);
+    if(p == NULL)
+        return -1;
+    s.len = reserve;
+
+    p = s.buf + s.len;
+    p = put_bytes(p, CefC_Cbabel_Snapshot_Magic, 4);
+    p = put_u16(p, CefC_Cbabel_Snapshot_Ver);
+    p = put_u64(p, now.tv_sec);
+    p = put_bytes(p, myid, 8);
+    p = put_u16(p, myseqno);
+    p = put_u16(p, CefC_Snap_Num - 1);
+    s.len = p - s.buf;
+
+    snap_neighbours(&s);
+    snap_xroutes(&s);
+    snap_routes(&s);
+    snap_sources(&s);
+    snap_bestroutes(&s);
+    snap_resends(&s);
+
+    free(s.neighs);
+    if(s.error) {
+        free(s.buf);
+        return -1;
+    }
+    *buf_r = s.buf;
+    return s.len;
+}
+
+/* Write len bytes of buf to file.  They go to a temporary file first,
+   which is then renamed, so that readers never see half of them. */
+int
+write_file_atomic(const char *file, const unsigned char *buf, int len)
+{
+    char tmp[PATH_MAX];
+    int fd, rc, n = 0;
+
+    rc = snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    if(rc < 0 || rc >= (int)sizeof(tmp)) {
+        fprintf(stderr, "File name %s is too long.\n", file);
+        return -1;
+    }
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        perror("creat");
+        return -1;
+    }
+    while(n < len) {
+        rc = write(fd, buf + n, len - n);
+        if(rc < 0) {
+            if(errno == EINTR)
+                continue;
+            perror("write");
+            break;
+        }
+        n += rc;
+    }
+    if(close(fd) < 0 && n == len) {
+        perror("close");
+        n = -1;
+    }
+    if(n != len) {
+        unlink(tmp);
+        return -1;
+    }
+    if(rename(tmp, file) < 0) {
+        perror("rename");
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
+
+int
+snapshot_write_file(const char *file)
+{
+    unsigned char *buf;
+    int len, rc;
+
+    len = snapshot_create(&buf, 0);
+    if(len < 0) {
+        fprintf(stderr, "Couldn't allocate snapshot.\n");
+        return -1;
+    }
+    rc = write_file_atomic(file, buf, len);
+    free(buf);
+    return rc;
+}
+
+#endif //----- ADD -----
@@ -62,10 +62,91 @@ THE SOFTWARE.
 #include "source.h"
 #include "interface.h"
 #include "route.h"
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+#include "damping.h"
+#endif //----- ADD for DAMPING -----
 
 static struct source **sources = NULL;
 static int source_slots = 0, max_source_slots = 0;
 
+#ifndef BABELD_CODE //+++++ ADD for MP +++++
+/* sources[] is ordered by router-id first, which is no help to find all
+   the sources of a prefix.  This hash table, keyed on the prefix alone,
+   chains together all the sources of a prefix in one bucket. */
+static struct source **source_index = NULL;
+static int source_index_size = 0;
+
+static int
+source_match_mp(const struct source *src,
+                const unsigned char *prefix, uint16_t plen,
+                const unsigned char *src_prefix, unsigned char src_plen)
+{
+    return src->plen == plen && src->src_plen == src_plen &&
+        memcmp(src->prefix, prefix, plen) == 0 &&
+        memcmp(src->src_prefix, src_prefix, 16) == 0;
+}
+
+static void
+resize_source_index(int size)
+{
+    struct source **index;
+    struct source *src, *next;
+    int i;
+
+    index = calloc(size, sizeof(struct source*));
+    if(index == NULL) {
+        perror("malloc(source_index)");
+        return;
+    }
+    for(i = 0; i < source_index_size; i++) {
+        for(src = source_index[i]; src; src = next) {
+            unsigned int h = hash_prefix(src->prefix, src->plen);
+            next = src->index_next;
+            src->index_next = index[h & (size - 1)];
+            index[h & (size - 1)] = src;
+        }
+    }
+    free(source_index);
+    source_index = index;
+    source_index_size = size;
+}
+
+static void
+index_source(struct source *src)
+{
+    unsigned int h;
+
+    if(source_index_size == 0 || source_slots > 2 * source_index_size)
+        resize_source_index(source_index_size == 0 ?
+                            1024 : 2 * source_index_size);
+    if(source_index == NULL) {
+        src->index_next = NULL;
+        return;
+    }
+    h = hash_prefix(src->prefix, src->plen) & (source_index_size - 1);
+    src->index_next = source_index[h];
+    source_index[h] = src;
+}
+
+static void
+unindex_source(struct source *src)
+{
+    struct source **p;
+
+    if(source_index == NULL)
+        return;
+    p = &source_index[hash_prefix(src->prefix, src->plen) &
+                      (source_index_size - 1)];
+    while(*p) {
+        if(*p == src) {
+            *p = src->index_next;
+            return;
+        }
+        p = &(*p)->index_next;
+    }
+}
+#endif //----- ADD for MP -----
+
 static int
 source_compare(const unsigned char *id,
 #ifdef BABELD_CODE //+++++ REPLACE +++++
@@ -214,6 +295,9 @@ find_source(const unsigned char *id,
                 (source_slots - n) * sizeof(struct source*));
     source_slots++;
     sources[n] = src;
+#ifndef BABELD_CODE //+++++ ADD for MP +++++
+    index_source(src);
+#endif //----- ADD for MP -----
 
     return src;
 }
@@ -233,6 +317,27 @@ release_source(struct source *src)
     src->route_count--;
 }
 
+#ifndef BABELD_CODE //+++++ ADD for URI CACHE +++++
+/* The printable prefix of a source.  It is formatted the first time it
+   is needed and kept with the source, whose prefix never changes. */
+const char *
+source_uri(struct source *src)
+{
+    char buf[CEFORE_URI_MAX];
+    int len;
+
+    if(src->uri == NULL) {
+        len = format_cefore_prefix_buf(buf, CEFORE_URI_MAX,
+                                       src->prefix, src->plen);
+        src->uri = malloc(len + 1);
+        if(src->uri == NULL)
+            return format_cefore_prefix(src->prefix, src->plen);
+        memcpy(src->uri, buf, len + 1);
+    }
+    return src->uri;
+}
+#endif //----- ADD for URI CACHE -----
+
 void
 update_source(struct source *src,
               unsigned short seqno, unsigned short metric)
@@ -290,16 +395,19 @@ expire_sources()
                 /* clock stepped */
                 src->time = now.tv_sec;
 
-            if(src->route_count == 0 && src->time < now.tv_sec - SOURCE_GC_TIME) {
+            if(src->route_count == 0 && src->time < now.tv_sec - SOURCE_GC_TIME &&
+               src->damping == NULL) {
                 plen = src->plen;
                 memcpy(prefix, src->prefix, plen);
                 src_plen = src->src_plen;
                 memset(src_prefix, 0, 16);
                 memcpy(src_prefix, src->src_prefix, src_plen);
+                unindex_source(src);
+                free(src->uri);
                 free(src);
                 sources[i] = NULL;
             	memmove(sources + i, sources + i + 1,
-                        (source_slots - i) * sizeof(struct source*));
+                        (source_slots - i - 1) * sizeof(struct source*));
 		        source_slots--;
                 updateFeasibleDistance_mpms(prefix, plen, src_prefix, src_plen);
             } else {
@@ -313,7 +421,10 @@ expire_sources()
                 /* clock stepped */
                 src->time = now.tv_sec;
 
-            if(src->route_count == 0 && src->time < now.tv_sec - SOURCE_GC_TIME) {
+            if(src->route_count == 0 && src->time < now.tv_sec - SOURCE_GC_TIME &&
+               src->damping == NULL) {
+                unindex_source(src);
+                free(src->uri);
                 free(src);
                 sources[i] = NULL;
                 i++;
@@ -346,158 +457,146 @@ check_sources_released(void)
                     (int)src->route_count);
     }
 }
-#ifndef BABELD_CODE //+++++ ADD for MP +++++
-static int
-prefix_compare_mp(const unsigned char *prefix, uint16_t plen,
-               const unsigned char *src_prefix, unsigned char src_plen,
-               const struct source *src)
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+int
+source_count(void)
 {
-    int rc;
-    if(plen < src->plen) {
-        return -1;
-    }
-    if(plen > src->plen) {
-        return 1;
-    }
-
-    rc = memcmp(prefix, src->prefix, plen);
-    if(rc != 0) {
-        return rc;
-    }
+    return source_slots;
+}
+#endif //----- ADD for COUNTERS -----
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+/* Source following the given key in the table, or the first one if id
+   is NULL. */
+struct source *
+source_after(const unsigned char *id,
+             const unsigned char *prefix, uint16_t plen,
+             const unsigned char *src_prefix, unsigned char src_plen)
+{
+    int i, n = 0;
 
-    if(src_plen < src->src_plen) { 
-        return -1;
-    }
-    if(src_plen > src->src_plen) {
-        return 1;
+    if(id) {
+        i = find_source_slot(id, prefix, plen, src_prefix, src_plen, &n);
+        if(i >= 0)
+            n = i + 1;
     }
+    return n < source_slots ? sources[n] : NULL;
+}
+#endif //----- ADD for PAGED DUMP -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+/* Source in the given slot of the table, for walking it in order. */
+struct source *
+source_slot(int i)
+{
+    return i >= 0 && i < source_slots ? sources[i] : NULL;
+}
+#endif //----- ADD for SNAPSHOT -----
+#ifndef BABELD_CODE //+++++ ADD for MP +++++
+/* First source of a prefix, or NULL. */
+struct source *
+first_source_mp(const unsigned char *prefix, uint16_t plen,
+                const unsigned char *src_prefix, unsigned char src_plen)
+{
+    struct source *src;
 
-    rc = memcmp(src_prefix, src->src_prefix, 16);
-    if(rc != 0) {
-        return rc;
-    }
+    if(source_index == NULL)
+        return NULL;
+    src = source_index[hash_prefix(prefix, plen) &
+                       (source_index_size - 1)];
+    while(src && !source_match_mp(src, prefix, plen, src_prefix, src_plen))
+        src = src->index_next;
+    return src;
+}
 
-    return 0;
+/* Next source of the same prefix as src, or NULL. */
+struct source *
+next_source_mp(struct source *src)
+{
+    struct source *next = src->index_next;
+    while(next && !source_match_mp(next, src->prefix, src->plen,
+                                   src->src_prefix, src->src_plen))
+        next = next->index_next;
+    return next;
 }
+
 int 
 exist_source_mp(
                  const unsigned char *prefix, uint16_t plen,
                  const unsigned char *src_prefix, unsigned char src_plen)
 {
-    int exist=0;
-
-    if(source_slots < 1) {
-        return exist;
-    }
-
-    int p, m, g, c;
-    p = 0; g = source_slots - 1;
+    return first_source_mp(prefix, plen, src_prefix, src_plen) != NULL;
+}
 
-    do {
-        m = (p + g) / 2;
-        c = prefix_compare_mp(prefix, plen, src_prefix, src_plen, sources[m]);
-    	if(c == 0) {
-            exist = 1;
-            break;
-    	} else if(c < 0) {
-            g = m - 1;
-    	} else {
-            p = m + 1;
-    	}
-    } while(p <= g);
+void
+delete_source_mp(struct source * delsrc)
+{
+    int i;
 
-    return exist;
+    assert(delsrc->route_count == 0);
+    i = find_source_slot(delsrc->id, delsrc->prefix, delsrc->plen,
+                         delsrc->src_prefix, delsrc->src_plen, NULL);
+    if(i < 0 || sources[i] != delsrc)
+        return;
+    unindex_source(delsrc);
+    damping_forget(delsrc);
+    free(delsrc->uri);
+    free(delsrc);
+    memmove(sources + i, sources + i + 1,
+            (source_slots - i - 1) * sizeof(struct source*));
+    source_slots--;
+    sources[source_slots] = NULL;
 }
+
+/* Delete every source of a prefix. */
 void
-delete_source_mp(struct source * delsrc)
+delete_sources_mp(const unsigned char *prefix, uint16_t plen,
+                  const unsigned char *src_prefix, unsigned char src_plen)
 {
-    int i = 0, j = 0;
-    
-    
-    while(i < source_slots) {
-        struct source *src = sources[i];
-        
-        if(delsrc == src) {
-            assert(src->route_count == 0);
-            free(src);
-            sources[i] = NULL;
-            i++;
-        } else {
-            if(j < i) {
-                sources[j] = sources[i];
-                sources[i] = NULL;
-            }
-            i++;
-            j++;
-        }
+    struct source *src, *next;
+
+    src = first_source_mp(prefix, plen, src_prefix, src_plen);
+    while(src) {
+        next = next_source_mp(src);
+        delete_source_mp(src);
+        src = next;
     }
-    source_slots = j;
 }
+
 struct source*
 get_src_rcd_mp(const unsigned char *prefix, uint16_t plen,
               const unsigned char *src_prefix, unsigned char src_plen)
 {
-    struct source* exist=NULL;
-
-    if(source_slots < 1) {
-        return exist;
-    }
-
-    int p, m, g, c;
-    p = 0; g = source_slots - 1;
-
-    do {
-        m = (p + g) / 2;
-        c = prefix_compare_mp(prefix, plen, src_prefix, src_plen, sources[m]);
-    	
-    	if(c == 0) {
-            exist = sources[m];
-            break;
-    	} else if(c < 0) {
-            g = m - 1;
-    	} else {
-            p = m + 1;
-    	}
-    } while(p <= g);
-
-    return exist;
+    return first_source_mp(prefix, plen, src_prefix, src_plen);
 }
 
 #endif //----- ADD for MP -----
 
 #ifndef BABELD_CODE //+++++ ADD for MPSS +++++
+/* Router-id of a source of this prefix other than id, or NULL. */
 unsigned char *
 find_other_source_mpss (const unsigned char *id,
                  const unsigned char *prefix, uint16_t plen,
                  const unsigned char *src_prefix, unsigned char src_plen)
 {
-    int rc;
-    unsigned char *sid=NULL;
+    struct source *src;
 
-    if(source_slots < 1) {
-        return sid;
+    for(src = first_source_mp(prefix, plen, src_prefix, src_plen); src;
+        src = next_source_mp(src)) {
+        if(memcmp(id, src->id, 8) != 0)
+            return src->id;
     }
+    return NULL;
+}
 
-    int p, m, g, c;
-    p = 0; g = source_slots - 1;
-
-    do {
-        m = (p + g) / 2;
-        c = prefix_compare_mp(prefix, plen, src_prefix, src_plen, sources[m]);
-    	if(c == 0) {
-            rc = memcmp(id, sources[m]->id, 8);
-            if(rc != 0) {
-                sid = sources[m]->id;
-            }
-		    return sid;
-    	} else if(c < 0) {
-            g = m - 1;
-    	} else {
-            p = m + 1;
-    	}
-    } while(p <= g);
-
-    return sid;
+void dump_source_entry(FILE *out, struct source *src)
+{
+    fprintf(out, "%s%s%s sourceId=%s seqno=%u my_FD=%u route_count=%u remain=%ld\n",
+            source_uri(src),
+            src->src_plen > 0 ? " from " : "",
+            src->src_plen > 0 ?
+            format_prefix(src->src_prefix, src->src_plen) : "",
+            format_eui64(src->id),
+            src->seqno, src->metric, src->route_count,
+            SOURCE_GC_TIME - (now.tv_sec - src->time));
 }
 
 void dump_source(FILE *out)
@@ -505,17 +604,8 @@ void dump_source(FILE *out)
     int i;
 
     fprintf(out, "----- sources -----\n");
-    for(i=0; i < source_slots; i++) {
-        struct source *src = sources[i];
-        fprintf(out, "%s%s%s sourceId=%s seqno=%u my_FD=%u route_count=%u remain=%ld\n",
-                format_cefore_prefix(src->prefix, src->plen),
-                src->src_plen > 0 ? " from " : "",
-                src->src_plen > 0 ?
-                format_prefix(src->src_prefix, src->src_plen) : "",
-                format_eui64(src->id),
-                src->seqno, src->metric, src->route_count,
-                SOURCE_GC_TIME - (now.tv_sec - src->time));
-    }
+    for(i=0; i < source_slots; i++)
+        dump_source_entry(out, sources[i]);
 }
 
 #endif //----- ADD for MPSS -----
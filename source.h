@@ -66,6 +66,16 @@ struct source {
     unsigned short metric;
     unsigned short route_count;
     time_t time;
+#ifndef BABELD_CODE //+++++ ADD for MP +++++
+    /* Next source in the same bucket of the prefix index. */
+    struct source *index_next;
+#endif //----- ADD for MP -----
+#ifndef BABELD_CODE //+++++ ADD for URI CACHE +++++
+    char *uri;                  /* printable prefix, see source_uri */
+#endif //----- ADD for URI CACHE -----
+#ifndef BABELD_CODE //+++++ ADD for DAMPING +++++
+    struct damping *damping;    /* flap penalty, see damping.c */
+#endif //----- ADD for DAMPING -----
 };
 
 struct source *find_source(const unsigned char *id,
@@ -92,15 +102,38 @@ void delete_source_mp(struct source * delsrc);
 struct source*
 get_src_rcd_mp(const unsigned char *prefix, uint16_t plen,
               const unsigned char *src_prefix, unsigned char src_plen);
+struct source *
+first_source_mp(const unsigned char *prefix, uint16_t plen,
+                const unsigned char *src_prefix, unsigned char src_plen);
+struct source *
+next_source_mp(struct source *src);
+void delete_sources_mp(const unsigned char *prefix, uint16_t plen,
+                       const unsigned char *src_prefix, unsigned char src_plen);
 #endif //----- ADD for MP -----
 #ifndef BABELD_CODE //+++++ ADD for MPSS +++++
 unsigned char * find_other_source_mpss (const unsigned char *id,
                  const unsigned char *prefix, uint16_t plen,
                  const unsigned char *src_prefix, unsigned char src_plen);
+void dump_source_entry(FILE *out, struct source *src);
 void dump_source(FILE *out);
 #endif //----- ADD for MPSS -----
 #ifndef BABELD_CODE //+++++ ADD for MPMS +++++
 void update_source_mpms(const unsigned char *prefix, uint16_t plen,
            const unsigned char *src_prefix, unsigned char src_plen);
 #endif //----- ADD for MPMS -----
+#ifndef BABELD_CODE //+++++ ADD for COUNTERS +++++
+int source_count(void);
+#endif //----- ADD for COUNTERS -----
+#ifndef BABELD_CODE //+++++ ADD for URI CACHE +++++
+const char *source_uri(struct source *src);
+#endif //----- ADD for URI CACHE -----
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+struct source *source_after(const unsigned char *id,
+                            const unsigned char *prefix, uint16_t plen,
+                            const unsigned char *src_prefix,
+                            unsigned char src_plen);
+#endif //----- ADD for PAGED DUMP -----
+#ifndef BABELD_CODE //+++++ ADD for SNAPSHOT +++++
+struct source *source_slot(int i);
+#endif //----- ADD for SNAPSHOT -----
 
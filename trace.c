@@ -0,0 +1,324 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * trace.c
+ *
+ * Binary event trace.  The interesting events (updates received, route
+ * changes, FIB Requests, requests sent) are written as fixed-size records to
+ * a ring in memory, which is always on and costs a few stores per event:
+ * no formatting, no system call, and the time is the one of the main loop.
+ * The ring is dumped on SIGUSR1 or in answer to cefbabelstatus, in the format
+ * in cefore.h, and cefbabelstatus decodes it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "babeld.h"
+#include "util.h"
+#include "interface.h"
+#include "source.h"
+#include "neighbour.h"
+#include "route.h"
+#include "kernel.h"
+#include "xroute.h"
+#include "cefore.h"
+#include "snapshot.h"
+#include "trace.h"
+
+int trace_records = 65536;
+char *trace_file = NULL;
+
+static struct trace_record *ring = NULL;
+static unsigned int ring_mask = 0;
+static unsigned long long trace_total = 0;
+
+/* Where the names of the prefixes in the ring are found at dump time. */
+struct trace_name {
+    const unsigned char *prefix;
+    uint16_t plen;
+};
+
+int
+trace_init(void)
+{
+    unsigned int n = 1;
+
+    if(trace_records <= 0)
+        return 0;
+    while(n < (unsigned int)trace_records)
+        n <<= 1;
+    ring = calloc(n, sizeof(struct trace_record));
+    if(ring == NULL) {
+        perror("malloc(trace)");
+        return -1;
+    }
+    ring_mask = n - 1;
+    return 1;
+}
+
+/* A cheap hash of the prefix, a word at a time, for the records to refer to
+   it; the dump maps it back to the prefix.  0 means no prefix. */
+static inline uint32_t ATTRIBUTE((always_inline))
+trace_ref(const unsigned char *prefix, uint16_t plen)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ plen, w;
+    int i;
+
+    if(prefix == NULL)
+        return 0;
+    for(i = 0; i + 8 <= plen; i += 8) {
+        memcpy(&w, prefix + i, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    if(i < plen) {
+        /* Not memcpy, which is a slow rep movsb for a variable length. */
+        for(w = 0; i < plen; i++)
+            w = (w << 8) | prefix[i];
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    return (uint32_t)h ? (uint32_t)h : 1;
+}
+
+static inline struct trace_record * ATTRIBUTE((always_inline))
+trace_next(int type, int flags)
+{
+    struct trace_record *r = &ring[trace_total++ & ring_mask];
+
+    r->sec = now.tv_sec;
+    r->usec = now.tv_usec;
+    r->type = type;
+    r->flags = flags;
+    r->pad = 0;
+    return r;
+}
+
+void
+trace_route(int type, const struct babel_route *route,
+            unsigned int arg, int flags)
+{
+    struct trace_record *r;
+
+    if(ring == NULL)
+        return;
+    r = trace_next(type, flags);
+    r->ref = trace_ref(route->src->prefix, route->src->plen);
+    r->arg = arg;
+    memcpy(r->addr, route->neigh->address + 12, 4);
+    r->plen = route->src->plen;
+    r->ifindex = route->neigh->ifp->ifindex;
+    r->seqno = route->seqno;
+    r->metric = route_metric(route);
+}
+
+void
+trace_prefix(int type, const unsigned char *prefix, uint16_t plen,
+             const unsigned char *address, unsigned int ifindex,
+             unsigned short seqno, unsigned short metric,
+             unsigned int arg, int flags)
+{
+    struct trace_record *r;
+
+    if(ring == NULL)
+        return;
+    r = trace_next(type, flags);
+    r->ref = trace_ref(prefix, plen);
+    r->arg = arg;
+    if(address)
+        memcpy(r->addr, address + 12, 4);
+    else
+        memset(r->addr, 0, 4);
+    r->plen = prefix ? plen : 0;
+    r->ifindex = ifindex;
+    r->seqno = seqno;
+    r->metric = metric;
+}
+
+static int
+ref_compare(const void *a, const void *b)
+{
+    uint32_t ra = *(const uint32_t*)a, rb = *(const uint32_t*)b;
+    return ra < rb ? -1 : ra > rb ? 1 : 0;
+}
+
+/* Remember the name of prefix if the ring refers to it. */
+static void
+trace_name_add(const uint32_t *refs, int num_refs, struct trace_name *names,
+               const unsigned char *prefix, uint16_t plen,
+               int *num_names_r, int *names_len_r)
+{
+    uint32_t ref = trace_ref(prefix, plen);
+    const uint32_t *found;
+    struct trace_name *name;
+
+    found = bsearch(&ref, refs, num_refs, sizeof(uint32_t), ref_compare);
+    if(found == NULL)
+        return;
+    name = &names[found - refs];
+    if(name->prefix)
+        return;
+    name->prefix = prefix;
+    name->plen = plen;
+    (*num_names_r)++;
+    *names_len_r += 6 + plen;
+}
+
+/* Build a dump of the ring, oldest record first, after reserve bytes left
+   for the caller.  Returns the whole length, or -1; the buffer is the
+   caller's. */
+int
+trace_create(unsigned char **buf_r, int reserve)
+{
+    struct xroute_stream *xroutes;
+    struct source *src;
+    struct trace_name *names = NULL;
+    uint32_t *refs = NULL;
+    unsigned long long first;
+    unsigned char *buf, *p;
+    int n, i, j, num_refs = 0, num_names = 0, names_len = 0, len;
+
+    n = MIN(trace_total, ring ? (unsigned long long)ring_mask + 1 : 0);
+    first = trace_total - n;
+
+    /* The prefixes referred to, and their names where we still know them. */
+    if(n > 0) {
+        refs = malloc(n * sizeof(uint32_t));
+        if(refs == NULL)
+            return -1;
+        for(i = 0; i < n; i++) {
+            uint32_t ref = ring[(first + i) & ring_mask].ref;
+            if(ref != 0)
+                refs[num_refs++] = ref;
+        }
+        qsort(refs, num_refs, sizeof(uint32_t), ref_compare);
+        for(i = 0, j = 0; i < num_refs; i++) {
+            if(j == 0 || refs[i] != refs[j - 1])
+                refs[j++] = refs[i];
+        }
+        num_refs = j;
+        names = calloc(MAX(num_refs, 1), sizeof(struct trace_name));
+        if(names == NULL) {
+            free(refs);
+            return -1;
+        }
+        for(i = 0; (src = source_slot(i)) != NULL; i++)
+            trace_name_add(refs, num_refs, names, src->prefix, src->plen,
+                           &num_names, &names_len);
+        xroutes = xroute_stream();
+        if(xroutes) {
+            while(1) {
+                struct xroute *xroute = xroute_stream_next(xroutes);
+                if(xroute == NULL)
+                    break;
+                trace_name_add(refs, num_refs, names,
+                               xroute->prefix, xroute->plen,
+                               &num_names, &names_len);
+            }
+            xroute_stream_done(xroutes);
+        }
+    }
+
+    len = reserve + CefC_Cbabel_Trace_HeaderLen +
+        n * CefC_Cbabel_Trace_RecordLen + names_len;
+    buf = malloc(len);
+    if(buf == NULL) {
+        free(refs);
+        free(names);
+        return -1;
+    }
+
+    p = buf + reserve;
+    memcpy(p, CefC_Cbabel_Trace_Magic, 4);
+    DO_HTONS(p + 4, CefC_Cbabel_Trace_Ver);
+    DO_HTONL(p + 6, (unsigned long long)now.tv_sec >> 32);
+    DO_HTONL(p + 10, now.tv_sec & 0xFFFFFFFF);
+    DO_HTONS(p + 14, CefC_Cbabel_Trace_RecordLen);
+    DO_HTONL(p + 16, n);
+    DO_HTONL(p + 20, trace_total >> 32);
+    DO_HTONL(p + 24, trace_total & 0xFFFFFFFF);
+    DO_HTONL(p + 28, num_names);
+    p += CefC_Cbabel_Trace_HeaderLen;
+
+    for(i = 0; i < n; i++) {
+        const struct trace_record *r = &ring[(first + i) & ring_mask];
+        DO_HTONL(p, r->sec);
+        DO_HTONL(p + 4, r->usec);
+        DO_HTONL(p + 8, r->ref);
+        DO_HTONL(p + 12, r->arg);
+        memcpy(p + 16, r->addr, 4);
+        DO_HTONS(p + 20, r->plen);
+        DO_HTONS(p + 22, r->ifindex);
+        DO_HTONS(p + 24, r->seqno);
+        DO_HTONS(p + 26, r->metric);
+        p[28] = r->type;
+        p[29] = r->flags;
+        p[30] = 0;
+        p[31] = 0;
+        p += CefC_Cbabel_Trace_RecordLen;
+    }
+
+    for(i = 0; i < num_refs; i++) {
+        if(names[i].prefix == NULL)
+            continue;
+        DO_HTONL(p, refs[i]);
+        DO_HTONS(p + 4, names[i].plen);
+        memcpy(p + 6, names[i].prefix, names[i].plen);
+        p += 6 + names[i].plen;
+    }
+
+    free(refs);
+    free(names);
+    *buf_r = buf;
+    return len;
+}
+
+int
+trace_write_file(const char *file)
+{
+    unsigned char *buf;
+    int len, rc;
+
+    len = trace_create(&buf, 0);
+    if(len < 0) {
+        fprintf(stderr, "Couldn't allocate trace.\n");
+        return -1;
+    }
+    rc = write_file_atomic(file, buf, len);
+    free(buf);
+    return rc;
+}
+
+#endif //----- ADD -----
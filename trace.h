@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * trace.h
+ */
+
+#ifndef __TRACE_HEADER__
+#define __TRACE_HEADER__
+
+/* One event, in host byte order; see CefC_Cbabel_Msg_Type_Trace. */
+struct trace_record {
+    uint32_t sec;
+    uint32_t usec;
+    uint32_t ref;
+    uint32_t arg;
+    unsigned char addr[4];
+    uint16_t plen;
+    uint16_t ifindex;
+    uint16_t seqno;
+    uint16_t metric;
+    unsigned char type;
+    unsigned char flags;
+    uint16_t pad;
+};
+
+/* Size of the ring, rounded up to a power of two; 0 disables tracing. */
+extern int trace_records;
+/* Written on SIGUSR1. */
+extern char *trace_file;
+
+struct babel_route;
+
+int trace_init(void);
+void trace_route(int type, const struct babel_route *route,
+                 unsigned int arg, int flags);
+void trace_prefix(int type, const unsigned char *prefix, uint16_t plen,
+                  const unsigned char *address, unsigned int ifindex,
+                  unsigned short seqno, unsigned short metric,
+                  unsigned int arg, int flags);
+int trace_create(unsigned char **buf_r, int reserve);
+int trace_write_file(const char *file);
+
+#endif
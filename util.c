@@ -330,136 +330,119 @@ format_prefix(const unsigned char *prefix, uint16_t plen)
 }
 
 #ifndef BABELD_CODE //+++++ ADD +++++
-const char *
-format_cefore_prefix(const unsigned char *prefix, uint16_t plen)
+static void
+uri_append(char *buf, int size, int *n, const char *s, int len)
 {
-    struct cefore_tlv_hdr {
-        uint16_t        type;
-        uint16_t        length;
-    } __attribute__((__packed__));
-    
-    static char buf[4][65535];
-    static int i = 0;
-    
-    struct cefore_tlv_hdr* hdp;
-
-    unsigned char name[65535];
-    char uri[65535];
-    int j;
-    int x = 0;
-    int seg_len, uri_len, name_len;
+    int k = MIN(len, size - 1 - *n);
+    if(k > 0) {
+        memcpy(buf + *n, s, k);
+        *n += k;
+    }
+}
+
+/* Write the URI of a name into buf, truncated to fit in size bytes, and
+   return its length.  Takes time in the length of the name only. */
+int
+format_cefore_prefix_buf(char *buf, int size, const unsigned char *prefix,
+                         uint16_t plen)
+{
+    int x = 0, n = 0;
+    int j, seg_len, hname;
     uint16_t sub_type;
-    uint16_t app_num;
     char work[16];
 
-    i = (i + 1) % 4;
+    if(size <= 0)
+        return 0;
 
-    uri_len = 0;
-    memset( uri, 0x00, 65535 );
-    memset( &buf[i][0], 0x00, 65535 );
-    name_len = (int)plen;
-    memcpy( name, prefix, name_len );
-    uri[uri_len] = '/';
-    uri_len++;
-
-    while (x < name_len) {
-        int hname = 0;
-        hdp = (struct cefore_tlv_hdr*) &prefix[x];
-        seg_len = ntohs (hdp->length);
+    uri_append(buf, size, &n, "/", 1);
+
+    while(x + 4 <= plen) {
+        DO_NTOHS(sub_type, prefix + x);
+        DO_NTOHS(seg_len, prefix + x + 2);
         x += 4;
+        seg_len = MIN(seg_len, plen - x);
 
         /* Check if it contains non-print character */
-        for (j = 0 ; j < seg_len ; j++) {
-            if(!(isprint(name[x+j]))) { /* HEX Name */
+        hname = 0;
+        for(j = 0; j < seg_len; j++) {
+            if(!isprint(prefix[x + j])) { /* HEX Name */
                 hname = 1;
                 break;
             }
         }
-        if(hname == 0){
-
-            char char_num[8];
-            int  num_len;
-            sub_type = ntohs (hdp->type);
-            if ((sub_type >= 0x1000) &&
-                (sub_type <= 0x1FFF)) {
-                memset( char_num, 0x00, 8 );
+
+        if(!hname) {
+            if(sub_type >= 0x1000 && sub_type <= 0x1FFF) {
                 /* T_APP */
-                app_num = sub_type - 0x1000;
-                sprintf( char_num, "%d", app_num );
-                num_len = strlen( char_num );
-                memcpy( &uri[uri_len], "APP:", 4 );
-                uri_len += 4;
-                memcpy( &uri[uri_len], char_num, num_len );
-                uri_len += num_len;
-                uri[uri_len] = '=';
-                uri_len++;
-            } else if ( sub_type == 0x0001 ) {
-                /* T_NAMESEGMENT */
-            } else {
-                /* HEX Type */
-                unsigned char   sub_wk[8];
-                memset( sub_wk, 0x00, 8 );
-                memcpy( sub_wk, &hdp->type, 2 );
-                memset( char_num, 0x00, 8 );
-                uri[uri_len++] = '0';
-                uri[uri_len++] = 'x';
-                sprintf( char_num, "%02x", sub_wk[0] );
-                memcpy( &uri[uri_len], char_num, 2 );
-                uri_len += 2;
-                sprintf( char_num, "%02x", sub_wk[1] );
-                memcpy( &uri[uri_len], char_num, 2 );
-                uri_len += 2;
-                uri[uri_len] = '=';
-                uri_len++;
+                j = snprintf(work, sizeof(work), "APP:%d=", sub_type - 0x1000);
+                uri_append(buf, size, &n, work, j);
+            } else if(sub_type != 0x0001) {
+                /* HEX Type; T_NAMESEGMENT is implied */
+                j = snprintf(work, sizeof(work), "0x%02x%02x=",
+                             prefix[x - 4], prefix[x - 3]);
+                uri_append(buf, size, &n, work, j);
             }
-
-            for (j = 0 ; j < seg_len ; j++) {
-                if(((name[x + j] >= 0x30) && (name[x + j] <= 0x39)) ||      /* 0~9 */
-                    ((name[x + j] >= 0x41) && (name[x + j] <= 0x5a)) ||     /* A~Z */
-                    ((name[x + j] >= 0x61) && (name[x + j] <= 0x7a))) {     /* a~z */
-                    
-                    uri[uri_len] = name[x + j];
-                    uri_len++;
-                } else if ((name[x + j] == 0x2d) ||                     /* - */
-                        (name[x + j] == 0x2e) ||                        /* . */
-                        (name[x + j] == 0x2f) ||                        /* / */
-                        (name[x + j] == 0x5f) ||                        /* _ */
-                        (name[x + j] == 0x7e)) {                        /* ~ */
-                    uri[uri_len] = name[x + j];
-                    uri_len++;
+            for(j = 0; j < seg_len; j++) {
+                unsigned char c = prefix[x + j];
+                if((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+                   (c >= 'a' && c <= 'z') || c == '-' || c == '.' ||
+                   c == '/' || c == '_' || c == '~') {
+                    uri_append(buf, size, &n, (const char*)&c, 1);
                 } else {
-                    sprintf (work, "%02x", name[x + j]);
-                    strcpy (&uri[uri_len], work);
-                    uri_len += strlen (work);
+                    snprintf(work, sizeof(work), "%02x", c);
+                    uri_append(buf, size, &n, work, 2);
                 }
             }
         } else {
-            uri[uri_len++] = '0';
-            uri[uri_len++] = 'x';
-            for (j = 0 ; j < seg_len ; j++) {
-                sprintf (work, "%02x", name[x + j]);
-                strcpy (&uri[uri_len], work);
-                uri_len += strlen (work);
+            uri_append(buf, size, &n, "0x", 2);
+            for(j = 0; j < seg_len; j++) {
+                snprintf(work, sizeof(work), "%02x", prefix[x + j]);
+                uri_append(buf, size, &n, work, 2);
             }
         }
-        uri[uri_len] = '/';
-        uri_len++;
+        uri_append(buf, size, &n, "/", 1);
 
         x += seg_len;
-    }   //end while
+    }
 
-    uri[uri_len] = 0x00;
     /* delete last '/' */
-    if(uri[uri_len-1] == '/'){
-        uri[uri_len-1] = 0x00;
-        uri_len--;
-    }
+    if(n > 0 && buf[n - 1] == '/')
+        n--;
+    buf[n] = '\0';
+    return n;
+}
 
-    memcpy( &buf[i][0], uri, uri_len );
+const char *
+format_cefore_prefix(const unsigned char *prefix, uint16_t plen)
+{
+    static char buf[4][CEFORE_URI_MAX];
+    static int i = 0;
 
+    i = (i + 1) % 4;
+    format_cefore_prefix_buf(buf[i], CEFORE_URI_MAX, prefix, plen);
     return buf[i];
 }
 #endif //----- ADD -----
+
+#ifndef BABELD_CODE //+++++ ADD for PREFIX HASH +++++
+/* Carries on hashing len more bytes from h, which starts at HASH_INIT. */
+unsigned int
+hash_bytes(unsigned int h, const unsigned char *p, int len)
+{
+    int i;
+    for(i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+unsigned int
+hash_prefix(const unsigned char *prefix, uint16_t plen)
+{
+    return hash_bytes(HASH_INIT, prefix, plen);
+}
+#endif //----- ADD for PREFIX HASH -----
 const char *
 format_eui64(const unsigned char *eui)
 {
@@ -136,8 +136,21 @@ const char *format_prefix(const unsigned char *prefix, uint16_t plen);
 #endif //----- REPLACE -----
 
 #ifndef BABELD_CODE //+++++ ADD +++++
+/* Room for the URI of any name of NAME_PREFIX_LEN bytes; the URI of a
+   longer one is truncated. */
+#define CEFORE_URI_MAX 4096
 const char *format_cefore_prefix(const unsigned char *address, uint16_t plen);
+int format_cefore_prefix_buf(char *buf, int size, const unsigned char *prefix,
+                             uint16_t plen);
 #endif //----- ADD -----
+#ifndef BABELD_CODE //+++++ ADD for PREFIX HASH +++++
+/* 32-bit FNV-1a, for the hash tables keyed on names. */
+#define HASH_INIT 2166136261U
+unsigned int hash_bytes(unsigned int h, const unsigned char *p, int len)
+    ATTRIBUTE ((pure));
+unsigned int hash_prefix(const unsigned char *prefix, uint16_t plen)
+    ATTRIBUTE ((pure));
+#endif //----- ADD for PREFIX HASH -----
 const char *format_eui64(const unsigned char *eui);
 const char *format_thousands(unsigned int value);
 int parse_address(const char *address, unsigned char *addr_r, int *af_r);
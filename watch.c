@@ -0,0 +1,445 @@
+#ifndef BABELD_CODE //+++++ ADD +++++
+/*
+ * Copyright (c) 2016-2025, National Institute of Information and Communications
+ * Technology (NICT). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the NICT nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NICT AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE NICT OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * watch.c
+ *
+ * Change notifications for cefbabelstatus --watch.  The local_notify_*
+ * hooks record the changes of the current main-loop iteration in a batch,
+ * where successive changes to the same route, neighbour or interface are
+ * merged, and watch_flush sends the batch as a single frame to every
+ * watcher at the end of the iteration.  Frames are queued per watcher and
+ * written without blocking as the socket drains.  A watcher that falls
+ * more than WATCH_QUEUE_SIZE behind loses its queue and gets a resync
+ * frame instead, after which it reloads the tables with paged dumps.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "babeld.h"
+#include "util.h"
+#include "interface.h"
+#include "source.h"
+#include "neighbour.h"
+#include "route.h"
+#include "kernel.h"
+#include "xroute.h"
+#include "local.h"
+#include "cefore.h"
+#include "watch.h"
+
+#define WATCH_BUCKETS 256
+#define WATCH_LINE_SIZE 4096
+
+/* A change recorded during the current iteration.  The text is kept
+   without the kind, which may still change when events are merged. */
+struct watch_event {
+    const void *key;            /* object changed, or NULL */
+    int kind;                   /* LOCAL_* */
+    int dead;                   /* merged into a later event */
+    int off, len;               /* text in batch */
+    int next;                   /* 1 + previous event in the same bucket */
+};
+
+struct watcher {
+    int fd;
+    unsigned char *queue;
+    int start, len;
+    int head_left;              /* unsent bytes of a partially sent frame */
+};
+
+static struct watcher watchers[WATCH_MAX_CLIENTS];
+static int num_watchers = 0;
+
+static struct watch_event *events = NULL;
+static int num_events = 0, max_events = 0;
+static char *batch = NULL;
+static int batch_len = 0, batch_size = 0;
+static int batch_overflow = 0;
+static int event_hash[WATCH_BUCKETS];   /* 1 + latest event, or 0 */
+
+static const char *kind_names[] = { "flush", "add", "change" };
+
+static void
+watch_drop(int i)
+{
+    close(watchers[i].fd);
+    free(watchers[i].queue);
+    watchers[i] = watchers[--num_watchers];
+}
+
+/* Make room for len more bytes at the end of the queue. */
+static unsigned char *
+watch_reserve(struct watcher *w, int len)
+{
+    if(w->len + len > WATCH_QUEUE_SIZE)
+        return NULL;
+    if(w->start + w->len + len > WATCH_QUEUE_SIZE) {
+        memmove(w->queue, w->queue + w->start, w->len);
+        w->start = 0;
+    }
+    return w->queue + w->start + w->len;
+}
+
+static void
+watch_header(unsigned char *buf, int len)
+{
+    uint32_t value32 = htonl(CefC_Cbabel_RspMsg_HeaderLen + len);
+
+    buf[CefC_O_Fix_Ver] = CefC_Version;
+    buf[CefC_O_Fix_Type] = CefC_Cbabel_Msg_Type_Watch;
+    memcpy(buf + CefC_O_Length, &value32, CefC_L_Length);
+}
+
+/* Throw away what has not started to go out, and tell the watcher that
+   it has missed changes. */
+static void
+watch_resync(struct watcher *w)
+{
+    static const char resync[] = "resync\n";
+    int len = sizeof(resync) - 1;
+    unsigned char *p;
+
+    w->len = w->head_left;
+    p = watch_reserve(w, CefC_Cbabel_RspMsg_HeaderLen + len);
+    if(p == NULL)
+        return;
+    watch_header(p, len);
+    memcpy(p + CefC_Cbabel_RspMsg_HeaderLen, resync, len);
+    w->len += CefC_Cbabel_RspMsg_HeaderLen + len;
+}
+
+static void
+watch_consume(struct watcher *w, int n)
+{
+    uint32_t value32;
+    int k;
+
+    while(n > 0) {
+        if(w->head_left == 0) {
+            memcpy(&value32, w->queue + w->start + CefC_O_Length,
+                   CefC_L_Length);
+            w->head_left = ntohl(value32);
+        }
+        k = MIN(n, w->head_left);
+        w->head_left -= k;
+        w->start += k;
+        w->len -= k;
+        n -= k;
+    }
+    if(w->len == 0)
+        w->start = 0;
+}
+
+static int
+watch_send(struct watcher *w)
+{
+    int rc;
+
+    while(w->len > 0) {
+        rc = send(w->fd, w->queue + w->start, w->len, MSG_NOSIGNAL);
+        if(rc < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return 0;
+            return -1;
+        }
+        watch_consume(w, rc);
+    }
+    return 0;
+}
+
+/* Takes over a connection that asked to watch.  The first frame is a
+   resync, so that the watcher starts by loading the tables. */
+int
+watch_add(int fd)
+{
+    struct watcher *w;
+
+    if(num_watchers >= WATCH_MAX_CLIENTS)
+        return -1;
+    w = &watchers[num_watchers];
+    memset(w, 0, sizeof(struct watcher));
+    w->queue = malloc(WATCH_QUEUE_SIZE);
+    if(w->queue == NULL) {
+        perror("malloc(watch)");
+        return -1;
+    }
+    w->fd = fd;
+    num_watchers++;
+    watch_resync(w);
+    if(watch_send(w) < 0) {
+        watch_drop(num_watchers - 1);
+        return -1;
+    }
+    return 0;
+}
+
+static void
+watch_event(const void *key, int kind, const char *text, int len)
+{
+    struct watch_event *e = NULL;
+    unsigned int h = 0;
+    int i;
+
+    if(batch_overflow)
+        return;
+    if(batch_len + len > WATCH_QUEUE_SIZE) {
+        /* More than any watcher could take: they will all resync. */
+        batch_overflow = 1;
+        return;
+    }
+
+    if(key) {
+        h = ((uintptr_t)key >> 4) % WATCH_BUCKETS;
+        for(i = event_hash[h]; i > 0; i = events[i - 1].next) {
+            if(events[i - 1].key == key) {
+                e = &events[i - 1];
+                break;
+            }
+        }
+        /* Never merge past a flush: the object may have been freed and
+           its address reused. */
+        if(e && (e->dead || e->kind == LOCAL_FLUSH))
+            e = NULL;
+    }
+    if(e) {
+        e->dead = 1;
+        if(e->kind == LOCAL_ADD) {
+            if(kind == LOCAL_FLUSH)
+                return;         /* came and went within the iteration */
+            kind = LOCAL_ADD;
+        }
+    }
+
+    if(num_events >= max_events) {
+        int n = max_events < 1 ? 64 : 2 * max_events;
+        struct watch_event *new_events =
+            realloc(events, n * sizeof(struct watch_event));
+        if(new_events == NULL) {
+            batch_overflow = 1;
+            return;
+        }
+        events = new_events;
+        max_events = n;
+    }
+    if(batch_len + len > batch_size) {
+        int n = MAX(2 * batch_size, batch_len + len);
+        char *new_batch = realloc(batch, n);
+        if(new_batch == NULL) {
+            batch_overflow = 1;
+            return;
+        }
+        batch = new_batch;
+        batch_size = n;
+    }
+
+    memcpy(batch + batch_len, text, len);
+    e = &events[num_events];
+    e->key = key;
+    e->kind = kind;
+    e->dead = 0;
+    e->off = batch_len;
+    e->len = len;
+    e->next = key ? event_hash[h] : 0;
+    num_events++;
+    if(key)
+        event_hash[h] = num_events;
+    batch_len += len;
+}
+
+void
+watch_interface(struct interface *ifp, int kind)
+{
+    char buf[WATCH_LINE_SIZE];
+    int rc;
+
+    if(num_watchers == 0)
+        return;
+    rc = snprintf(buf, WATCH_LINE_SIZE, "interface %s up %s\n",
+                  ifp->name, if_up(ifp) ? "true" : "false");
+    if(rc > 0 && rc < WATCH_LINE_SIZE)
+        watch_event(ifp, kind, buf, rc);
+}
+
+void
+watch_neighbour(struct neighbour *neigh, int kind)
+{
+    char buf[WATCH_LINE_SIZE];
+    int rc;
+
+    if(num_watchers == 0)
+        return;
+    rc = snprintf(buf, WATCH_LINE_SIZE,
+                  "neighbour %lx address %s if %s reach %04x "
+                  "rxcost %u txcost %u cost %u\n",
+                  (unsigned long)neigh,
+                  format_address(neigh->address), neigh->ifp->name,
+                  neigh->hello.reach, neighbour_rxcost(neigh),
+                  neighbour_txcost(neigh), neighbour_cost(neigh));
+    if(rc > 0 && rc < WATCH_LINE_SIZE)
+        watch_event(neigh, kind, buf, rc);
+}
+
+/* Exported routes move around in memory: their changes are not merged. */
+void
+watch_xroute(struct xroute *xroute, int kind)
+{
+    char buf[WATCH_LINE_SIZE];
+    int rc;
+
+    if(num_watchers == 0)
+        return;
+    rc = snprintf(buf, WATCH_LINE_SIZE, "xroute prefix %s metric %d\n",
+                  format_cefore_prefix(xroute->prefix, xroute->plen),
+                  xroute->metric);
+    if(rc > 0 && rc < WATCH_LINE_SIZE)
+        watch_event(NULL, kind, buf, rc);
+}
+
+void
+watch_route(struct babel_route *route, int kind)
+{
+    char buf[WATCH_LINE_SIZE];
+    int rc;
+
+    if(num_watchers == 0)
+        return;
+    rc = snprintf(buf, WATCH_LINE_SIZE,
+                  "route %lx prefix %s installed %s id %s metric %d "
+                  "refmetric %d via %s if %s\n",
+                  (unsigned long)route,
+                  source_uri(route->src),
+                  route->installed ? "yes" : "no",
+                  format_eui64(route->src->id),
+                  route_metric(route), route->refmetric,
+                  format_address(route->neigh->address),
+                  route->neigh->ifp->name);
+    if(rc > 0 && rc < WATCH_LINE_SIZE)
+        watch_event(route, kind, buf, rc);
+}
+
+/* Watchers are read to notice when they go away, and written to while
+   they have something queued.  Returns the largest descriptor, or -1. */
+int
+watch_fds(fd_set *readfds, fd_set *writefds)
+{
+    int i, maxfd = -1;
+
+    for(i = 0; i < num_watchers; i++) {
+        FD_SET(watchers[i].fd, readfds);
+        if(watchers[i].len > 0)
+            FD_SET(watchers[i].fd, writefds);
+        maxfd = MAX(maxfd, watchers[i].fd);
+    }
+    return maxfd;
+}
+
+void
+watch_process(fd_set *readfds, fd_set *writefds)
+{
+    char buf[256];
+    int i, rc;
+
+    for(i = num_watchers - 1; i >= 0; i--) {
+        if(FD_ISSET(watchers[i].fd, readfds)) {
+            /* Watchers have nothing to say: this is the end. */
+            rc = recv(watchers[i].fd, buf, sizeof(buf), 0);
+            if(rc == 0 ||
+               (rc < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                errno != EINTR)) {
+                watch_drop(i);
+                continue;
+            }
+        }
+        if(FD_ISSET(watchers[i].fd, writefds)) {
+            if(watch_send(&watchers[i]) < 0)
+                watch_drop(i);
+        }
+    }
+}
+
+/* Send the changes of this iteration to every watcher, as one frame. */
+void
+watch_flush(void)
+{
+    struct watcher *w;
+    unsigned char *p;
+    int i, j, len = 0;
+
+    if(num_events == 0 && !batch_overflow)
+        return;
+
+    for(j = 0; j < num_events; j++) {
+        if(!events[j].dead)
+            len += strlen(kind_names[events[j].kind]) + 1 + events[j].len;
+    }
+
+    for(i = num_watchers - 1; i >= 0; i--) {
+        w = &watchers[i];
+        if(len == 0 && !batch_overflow)
+            break;
+        p = batch_overflow ? NULL :
+            watch_reserve(w, CefC_Cbabel_RspMsg_HeaderLen + len);
+        if(p == NULL) {
+            watch_resync(w);
+        } else {
+            watch_header(p, len);
+            p += CefC_Cbabel_RspMsg_HeaderLen;
+            for(j = 0; j < num_events; j++) {
+                const char *kind = kind_names[events[j].kind];
+                if(events[j].dead)
+                    continue;
+                memcpy(p, kind, strlen(kind));
+                p += strlen(kind);
+                *p++ = ' ';
+                memcpy(p, batch + events[j].off, events[j].len);
+                p += events[j].len;
+            }
+            w->len += CefC_Cbabel_RspMsg_HeaderLen + len;
+        }
+        if(watch_send(w) < 0)
+            watch_drop(i);
+    }
+
+    num_events = 0;
+    batch_len = 0;
+    batch_overflow = 0;
+    memset(event_hash, 0, sizeof(event_hash));
+}
+
+#endif //----- ADD -----
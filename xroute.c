@@ -206,11 +206,7 @@ add_xroute(unsigned char prefix[NAME_PREFIX_LEN], uint16_t plen,
     xroutes[n].metric = metric;
     xroutes[n].ifindex = ifindex;
     xroutes[n].proto = proto;
-#ifdef BABELD_CODE //+++++ REPLACE +++++
     local_notify_xroute(&xroutes[n], LOCAL_ADD);
-#else // CEFBABELD
-//    local_notify_xroute(&xroutes[n], LOCAL_ADD);
-#endif //----- REPLACE -----
     return 1;
 }
 
@@ -222,11 +218,7 @@ flush_xroute(struct xroute *xroute)
     i = xroute - xroutes;
     assert(i >= 0 && i < numxroutes);
 
-#ifdef BABELD_CODE //+++++ REPLACE +++++
     local_notify_xroute(xroute, LOCAL_FLUSH);
-#else // CEFBABELD
-//    local_notify_xroute(xroute, LOCAL_FLUSH);
-#endif //----- REPLACE -----
 
     if(i != numxroutes - 1)
         memmove(xroutes + i, xroutes + i + 1,
@@ -287,6 +279,24 @@ xroute_stream_done(struct xroute_stream *stream)
     free(stream);
 }
 
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+/* Exported route following the given prefix, or the first one if prefix
+   is NULL. */
+struct xroute *
+xroute_after(const unsigned char *prefix, uint16_t plen,
+             const unsigned char *src_prefix, unsigned char src_plen)
+{
+    int i, n = 0;
+
+    if(prefix) {
+        i = find_xroute_slot(prefix, plen, src_prefix, src_plen, &n);
+        if(i >= 0)
+            n = i + 1;
+    }
+    return n < numxroutes ? &xroutes[n] : NULL;
+}
+#endif //----- ADD for PAGED DUMP -----
+
 static int
 filter_route(struct kernel_route *route, void *data) {
     void **args = (void**)data;
@@ -84,6 +84,11 @@ int xroutes_estimate(void);
 struct xroute_stream *xroute_stream();
 struct xroute *xroute_stream_next(struct xroute_stream *stream);
 void xroute_stream_done(struct xroute_stream *stream);
+#ifndef BABELD_CODE //+++++ ADD for PAGED DUMP +++++
+struct xroute *xroute_after(const unsigned char *prefix, uint16_t plen,
+                            const unsigned char *src_prefix,
+                            unsigned char src_plen);
+#endif //----- ADD for PAGED DUMP -----
 int kernel_addresses(int ifindex, int ll,
                      struct kernel_route *routes, int maxroutes);
 int check_xroutes(int send_updates);